@@ -0,0 +1,533 @@
+#include <glad/glad.h>
+
+#include "BlurKernel.hpp"
+#include "CpuBlur.hpp"
+#include "Culling.hpp"
+#include "GeometryArena.hpp"
+#include "HeadlessContext.hpp"
+#include "IndirectBatch.hpp"
+#include "MaskTiles.hpp"
+#include "MeshOptimizer.hpp"
+#include "RenderQueue.hpp"
+#include "Shader.hpp"
+#include "StressScene.hpp"
+#include "TextureLoader.hpp"
+#include "Utility.hpp"
+#include "model.h"
+
+#include <benchmark/benchmark.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Microbenchmarks of the CPU side hot paths, headless on Linux the same way as headless.cpp.
+// BlurryRenderBenchmarks target of CMakeLists.txt, runs from the build folder holding shaders/ and resources/.
+// Prints JSON by default so that results can be compared between versions, any --benchmark_* flag works on top,
+// e.g. --benchmark_filter=CpuBlur or --benchmark_out=results.json.
+
+namespace
+{
+constexpr uint32_t ContextSize = 64;
+
+constexpr auto BackpackModelPath = "resources/models/backpack/backpack.obj";
+constexpr auto ContainerTexturePath = "resources/textures/container.jpg";
+constexpr auto BackgroundTexturePath = "resources/textures/back.jpg";
+constexpr auto GradientMaskTexturePath = "resources/textures/gradient_mask.png";
+constexpr auto SceneVertexShaderPath = "shaders/scene.vert";
+constexpr auto SceneIndirectVertexShaderPath = "shaders/scene_indirect.vert";
+constexpr auto SceneFragmentShaderPath = "shaders/scene.frag";
+
+const char *const TexturePaths[] = { ContainerTexturePath, BackgroundTexturePath, GradientMaskTexturePath };
+
+void ReleaseModel(Model &model)
+{
+  for (Texture &texture : model.textures_loaded)
+    glDeleteTextures(1, &texture.id);
+  for (Mesh &mesh : model.meshes)
+    mesh.release();
+}
+
+std::vector<uint8_t> MakeNoise(size_t size)
+{
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> distribution(0, UINT8_MAX);
+  std::vector<uint8_t> noise(size);
+  for (uint8_t &value : noise)
+    value = static_cast<uint8_t>(distribution(generator));
+  return noise;
+}
+
+// Horizontal gradient like the bundled mask: sharp on the left, blurred on the right
+std::vector<float> MakeGradientMask(uint32_t width, uint32_t height)
+{
+  std::vector<float> mask(static_cast<size_t>(width) * height);
+  for (uint32_t y = 0; y < height; ++y)
+    for (uint32_t x = 0; x < width; ++x)
+      mask[static_cast<size_t>(y) * width + x] = 1.0f - static_cast<float>(x) / (width - 1);
+  return mask;
+}
+
+// Unwelded triangle soup of a size x size grid in shuffled order, what a careless exporter produces
+void MakeGridSoup(uint32_t size, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+  std::vector<std::array<glm::vec2, 3>> triangles;
+  for (uint32_t y = 0; y < size; ++y)
+    for (uint32_t x = 0; x < size; ++x)
+    {
+      const glm::vec2 corner(static_cast<float>(x), static_cast<float>(y));
+      triangles.push_back({ corner, corner + glm::vec2(1.0f, 0.0f), corner + glm::vec2(1.0f, 1.0f) });
+      triangles.push_back({ corner, corner + glm::vec2(1.0f, 1.0f), corner + glm::vec2(0.0f, 1.0f) });
+    }
+  std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+
+  vertices.clear();
+  indices.clear();
+  for (const auto &triangle : triangles)
+    for (const glm::vec2 &corner : triangle)
+    {
+      Vertex vertex{};
+      vertex.Position = glm::vec3(corner.x, 0.0f, corner.y);
+      vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+      vertex.TexCoords = corner / static_cast<float>(size);
+      indices.push_back(static_cast<unsigned int>(vertices.size()));
+      vertices.push_back(vertex);
+    }
+}
+
+// ASSETS
+void BM_ModelLoad(benchmark::State &state)
+{
+  stbi_set_flip_vertically_on_load(true);
+  for (auto _ : state)
+  {
+    Model model(BackpackModelPath);
+    benchmark::DoNotOptimize(model.meshes.data());
+
+    state.PauseTiming();
+    ReleaseModel(model);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_ModelLoad)->Unit(benchmark::kMillisecond);
+
+void BM_MeshOptimize(benchmark::State &state)
+{
+  std::vector<Vertex> sourceVertices, vertices;
+  std::vector<unsigned int> sourceIndices, indices;
+  MakeGridSoup(static_cast<uint32_t>(state.range(0)), sourceVertices, sourceIndices);
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    vertices = sourceVertices;
+    indices = sourceIndices;
+    state.ResumeTiming();
+
+    MeshOptimizer::Optimize(vertices, indices);
+    benchmark::DoNotOptimize(indices.data());
+  }
+
+  const MeshOptimizer::Statistics before = MeshOptimizer::Measure(sourceVertices, sourceIndices, sizeof(unsigned int));
+  const MeshOptimizer::Statistics after = MeshOptimizer::Measure(vertices, indices, Mesh::indexSize(vertices.size()));
+  state.counters["acmr_before"] = before.GetACMR();
+  state.counters["acmr_after"] = after.GetACMR();
+  state.counters["bytes_before"] = static_cast<double>(before.vertexBytes + before.indexBytes);
+  state.counters["bytes_after"] = static_cast<double>(after.vertexBytes + after.indexBytes);
+  state.SetItemsProcessed(state.iterations() * sourceIndices.size() / 3);
+}
+BENCHMARK(BM_MeshOptimize)->Arg(64)->Arg(256)->ArgName("grid")->Unit(benchmark::kMillisecond);
+
+void BM_LoadTextureFromImage(benchmark::State &state)
+{
+  const char *path = TexturePaths[state.range(0)];
+  state.SetLabel(path);
+  for (auto _ : state)
+  {
+    unsigned int texture = Utility::LoadTextureFromImage(path);
+    glFinish();
+
+    state.PauseTiming();
+    glDeleteTextures(1, &texture);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_LoadTextureFromImage)->DenseRange(0, std::size(TexturePaths) - 1)->Unit(benchmark::kMillisecond);
+
+void BM_TextureLoader(benchmark::State &state)
+{
+  TextureLoader loader;
+  loader.Initialize();
+  std::vector<unsigned int> textures;
+  for (auto _ : state)
+  {
+    for (const char *path : TexturePaths)
+      textures.push_back(loader.Load(path));
+    loader.Finish();
+    glFinish();
+
+    state.PauseTiming();
+    glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    textures.clear();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_TextureLoader)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// DRAW SUBMISSION
+void BM_ShaderSetUniform(benchmark::State &state)
+{
+  Shader shader(SceneVertexShaderPath, SceneFragmentShaderPath);
+  shader.use();
+  const glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(1.4f, -1.0f, 0.3f));
+  const glm::vec3 position(1.2f, 2.0f, 2.0f);
+  for (auto _ : state)
+  {
+    shader.setUniform("model", model);
+    shader.setUniform("light.position", position);
+    shader.setUniform("material.shininess", 8.0f);
+    shader.setUniform("material.diffuse", 0);
+  }
+  state.SetItemsProcessed(state.iterations() * 4);
+  glDeleteProgram(shader.getDescriptor());
+}
+BENCHMARK(BM_ShaderSetUniform);
+
+void BM_ShaderSetUniformHandle(benchmark::State &state)
+{
+  Shader shader(SceneVertexShaderPath, SceneFragmentShaderPath);
+  shader.use();
+  const Shader::UniformHandle modelUniform = shader.getUniform("model");
+  const Shader::UniformHandle positionUniform = shader.getUniform("light.position");
+  const Shader::UniformHandle shininessUniform = shader.getUniform("material.shininess");
+  const Shader::UniformHandle diffuseUniform = shader.getUniform("material.diffuse");
+  const glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(1.4f, -1.0f, 0.3f));
+  const glm::vec3 position(1.2f, 2.0f, 2.0f);
+  for (auto _ : state)
+  {
+    shader.setUniform(modelUniform, model);
+    shader.setUniform(positionUniform, position);
+    shader.setUniform(shininessUniform, 8.0f);
+    shader.setUniform(diffuseUniform, 0);
+  }
+  state.SetItemsProcessed(state.iterations() * 4);
+  glDeleteProgram(shader.getDescriptor());
+}
+BENCHMARK(BM_ShaderSetUniformHandle);
+
+void BM_ModelDraw(benchmark::State &state)
+{
+  stbi_set_flip_vertically_on_load(true);
+  Model model(BackpackModelPath);
+  Shader shader(SceneVertexShaderPath, SceneFragmentShaderPath);
+  shader.use();
+  shader.setUniform("model", glm::mat4(1.0f));
+  shader.setUniform("view", glm::mat4(1.0f));
+  shader.setUniform("projection", glm::mat4(1.0f));
+
+  // Tiny viewport keeps rasterization out of the measured submit cost
+  glViewport(0, 0, 1, 1);
+  for (auto _ : state)
+    model.Draw(shader);
+  glFinish();
+  glViewport(0, 0, ContextSize, ContextSize);
+
+  state.SetItemsProcessed(state.iterations() * model.meshes.size());
+  glDeleteProgram(shader.getDescriptor());
+  ReleaseModel(model);
+}
+BENCHMARK(BM_ModelDraw)->Unit(benchmark::kMicrosecond);
+
+// Submit cost of many small meshes, a draw call each against a few multi-draw indirect calls from the arena
+void BM_SceneSubmit(benchmark::State &state)
+{
+  constexpr uint32_t Draws = 1024;
+  constexpr uint32_t GridSize = 4;
+  const bool indirect = state.range(0) != 0;
+  GeometryArena arena;
+  IndirectBatch batch;
+
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  MakeGridSoup(GridSize, vertices, indices);
+  MeshOptimizer::Optimize(vertices, indices);
+  Mesh mesh(vertices, indices, {}, VertexFormat::Full, indirect ? &arena : nullptr);
+
+  Shader shader(indirect ? SceneIndirectVertexShaderPath : SceneVertexShaderPath, SceneFragmentShaderPath);
+  shader.use();
+  shader.setUniform("view", glm::mat4(1.0f));
+  shader.setUniform("projection", glm::mat4(1.0f));
+  batch.Initialize(Draws);
+
+  IndirectBatch::DrawData data{ glm::mat4(1.0f), glm::vec4(0.0f), glm::vec4(1.0f) };
+  glViewport(0, 0, 1, 1);
+  for (auto _ : state)
+  {
+    batch.Clear();
+    for (uint32_t i = 0; i < Draws; ++i)
+    {
+      data.model = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i), 0.0f, 0.0f));
+      if (indirect)
+        batch.Add(mesh.allocation, 0, data);
+      else
+      {
+        shader.setUniform("model", data.model);
+        mesh.Draw(shader);
+      }
+    }
+    if (indirect)
+      batch.Submit(arena);
+    glFinish();
+  }
+  glViewport(0, 0, ContextSize, ContextSize);
+
+  state.SetItemsProcessed(state.iterations() * Draws);
+  glDeleteProgram(shader.getDescriptor());
+  // arena geometry is released with the arena
+  if (!indirect)
+    glDeleteVertexArrays(1, &mesh.VAO);
+}
+BENCHMARK(BM_SceneSubmit)->Arg(0)->Arg(1)->ArgName("indirect")->Unit(benchmark::kMicrosecond);
+
+// Stress scene of N instanced meshes, either uploaded once or rebuilt and uploaded every frame
+void BM_StressSceneSubmit(benchmark::State &state)
+{
+  constexpr uint32_t GridSize = 2;
+  const uint32_t count = static_cast<uint32_t>(state.range(0));
+  const bool rebuild = state.range(1) != 0;
+  GeometryArena arena;
+  IndirectBatch batch;
+
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  MakeGridSoup(GridSize, vertices, indices);
+  MeshOptimizer::Optimize(vertices, indices);
+  Mesh mesh(vertices, indices, {}, VertexFormat::Full, &arena);
+
+  std::vector<IndirectBatch::DrawData> instances;
+  for (const StressScene::Placement &placement : StressScene::Generate(count))
+    instances.push_back({ StressScene::GetTransform(placement, 0.5f, 0.0f), glm::vec4(0.0f), glm::vec4(1.0f) });
+
+  Shader shader(SceneIndirectVertexShaderPath, SceneFragmentShaderPath);
+  shader.use();
+  shader.setUniform("view", glm::mat4(1.0f));
+  shader.setUniform("projection", glm::mat4(1.0f));
+  batch.AddInstances(mesh.allocation, 0, instances.data(), count);
+
+  glViewport(0, 0, 1, 1);
+  for (auto _ : state)
+  {
+    if (rebuild)
+    {
+      batch.Clear();
+      batch.AddInstances(mesh.allocation, 0, instances.data(), count);
+    }
+    batch.Submit(arena);
+    glFinish();
+  }
+  glViewport(0, 0, ContextSize, ContextSize);
+
+  state.SetItemsProcessed(state.iterations() * count);
+  glDeleteProgram(shader.getDescriptor());
+}
+BENCHMARK(BM_StressSceneSubmit)
+  ->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })
+  ->ArgNames({ "instances", "rebuild" })
+  ->Unit(benchmark::kMicrosecond);
+
+// Stress scene of N unit cubes seen by the demo camera, most of a big field is outside of the frustum
+void BM_FrustumCull(benchmark::State &state)
+{
+  const uint32_t count = static_cast<uint32_t>(state.range(0));
+  const Culling::Bounds cube{ glm::vec3(-0.5f), glm::vec3(0.5f) };
+  std::vector<Culling::Bounds> bounds;
+  for (const StressScene::Placement &placement : StressScene::Generate(count))
+    bounds.push_back(Culling::Transform(cube, StressScene::GetTransform(placement, 0.5f, 0.5f)));
+
+  Culling::Bvh bvh;
+  bvh.Build(bounds);
+  const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 7.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+  const Culling::Frustum frustum = Culling::ExtractFrustum(projection * view);
+
+  std::vector<uint8_t> visible;
+  Culling::Statistics statistics;
+  for (auto _ : state)
+  {
+    statistics = bvh.Cull(frustum, visible);
+    benchmark::DoNotOptimize(visible.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["tested"] = statistics.tested;
+  state.counters["visible"] = statistics.visible;
+  state.SetLabel(Culling::GetInstructionSet());
+}
+BENCHMARK(BM_FrustumCull)->Arg(10000)->Arg(100000)->Arg(1000000)->ArgName("objects")->Unit(benchmark::kMicrosecond);
+
+// N packets of random state recorded and radix sorted, as a frame of individual draws would be
+void BM_RenderQueueSort(benchmark::State &state)
+{
+  const uint32_t count = static_cast<uint32_t>(state.range(0));
+  std::mt19937 random(7);
+  std::vector<RenderQueue::Packet> packets(count);
+  std::vector<float> depths(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    packets[i].program = 1 + random() % 8;
+    packets[i].texture = 1 + random() % 64;
+    packets[i].vertexArray = 1 + random() % 4;
+    depths[i] = std::uniform_real_distribution<float>()(random);
+  }
+
+  RenderQueue queue;
+  for (auto _ : state)
+  {
+    queue.Clear();
+    for (uint32_t i = 0; i < count; ++i)
+      queue.Add(RenderQueue::Pass::Opaque, packets[i], depths[i]);
+    queue.Sort();
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_RenderQueueSort)->Arg(1000)->Arg(10000)->Arg(100000)->ArgName("packets")->Unit(benchmark::kMicrosecond);
+
+// Every draw waited for, so the vertex stage is measured along with the submission, bytes are vertex buffer reads
+void BM_ModelVertexFetch(benchmark::State &state)
+{
+  const VertexFormat format = static_cast<VertexFormat>(state.range(0));
+  Model model(BackpackModelPath, nullptr, format);
+  Shader shader(SceneVertexShaderPath, SceneFragmentShaderPath);
+  shader.use();
+  shader.setUniform("model", glm::mat4(1.0f));
+  shader.setUniform("view", glm::mat4(1.0f));
+  shader.setUniform("projection", glm::mat4(1.0f));
+
+  size_t vertexBytes = 0;
+  const size_t vertexSize = format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+  for (const Mesh &mesh : model.meshes)
+    vertexBytes += mesh.vertexCount * vertexSize;
+
+  glViewport(0, 0, 1, 1);
+  for (auto _ : state)
+  {
+    model.Draw(shader);
+    glFinish();
+  }
+  glViewport(0, 0, ContextSize, ContextSize);
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * vertexBytes));
+  state.counters["vertex_bytes"] = static_cast<double>(vertexBytes);
+  glDeleteProgram(shader.getDescriptor());
+  ReleaseModel(model);
+}
+BENCHMARK(BM_ModelVertexFetch)
+  ->Arg(static_cast<int64_t>(VertexFormat::Full))
+  ->Arg(static_cast<int64_t>(VertexFormat::Packed))
+  ->ArgName("packed")
+  ->Unit(benchmark::kMicrosecond);
+
+// POST-PROCESSING
+void BM_CpuBlur(benchmark::State &state)
+{
+  constexpr uint32_t Channels = 3;
+  const uint32_t width = static_cast<uint32_t>(state.range(0));
+  const uint32_t height = static_cast<uint32_t>(state.range(1));
+  const std::vector<uint8_t> source = MakeNoise(static_cast<size_t>(width) * height * Channels);
+  const std::vector<float> mask = MakeGradientMask(width, height);
+
+  CpuBlur::Settings settings;
+  settings.threads = static_cast<uint32_t>(state.range(2));
+  state.SetLabel(CpuBlur::GetInstructionSet());
+
+  std::vector<uint8_t> pixels = source;
+  for (auto _ : state)
+  {
+    CpuBlur::Blur(pixels.data(), width, height, Channels, mask.data(), settings);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * source.size());
+}
+BENCHMARK(BM_CpuBlur)
+  ->ArgsProduct({ { 640 }, { 360 }, { 1, 0 } })
+  ->ArgsProduct({ { 1920 }, { 1080 }, { 1, 0 } })
+  ->ArgNames({ "width", "height", "threads" })
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+void BM_CpuBlurFloat(benchmark::State &state)
+{
+  constexpr uint32_t Channels = 3;
+  constexpr uint32_t Width = 640;
+  constexpr uint32_t Height = 360;
+  const std::vector<uint8_t> noise = MakeNoise(static_cast<size_t>(Width) * Height * Channels);
+  const std::vector<float> mask = MakeGradientMask(Width, Height);
+  std::vector<float> pixels(noise.begin(), noise.end());
+
+  CpuBlur::Settings settings;
+  settings.threads = static_cast<uint32_t>(state.range(0));
+  for (auto _ : state)
+  {
+    CpuBlur::Blur(pixels.data(), Width, Height, Channels, mask.data(), settings);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * pixels.size() * sizeof(float));
+}
+BENCHMARK(BM_CpuBlurFloat)->Arg(1)->Arg(0)->ArgName("threads")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_BlurKernelBuild(benchmark::State &state)
+{
+  constexpr int32_t Samples = 8;
+  constexpr uint32_t MaxTaps = 128;
+  const uint32_t passes = static_cast<uint32_t>(state.range(0));
+  for (auto _ : state)
+  {
+    const BlurKernel::Kernel kernel = BlurKernel::Compose(BlurKernel::BuildPassKernel(Samples, 0.4f), passes);
+    benchmark::DoNotOptimize(BlurKernel::BuildLinearTaps(kernel, MaxTaps));
+  }
+}
+BENCHMARK(BM_BlurKernelBuild)->Arg(13)->Arg(50)->ArgName("passes")->Unit(benchmark::kMicrosecond);
+
+void BM_MaskTilesClassify(benchmark::State &state)
+{
+  int maskWidth{}, maskHeight{}, maskChannels{};
+  stbi_set_flip_vertically_on_load(false);
+  uint8_t *mask = stbi_load(GradientMaskTexturePath, &maskWidth, &maskHeight, &maskChannels, 0);
+  if (!mask)
+  {
+    state.SkipWithError("Failed to load the mask");
+    return;
+  }
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(MaskTiles::Classify(mask, maskWidth, maskHeight, maskChannels, 1920, 1080));
+  stbi_image_free(mask);
+}
+BENCHMARK(BM_MaskTilesClassify)->Unit(benchmark::kMicrosecond);
+}// namespace
+
+int main(int argc, char **argv)
+{
+  HeadlessContext context;
+  if (!context.Initialize(ContextSize, ContextSize))
+    return EXIT_FAILURE;
+  // Surfaceless context has no default framebuffer, draws into it would be dropped
+  glBindFramebuffer(GL_FRAMEBUFFER, context.GetFramebuffer());
+
+  // JSON goes first, so that --benchmark_format from the command line still takes over
+  std::vector<char *> arguments(argv, argv + argc);
+  char jsonFormat[] = "--benchmark_format=json";
+  arguments.insert(arguments.begin() + 1, jsonFormat);
+  int argumentsCount = static_cast<int>(arguments.size());
+
+  benchmark::Initialize(&argumentsCount, arguments.data());
+  if (benchmark::ReportUnrecognizedArguments(argumentsCount, arguments.data()))
+    return EXIT_FAILURE;
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return EXIT_SUCCESS;
+}
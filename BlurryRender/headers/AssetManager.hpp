@@ -0,0 +1,109 @@
+#pragma once
+#include "TextureLoader.hpp"
+#include "Utility.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Residency of scene assets.
+// Textures are requested up front but only loaded once something Touches them, the texture name is valid from the
+// request on and shows the loader's placeholder until levels arrive. Every frame Update() evicts the least recently
+// used textures not touched during the previous frame while the GPU bytes of textures are over the budget; evicted
+// textures go back to the placeholder and stream again on their next Touch.
+// Meshes live in the append-only geometry arena, so they are only accounted for.
+class AssetManager : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  static constexpr size_t DefaultTextureBudget = 512 * 1024 * 1024;
+
+  struct Statistics
+  {
+    u32 textures = 0;
+    // Textures with all their levels uploaded
+    u32 resident = 0;
+    u32 streaming = 0;
+    // Textures whose image couldn't be decoded, they stay on the placeholder
+    u32 failed = 0;
+    u32 evictions = 0;
+    size_t gpuBytes = 0;
+    // Mesh copies kept in memory and decoded images waiting for upload
+    size_t cpuBytes = 0;
+  };
+
+  AssetManager() = default;
+  ~AssetManager();
+
+  // The loader has to outlive the manager, its level callback is taken over
+  void Initialize(TextureLoader &loader, size_t textureBudget = DefaultTextureBudget);
+  // Deletes all textures
+  void Release();
+
+  void SetTextureBudget(size_t budget) { m_textureBudget = budget; }
+  size_t GetTextureBudget() const { return m_textureBudget; }
+
+  // Same path and flip give the same texture
+  u32 RequestTexture(const std::string &path,
+    bool flipVertically = false,
+    TextureLoader::LoadedCallback onLoaded = nullptr);
+  // Marks the texture used this frame, starts loading it if it isn't resident
+  void Touch(u32 texture);
+
+  void TrackMesh(const std::string &name, size_t cpuBytes, size_t gpuBytes);
+
+  // Once per frame, before the frame's Touches
+  void Update();
+
+  Statistics GetStatistics() const;
+  // Levels uploaded and textures evicted so far, textures look different whenever it changes
+  u32 GetChangesCount() const { return m_changes; }
+
+private:
+  enum class State
+  {
+    Unloaded,
+    Loading,
+    Resident,
+    // Image couldn't be decoded, the texture keeps the placeholder and isn't loaded again
+    Failed
+  };
+
+  struct TextureAsset
+  {
+    std::string path;
+    bool flipVertically;
+    TextureLoader::LoadedCallback onLoaded;
+    State state = State::Unloaded;
+    uint64_t lastUsedFrame = 0;
+    u32 levelsCount = 0;
+    size_t gpuBytes = 0;
+  };
+
+  struct MeshAsset
+  {
+    std::string name;
+    size_t cpuBytes;
+    size_t gpuBytes;
+  };
+
+  void OnLevelUploaded(u32 texture, u32 levelsCount, size_t size);
+  void Evict(u32 texture, TextureAsset &asset);
+
+private:
+  TextureLoader *m_loader = nullptr;
+  size_t m_textureBudget = DefaultTextureBudget;
+  uint64_t m_frame = 0;
+
+  std::unordered_map<u32, TextureAsset> m_textures;
+  std::unordered_map<std::string, u32> m_texturesByPath;
+  std::vector<MeshAsset> m_meshes;
+
+  size_t m_textureBytes = 0;
+  u32 m_evictions = 0;
+  u32 m_changes = 0;
+  // Scratch list of eviction candidates
+  std::vector<std::pair<uint64_t, u32>> m_leastRecentlyUsed;
+};
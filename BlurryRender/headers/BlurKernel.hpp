@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Blur weights computed on CPU once instead of per pixel in the shaders
+namespace BlurKernel
+{
+// Discrete 1D kernel, weights[i] is applied to the texel at offset `first + i`
+struct Kernel
+{
+  int32_t first = 0;
+  std::vector<float> weights = { 1.0f };
+
+  int32_t GetLast() const { return first + static_cast<int32_t>(weights.size()) - 1; }
+};
+
+// Pair of neighbouring taps merged into one bilinear fetch between them
+struct LinearTap
+{
+  float offset;
+  float weight;
+};
+
+// Box filter of 2 * radius + 1 equal weights centered at `offset`, a fractional offset is a bilinear fetch between
+// the texels
+struct Box
+{
+  int32_t radius;
+  float offset;
+};
+
+// Weights of one blur.frag pass: GaussianFilter() over offsets [-samples / 2, samples / 2), normalized by their sum
+Kernel BuildPassKernel(int32_t samples, float sigmaFactor);
+
+// Kernel applied `times` in a row, i.e. convolved with itself, an identity kernel for 0
+Kernel Compose(const Kernel &kernel, uint32_t times);
+
+// Standard deviation in texels, passes compose into a kernel with sqrt(times) larger one
+float GetStandardDeviation(const Kernel &kernel);
+// Weighted mean offset in texels, blur.frag passes are centered half a texel before the pixel
+float GetMean(const Kernel &kernel);
+
+// Negligible tails are trimmed, and trimmed harder until the kernel has at most maxWeights, weights sum to 1
+Kernel BuildTrimmedKernel(const Kernel &kernel, uint32_t maxWeights);
+
+// `count` boxes applied in a row, their convolution approximates a Gaussian of the kernel's standard deviation and
+// is shifted by its mean. The whole texels of the shift are spread over the boxes, the first one takes the fraction.
+std::vector<Box> BuildBoxes(const Kernel &kernel, uint32_t count);
+
+// Merges neighbouring taps into bilinear fetches, so GPU needs half as many texture reads.
+// Negligible tails are trimmed, and trimmed harder until the result fits into maxTaps.
+std::vector<LinearTap> BuildLinearTaps(const Kernel &kernel, uint32_t maxTaps);
+}// namespace BlurKernel
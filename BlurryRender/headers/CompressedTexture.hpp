@@ -0,0 +1,52 @@
+#pragma once
+#include "Utility.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Block-compressed textures with the whole mip chain baked offline into DDS files next to the source images.
+// Single channel images are baked as BC4, RGB as BC1 and RGBA as BC7, so every one samples exactly like its
+// uncompressed original did in the shaders. The baked file of "textures/back.jpg" is "textures/back.dds",
+// it is used only while it is newer than the source image.
+namespace CompressedTexture
+{
+struct Level
+{
+  uint32_t width;
+  uint32_t height;
+  // Relative to Image::data
+  size_t offset;
+  size_t size;
+};
+
+struct Image
+{
+  uint32_t internalFormat = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<Level> levels;
+
+  // All levels one after another, points into the mapped file
+  const uint8_t *data = nullptr;
+  size_t dataSize = 0;
+  std::unique_ptr<Utility::MappedFile> file;
+};
+
+std::string GetBakedPath(const std::string &sourcePath);
+
+// Baked file exists, is up to date and its format is supported by the current context
+bool HasBakedFile(const std::string &sourcePath);
+
+bool Load(const std::string &bakedPath, Image &image);
+
+// Specifies all mip levels of the bound GL_TEXTURE_2D, `data` is either Image::data or an offset into
+// the bound GL_PIXEL_UNPACK_BUFFER holding the same bytes
+void TexImage(const Image &image, const void *data);
+// Specifies a single level, `data` points at the level itself (or is its offset in the bound unpack buffer)
+void TexLevel(const Image &image, size_t level, const void *data);
+
+// Needs current GL context, the driver does the compression
+bool Bake(const std::string &sourcePath);
+}// namespace CompressedTexture
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// CPU backend of the masked separable Gaussian blur from shaders/blur.frag, for nodes without a GPU.
+// Every pass blurs along one axis with `samples` taps and mixes the result with the pass input by mask value,
+// exactly like RenderPostProcessing does on the GPU. Rows are processed in parallel by all cores with AVX2/SSE4.1
+// kernels (picked at runtime), passes along columns run on a cache-blocked transposed copy of the image.
+//
+// Images are tightly packed interleaved pixels with rows in OpenGL order (bottom row first), i.e. what
+// glReadPixels/glGetTexImage return. The 8-bit path rounds every pass to 8 bits like the GL_RGB8 blur targets do,
+// and matches the GPU result within Tolerance8Bit per channel. Only where the mask is just below 1.0 repeated
+// rounding can settle on a different value, that's allowed for at most OutliersFraction of channels.
+// The float path skips the rounding, so it's closer to the exact result than to the GPU one.
+namespace CpuBlur
+{
+constexpr uint32_t Tolerance8Bit = 2;
+constexpr double OutliersFraction = 1e-4;
+
+struct Settings
+{
+  uint32_t passes = 25;
+  int32_t samples = 8;
+  float sigmaFactor = 0.4f;
+  // Value of the `horizontal` uniform for the first pass, blur.frag blurs along image columns when it is set
+  bool horizontal = true;
+  // Worker threads, 0 means all hardware threads
+  uint32_t threads = 0;
+};
+
+// Mask holds one value in [0, 1] per image pixel, nullptr blurs the whole image
+void Blur(uint8_t *pixels, uint32_t width, uint32_t height, uint32_t channels, const float *mask, const Settings &settings);
+void Blur(float *pixels, uint32_t width, uint32_t height, uint32_t channels, const float *mask, const Settings &settings);
+
+// Bilinear resampling of the mask red channel to image size, the same way maskTexture is sampled in blur.frag
+std::vector<float> ResampleMask(const uint8_t *mask,
+  uint32_t maskWidth,
+  uint32_t maskHeight,
+  uint32_t maskChannels,
+  uint32_t width,
+  uint32_t height);
+
+// Name of the instruction set the kernels run with on this machine
+const char *GetInstructionSet();
+}// namespace CpuBlur
@@ -0,0 +1,21 @@
+#pragma once
+
+// Runtime detection of the instruction sets SIMD code paths are picked by.
+// CPU_FEATURES_X86 is defined where the x86 intrinsics are available, CPU_TARGET(isa) then compiles a single function
+// for a newer instruction set than the rest of the file (GCC and Clang need that, MSVC emits any intrinsic anyway).
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_FEATURES_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define CPU_TARGET(isa)
+#else
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace CpuFeatures
+{
+bool HasSSE41();
+// AVX2 and FMA, with the OS saving YMM registers
+bool HasAVX2();
+}// namespace CpuFeatures
@@ -0,0 +1,81 @@
+#pragma once
+#include "VertexPacking.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// View frustum culling of scene objects by their world space bounding boxes.
+// Objects are kept in a wide BVH whose nodes store the boxes of their NodeWidth children SoA, so a node is tested
+// against a frustum plane with one AVX2 instruction sequence (two SSE ones), picked at runtime like CpuBlur does.
+// Subtrees fully inside the frustum are accepted without testing their boxes any further.
+namespace Culling
+{
+using Bounds = VertexPacking::Bounds;
+
+// Planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+struct Frustum
+{
+  std::array<glm::vec4, 6> planes;
+};
+
+// Planes of the clip space volume of viewProjection, normalized
+Frustum ExtractFrustum(const glm::mat4 &viewProjection);
+
+// Box enclosing the given one transformed by an affine transform
+Bounds Transform(const Bounds &bounds, const glm::mat4 &transform);
+
+// Per-frame counters, boxes tested include BVH nodes as well as objects
+struct Statistics
+{
+  uint32_t tested = 0;
+  uint32_t culled = 0;
+  uint32_t visible = 0;
+};
+
+class Bvh
+{
+  using u32 = uint32_t;
+
+public:
+  static constexpr u32 NodeWidth = 8;
+
+  void Build(const std::vector<Bounds> &objects);
+  void Clear();
+
+  // visible[i] becomes 1 for objects intersecting the frustum and 0 for the others
+  Statistics Cull(const Frustum &frustum, std::vector<uint8_t> &visible) const;
+
+  u32 GetObjectsCount() const { return static_cast<u32>(m_objects.size()); }
+  u32 GetNodesCount() const { return static_cast<u32>(m_nodes.size()); }
+
+private:
+  // Unused child slots have empty boxes which are outside of any frustum
+  struct alignas(32) Node
+  {
+    float minX[NodeWidth];
+    float minY[NodeWidth];
+    float minZ[NodeWidth];
+    float maxX[NodeWidth];
+    float maxY[NodeWidth];
+    float maxZ[NodeWidth];
+    // Node index when not negative, ~objectIndex of a single object otherwise
+    int32_t children[NodeWidth];
+    u32 childrenCount;
+    // The subtree holds objects m_objects[first, first + count)
+    u32 first;
+    u32 count;
+  };
+
+  u32 BuildNode(const std::vector<Bounds> &objects, const std::vector<glm::vec3> &centers, u32 first, u32 count);
+
+private:
+  std::vector<Node> m_nodes;
+  // Object indices in the BVH order
+  std::vector<u32> m_objects;
+};
+
+const char *GetInstructionSet();
+}// namespace Culling
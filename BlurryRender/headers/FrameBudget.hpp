@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+// Holds the GPU frame time around a target by trading image quality for it.
+// Measured frame times are smoothed, going over the target first lowers blur quality level by level and then the
+// internal render scale step by step; once there is enough headroom they are restored in the reverse order. After
+// every change the controller waits a few frames, the profiler reports times with latency and a new render scale
+// takes a frame to settle. Zero target disables it, full quality is kept then.
+class FrameBudget
+{
+  using u32 = uint32_t;
+
+public:
+  struct Settings
+  {
+    double targetMs = 0.0;
+    // Render scale range and how much a single change moves it
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scaleStep = 0.05f;
+    // Highest blur quality level, 0 is full quality
+    u32 maxBlurLevel = 0;
+    // Quality goes up again only below this share of the target
+    double headroom = 0.8;
+    u32 cooldownFrames = 8;
+  };
+
+  // Out of range settings are clamped, quality goes back to full
+  void SetSettings(const Settings &settings);
+  const Settings &GetSettings() const { return m_settings; }
+  bool IsEnabled() const { return m_settings.targetMs > 0.0; }
+
+  // Feeds GPU time of a frame, true when render scale or blur level changed
+  bool Update(double gpuMs);
+  void Reset();
+
+  float GetRenderScale() const { return m_renderScale; }
+  u32 GetBlurLevel() const { return m_blurLevel; }
+  double GetSmoothedMs() const { return m_smoothedMs; }
+
+private:
+  bool Degrade();
+  bool Improve();
+
+private:
+  Settings m_settings;
+  float m_renderScale = 1.0f;
+  u32 m_blurLevel = 0;
+  // Negative until the first frame after a reset or a change
+  double m_smoothedMs = -1.0;
+  u32 m_cooldown = 0;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include "Culling.hpp"
+#include "IndirectBatch.hpp"
+#include "Utility.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything the GL thread needs to submit a frame's scene, built on the pipeline worker
+struct FramePacket
+{
+  // Snapshot of the renderer state the frame is built from, taken on the GL thread
+  struct Input
+  {
+    double time = 0.0;
+    float cameraZoom = 45.0f;
+    float aspectRatio = 1.0f;
+    // Scene changes counted up to the snapshot, tells whether the packet is up to date
+    uint32_t sceneVersion = 0;
+  };
+  Input input;
+
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 lightPosition;
+  glm::mat4 lightModel;
+  // View depth of the light source divided by the far plane
+  float lightDepth = 0.0f;
+
+  Culling::Statistics culling;
+  std::vector<uint8_t> visibleObjects;
+  // Visible objects, its buffers are the packet's own, so they aren't overwritten while the GPU reads them
+  IndirectBatch sceneBatch;
+  // Textures of the visible objects, consecutive duplicates dropped
+  std::vector<uint32_t> usedTextures;
+};
+
+// Two stage frame pipeline: while the GL thread submits frame N from its packet, the worker prepares the packet of
+// frame N + 1, so the CPU frame time is the slower of the two stages rather than their sum.
+// Packets are double buffered. The GL thread owns a packet from the moment Next() returns it until the following
+// Next(), which is when it goes back to the worker; it only uploads the packet's batch meanwhile. Whatever the
+// prepare function reads besides the packet input must not change while the worker runs, Flush() waits for it and
+// makes the next frame be prepared from scratch.
+class FramePipeline : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  // Runs on the worker, fills the packet from its input
+  using PrepareFunction = std::function<void(FramePacket &packet)>;
+
+  FramePipeline() = default;
+  ~FramePipeline();
+
+  // Needs current GL context for the packet batches
+  void Initialize(PrepareFunction prepare);
+  void Release();
+
+  // Packet of the current frame, waits for the worker if it isn't ready yet. The next frame starts being prepared
+  // from `input` right away.
+  FramePacket &Next(const FramePacket::Input &input);
+
+  // Waits for the worker and drops the packet it prepared
+  void Flush();
+
+private:
+  void WorkerLoop();
+  void Start(u32 packet, const FramePacket::Input &input);
+  void Wait();
+
+private:
+  static constexpr u32 PacketsCount = 2;
+
+  std::array<FramePacket, PacketsCount> m_packets;
+  PrepareFunction m_prepare;
+  // Packet the next frame uses
+  u32 m_current = 0;
+  // The current packet is being prepared or is ready
+  bool m_inFlight = false;
+
+  std::thread m_worker;
+  std::mutex m_mutex;
+  std::condition_variable m_started;
+  std::condition_variable m_finished;
+  // Packet the worker prepares, or -1
+  int32_t m_preparing = -1;
+  bool m_stopping = false;
+};
@@ -1,7 +1,20 @@
 #pragma once
+#include "AssetManager.hpp"
+#include "BlurKernel.hpp"
 #include "camera.h"
+#include "CpuBlur.hpp"
+#include "FramePipeline.hpp"
+#include "Culling.hpp"
+#include "FrameBudget.hpp"
+#include "GeometryArena.hpp"
+#include "GpuProfiler.hpp"
+#include "IndirectBatch.hpp"
+#include "RenderGraph.hpp"
+#include "RenderQueue.hpp"
+#include "StateCache.hpp"
+#include "TextureLoader.hpp"
 #include "Shader.hpp"
-#include "Model.h"
+#include "model.h"
 #include "Primitives.hpp"
 
 #include <array>
@@ -11,15 +24,133 @@ class GLRenderer
   using u32 = uint32_t;
 
 public:
+  // Only Separable mixes the mask in every pass, the other modes mix it once after the whole blur. They are
+  // approximations that differ from it wherever the mask is between 0 and 1, see --compare-blur of headless.cpp.
+  enum class BlurMode
+  {
+    // m_blurPasses ping-pong passes of blur.frag, the reference and the default
+    Separable,
+    // Single pass per axis with equivalent kernel of all the passes computed on CPU
+    EquivalentKernel,
+    // Downsample and upsample through a mip pyramid, depth is picked from the equivalent blur radius
+    DualKawase,
+    // Equivalent kernel convolved by compute shaders from a line segment cached in shared memory
+    ComputeShared,
+    // Equivalent kernel approximated by box filters a compute shader slides along whole lines, within the CPU blur
+    // tolerance of EquivalentKernel
+    ComputeRunningSum,
+    Count
+  };
+
   GLRenderer(u32 width, u32 height);
   ~GLRenderer();
 
   void Initialize();
-  
+  // Blocks until every texture used so far is uploaded, textures nothing rendered yet stay unloaded
+  void FinishLoading() { m_textureLoader.Finish(); }
+
+  // Textures over the budget are evicted least recently used first
+  void SetTextureBudget(size_t budget) { m_assets.SetTextureBudget(budget); }
+  AssetManager::Statistics GetAssetStatistics() const { return m_assets.GetStatistics(); }
+
   u32 GetWidth() const { return m_width; }
   u32 GetHeight() const { return m_height; }
+  // Size scene and post-processing are rendered at, compose upscales it to the output size
+  u32 GetRenderWidth() const { return m_renderWidth; }
+  u32 GetRenderHeight() const { return m_renderHeight; }
+
+  // Output size changed, render targets are reallocated. Zero sizes, as of a minimized window, are ignored.
+  void OnResize(u32 width, u32 height);
+
+  // GPU frame time the frame budget holds by lowering the render scale, 0 keeps full quality. Only with
+  // lowerBlurMode it may also switch to a cheaper blur mode than the selected one.
+  void SetFrameTimeTarget(double targetMs, bool lowerBlurMode = false);
+  const FrameBudget &GetFrameBudget() const { return m_frameBudget; }
+
+  void SetCameraPosition(const glm::vec3 position)
+  {
+    m_camera.SetPosition(position);
+    MarkSceneChanged();
+  }
+
+  // Framebuffer the final composed image is presented into, 0 is the window's default framebuffer
+  void SetOutputFramebuffer(u32 framebuffer)
+  {
+    m_outputFBO = framebuffer;
+    m_outputDirty = true;
+  }
+
+  // Paused clock stops the camera and the light, frames then show something new only when the input changes
+  void SetAnimationPaused(bool paused) { m_animationPaused = paused; }
+  bool IsAnimationPaused() const { return m_animationPaused; }
+
+  // Something changed since the last frame, or will by itself: the clock runs or textures are streaming.
+  // Otherwise the next frame would only present the same image again, so the caller may wait instead.
+  bool NeedsRender() const;
+  // Output lost its contents, e.g. the window was uncovered, the next frame has to be presented
+  void InvalidateOutput() { m_outputDirty = true; }
+
+  // How much of the frames rendered so far had to be redone
+  struct FrameStatistics
+  {
+    u32 frames = 0;
+    u32 sceneFrames = 0;
+    u32 postProcessingFrames = 0;
+  };
+  const FrameStatistics &GetFrameStatistics() const { return m_frameStatistics; }
 
-  void SetCameraPosition(const glm::vec3 position) { m_camera.SetPosition(position); }
+  // Inputs of the last post-processing, enough to reproduce it on CPU. The scene texture is 0 when the scene was
+  // drawn straight to the output, it's valid until the next frame.
+  u32 GetSceneColorBuffer() const { return m_sceneColorBuffer; }
+  u32 GetMaskTexture() const { return m_maskTexture; }
+  CpuBlur::Settings GetBlurSettings() const;
+
+  BlurMode GetBlurMode() const { return m_blurMode; }
+  void SetBlurMode(BlurMode mode)
+  {
+    m_blurMode = mode;
+    m_postProcessingDirty = true;
+  }
+  // Blur mode post-processing runs, the frame budget picks a cheaper one than the selected mode only when
+  // SetFrameTimeTarget allowed it
+  BlurMode GetEffectiveBlurMode() const;
+  static const char *GetBlurModeName(BlurMode mode);
+
+  // Post-processes and composes the last frame's scene again with another blur mode, to compare the modes
+  void RepeatPostProcessing(BlurMode mode);
+
+  // Off, the scene is presented without blur
+  void SetPostProcessingBlur(bool enabled)
+  {
+    m_postProcessingBlur = enabled;
+    m_postProcessingDirty = true;
+  }
+
+  // Separable blur covers only the tiles the mask doesn't make fully sharp
+  void SetTiledBlur(bool tiledBlur)
+  {
+    m_tiledBlur = tiledBlur;
+    m_postProcessingDirty = true;
+  }
+
+  const GpuProfiler &GetProfiler() const { return m_profiler; }
+  void SetProfilerFlushPerPass(bool flushPerPass) { m_profiler.SetFlushPerPass(flushPerPass); }
+
+  // Static field of cubes and backpacks around the scene drawn instanced, to measure how drawing scales.
+  // Zero counts remove it. Must be called after Initialize.
+  void SetStressScene(u32 cubes, u32 models);
+  u32 GetStressInstancesCount() const { return static_cast<u32>(m_sceneObjects.size()) - m_demoObjectsCount; }
+
+  // Mask tiles of the current render size the separable blur skips as sharp and the ones it covers
+  u32 GetSharpTilesCount() const { return m_sharpTilesCount; }
+  u32 GetBlurTilesCount() const { return m_blurTilesCount; }
+  // Frustum culling counters of the last rendered frame
+  const Culling::Statistics &GetCullingStatistics() const { return m_cullingStatistics; }
+  // Binds of the last rendered frame issued to GL and skipped as redundant
+  const StateCache::Statistics &GetStateStatistics() const { return m_stateCache.GetStatistics(); }
+  u32 GetRenderQueuePacketsCount() const { return m_renderQueue.GetPacketsCount(); }
+  // Passes and transient targets of the last rendered frame
+  const RenderGraph::Statistics &GetRenderGraphStatistics() const { return m_renderGraph.GetStatistics(); }
 
   void OnKeyDown(u32 key);
 
@@ -33,48 +164,252 @@ private:
   void CreateShaders();
   void ConfigureShaders();
 
-  void ConfigureFramebuffer();
+  void CreateBlurBuffers();
+  void UpdateChessboard();
+  void UpdateRenderSize();
+  void UpdateFrameBudget();
+
+  // Camera, light or anything else the frame pipeline builds the scene from changed
+  void MarkSceneChanged() { ++m_sceneVersion; }
+  void AdvanceAnimationClock();
+
+  // Frame passes declared into the render graph, Add*Blur* ones return the blurred image
+  RenderGraph::TextureDesc GetRenderTargetDesc(u32 format) const;
+  void AddScenePasses(RenderGraph::Handle color, RenderGraph::Handle depth);
+  RenderGraph::Handle AddPostProcessingPasses(RenderGraph::Handle sceneColor);
+  RenderGraph::Handle AddSeparableBlurPass(RenderGraph::Handle sceneColor);
+  RenderGraph::Handle AddEquivalentKernelBlurPass(RenderGraph::Handle sceneColor);
+  RenderGraph::Handle AddDualKawaseBlurPasses(RenderGraph::Handle sceneColor);
+  RenderGraph::Handle AddComputeSharedBlurPass(RenderGraph::Handle sceneColor);
+  RenderGraph::Handle AddComputeRunningSumBlurPass(RenderGraph::Handle sceneColor);
+  void AddComposePass(RenderGraph::Handle image, RenderGraph::Handle output);
+
+  void RenderCompose(u32 image, u32 framebuffer);
 
-  inline void ClearFrame() const;
+  // Runs on the frame pipeline worker: camera, light, culling and the scene batch of the frame
+  void PrepareFrame(FramePacket &frame) const;
+  // Records background and scene draws from the frame's packet
+  void BuildRenderQueue();
+  void RenderScene(u32 framebuffer);
+  void RenderBackground(u32 framebuffer);
+  void RenderSeparableBlur(const RenderGraph::Context &context,
+    RenderGraph::Handle sceneColor,
+    const std::array<RenderGraph::Handle, 2> &targets);
+  void RenderEquivalentKernelBlur(const RenderGraph::Context &context,
+    RenderGraph::Handle sceneColor,
+    RenderGraph::Handle firstAxis,
+    RenderGraph::Handle blurred);
+  // Sharp is mixed in by mask, when given
+  void RenderKawasePass(const RenderGraph::Context &context,
+    Shader &shader,
+    Shader::UniformHandle applyMask,
+    RenderGraph::Handle input,
+    RenderGraph::Handle output,
+    RenderGraph::Handle sharp = RenderGraph::InvalidHandle);
+  void RenderComputeSharedBlur(const RenderGraph::Context &context,
+    RenderGraph::Handle sceneColor,
+    RenderGraph::Handle firstAxis,
+    RenderGraph::Handle blurred);
+  void RenderComputeRunningSumBlur(const RenderGraph::Context &context,
+    RenderGraph::Handle sceneColor,
+    const std::array<RenderGraph::Handle, 2> &intermediates,
+    RenderGraph::Handle blurred,
+    int32_t padding);
 
-  void RenderScene();
-  void RenderBackground();
-  void RenderPostProcessing();
+  void AddSceneObject(const GeometryArena::Allocation &geometry,
+    const Culling::Bounds &bounds,
+    u32 texture,
+    const IndirectBatch::DrawData &data);
+  void AddModelObjects(const Model &model, const glm::mat4 *transforms, size_t count);
+
+  void UpdateBlurKernel();
+  void ClassifyMaskTiles();
 
 private:
+  Shader m_chessboardShader;
   Shader m_backgroundShader;
   Shader m_blurShader;
   Shader m_sceneShader;
   Shader m_lightSourceShader;
   Shader m_composeShader;
+  Shader m_blurKernelShader;
+  Shader m_kawaseDownShader;
+  Shader m_kawaseUpShader;
+  Shader m_blurTileShader;
+  Shader m_copyTileShader;
+  Shader m_computeSharedBlurShader;
+  Shader m_runningSumBlurShader;
+
+  // Per-frame uniforms of the scene pass resolved once, so that it doesn't look names up every frame
+  struct SceneUniforms
+  {
+    Shader::UniformHandle model;
+    Shader::UniformHandle view;
+    Shader::UniformHandle projection;
+    Shader::UniformHandle lightPosition;
+    Shader::UniformHandle viewPos;
+  };
+  SceneUniforms m_sceneUniforms;
+  SceneUniforms m_lightSourceUniforms;
+
+  // Per-pass uniforms of the blur shaders, resolved once the same way
+  struct SeparableBlurUniforms
+  {
+    Shader::UniformHandle samples;
+    Shader::UniformHandle sigmaFactor;
+    Shader::UniformHandle horizontal;
+  };
+  SeparableBlurUniforms m_blurUniforms;
+  SeparableBlurUniforms m_blurTileUniforms;
+
+  struct BlurKernelUniforms
+  {
+    Shader::UniformHandle direction;
+    Shader::UniformHandle tapsCount;
+    Shader::UniformHandle applyMask;
+  };
+  BlurKernelUniforms m_blurKernelUniforms;
+
+  // Downsampling has no mask
+  Shader::UniformHandle m_kawaseUpApplyMask;
 
+  struct ComputeSharedBlurUniforms
+  {
+    Shader::UniformHandle axis;
+    Shader::UniformHandle weightsOffset;
+    Shader::UniformHandle weightsCount;
+    Shader::UniformHandle first;
+    Shader::UniformHandle applyMask;
+  };
+  ComputeSharedBlurUniforms m_computeSharedBlurUniforms;
+
+  struct RunningSumBlurUniforms
+  {
+    Shader::UniformHandle axis;
+    Shader::UniformHandle lineSize;
+    Shader::UniformHandle linesCount;
+    Shader::UniformHandle radius;
+    Shader::UniformHandle offset;
+    Shader::UniformHandle inputPadding;
+    Shader::UniformHandle outputPadding;
+    Shader::UniformHandle inputExtent;
+    Shader::UniformHandle outputExtent;
+    Shader::UniformHandle applyMask;
+  };
+  RunningSumBlurUniforms m_runningSumBlurUniforms;
+
+  bool m_initialized;
   bool m_postProcessingBlur;
-  bool m_horizontal;
 
-  u32 m_sceneFBO;
+  u32 m_outputFBO;
+
+  // Render graph texture the last frame's scene went to
   u32 m_sceneColorBuffer;
-  static constexpr u32 BlurFramebuffersCount = 2;
-  std::array<u32, BlurFramebuffersCount> m_blurFBO;
-  std::array<u32, BlurFramebuffersCount> m_blurColorBuffers;
+  // Image compose read last frame, 0 when the scene went straight to the output
+  u32 m_composeImage;
+
+  // Damage tracking. The scene is rendered while the version of the last rendered packet is behind, post-processing
+  // runs again after that or when its parameters changed, otherwise the last composed image is presented again.
+  u32 m_sceneVersion;
+  u32 m_renderedSceneVersion;
+  u32 m_assetChanges;
+  bool m_postProcessingDirty;
+  bool m_outputDirty;
+  FrameStatistics m_frameStatistics;
+
+  // Animation time the camera and the light move by, it stands still while paused
+  bool m_animationPaused;
+  double m_animationTime;
+  double m_clockTime;
+
+  // Chessboard depends on the render size only, it's drawn into the texture again when that changes
+  u32 m_chessboardFBO;
+  u32 m_chessboardTexture;
 
   float m_blurSigma;
   u32 m_blurPasses;
 
-  // Probably should be some vector with primitives for more extensive usage
-  Primitive m_cube;
-  Primitive m_plane;
+  BlurMode m_blurMode;
+  // Taps of the equivalent kernel for both axes and blur parameters they were built for
+  u32 m_blurKernelUBO;
+  std::array<u32, 2> m_blurKernelTapsCount;
+  float m_blurKernelSigma;
+  u32 m_blurKernelPasses;
+
+  // Compute blur: discrete equivalent kernels of both axes and box filters approximating them
+  struct ComputeBlurKernel
+  {
+    int32_t first;
+    u32 weightsCount;
+  };
+  u32 m_blurWeightsSSBO;
+  std::array<ComputeBlurKernel, 2> m_computeBlurKernels;
+  std::array<std::vector<BlurKernel::Box>, 2> m_blurBoxes;
+
+  // Dual Kawase pyramid, level i is 2^(i + 1) times smaller than the frame
+  static constexpr u32 MaxPyramidLevels = 8;
+  // Pyramid depth equivalent to m_blurSigma and m_blurPasses
+  u32 m_pyramidLevels;
+
+  // Instanced tile quads: sharp tiles first, then the ones blur passes have to cover
+  bool m_tiledBlur;
+  u32 m_tileVAO;
+  u32 m_tileVBO;
+  u32 m_sharpTilesCount;
+  u32 m_blurTilesCount;
+
   Primitive m_quad;
-  LightPrimitive m_lightSource;
+
+  // All scene geometry, the model included, is suballocated from the arena
+  GeometryArena m_geometryArena;
+  GeometryArena::Allocation m_cubeGeometry;
+  GeometryArena::Allocation m_planeGeometry;
+  Culling::Bounds m_cubeBounds;
+  Culling::Bounds m_planeBounds;
+
+  // Background and scene draws of the frame, issued sorted through the state cache like the rest of the frame
+  RenderQueue m_renderQueue;
+  StateCache m_stateCache;
+  // Passes of the frame and the pool of their targets
+  RenderGraph m_renderGraph;
+
+  // Everything the scene pass draws but the light source, the demo scene first and then the stress scene.
+  // Objects are culled by their world bounds every frame, only the visible ones go into the frame's batch.
+  // Changing them has to flush the frame pipeline first.
+  struct SceneObject
+  {
+    GeometryArena::Allocation geometry;
+    u32 texture;
+    IndirectBatch::DrawData data;
+  };
+  std::vector<SceneObject> m_sceneObjects;
+  std::vector<Culling::Bounds> m_sceneObjectBounds;
+  u32 m_demoObjectsCount = 0;
+  Culling::Bvh m_sceneBvh;
+  Culling::Statistics m_cullingStatistics;
 
   u32 m_cubeTexture;
   u32 m_planeTexture;
   u32 m_maskTexture;
 
+  TextureLoader m_textureLoader;
+  // Scene textures are loaded on first use through it, after the loader so that it's released first
+  AssetManager m_assets;
   Model m_model;
 
+  GpuProfiler m_profiler;
+  FrameBudget m_frameBudget;
+  // Profiler frames the budget has seen
+  u32 m_budgetFrames;
+
   Camera m_camera;
   glm::vec3 m_lightPosition;
 
   u32 m_width;
   u32 m_height;
+  u32 m_renderWidth;
+  u32 m_renderHeight;
+
+  // Last, so that its worker is stopped before anything it reads is destroyed
+  FramePipeline m_framePipeline;
 };
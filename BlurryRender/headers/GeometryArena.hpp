@@ -0,0 +1,85 @@
+#pragma once
+#include "Utility.hpp"
+#include "VertexPacking.hpp"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+// Shared vertex and index buffers meshes are suballocated from, instead of a VAO and two buffers per mesh.
+// There is a pool per vertex format and index type with one VAO, so every mesh of a pool can go into a single
+// glMultiDrawElementsIndirect. Pools grow by doubling, allocations are never freed until Release.
+// Every VAO also feeds DrawIdAttribute from a per-instance 0, 1, 2... buffer, so an indirect command with
+// baseInstance N gives its vertices draw id N and its instances N + 1, N + 2..., see IndirectBatch.
+class GeometryArena : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  static constexpr u32 InvalidPool = UINT32_MAX;
+  static constexpr u32 DrawIdAttribute = 5;
+  static constexpr u32 InitialDrawIds = 4096;
+
+  // Where a mesh lives in its pool, arguments of glDrawElementsBaseVertex or an indirect command
+  struct Allocation
+  {
+    u32 pool = InvalidPool;
+    u32 indexCount = 0;
+    u32 firstIndex = 0;
+    int32_t baseVertex = 0;
+
+    bool IsValid() const { return pool != InvalidPool; }
+  };
+
+  GeometryArena() = default;
+  ~GeometryArena();
+
+  void Release();
+
+  // Vertices are Vertex or PackedVertex as the format says, indices are narrowed to 16 bits when the mesh fits
+  Allocation Allocate(VertexFormat format,
+    const void *vertices,
+    size_t vertexCount,
+    const unsigned int *indices,
+    size_t indexCount);
+
+  u32 GetVAO(u32 pool) const { return m_pools[pool].vao; }
+  GLenum GetIndexType(u32 pool) const { return m_pools[pool].indexType; }
+  size_t GetIndexSize(u32 pool) const { return GetIndexTypeSize(m_pools[pool].indexType); }
+
+  // Bytes of vertex and index data allocated so far
+  size_t GetUsedSize() const;
+
+  // Grows the draw id buffer of every pool to at least count ids
+  void ReserveDrawIds(u32 count);
+  u32 GetDrawIdsCount() const { return m_drawIdsCount; }
+
+  void Draw(const Allocation &allocation) const;
+
+private:
+  struct Pool
+  {
+    VertexFormat format;
+    GLenum indexType;
+    u32 vao = 0;
+    u32 vertexBuffer = 0;
+    u32 indexBuffer = 0;
+    size_t vertexSize = 0;
+    size_t vertexCapacity = 0;
+    size_t vertexCount = 0;
+    size_t indexCapacity = 0;
+    size_t indexCount = 0;
+  };
+
+  u32 GetPool(VertexFormat format, GLenum indexType);
+  void Reserve(Pool &pool, size_t vertexCount, size_t indexCount);
+  static void SetupVertexFormat(u32 vao, VertexFormat format);
+  void BindDrawIds(const Pool &pool) const;
+  static size_t GetIndexTypeSize(GLenum indexType) { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+
+private:
+  std::vector<Pool> m_pools;
+  u32 m_drawIdBuffer = 0;
+  u32 m_drawIdsCount = 0;
+};
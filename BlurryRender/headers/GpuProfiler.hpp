@@ -0,0 +1,117 @@
+#pragma once
+#include "Utility.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Per-pass GPU and CPU timings of the frame.
+// Every pass is wrapped into a pair of GL_TIMESTAMP queries, queries of a frame are read FramesInFlight frames
+// later when they are long available, so profiling never waits for the GPU. Results that are still not ready
+// by then are dropped rather than waited for. CPU time is how long submitting the pass took on this thread.
+class GpuProfiler : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  static constexpr u32 FramesInFlight = 4;
+  // Rolling window the statistics are computed over
+  static constexpr u32 HistorySize = 256;
+
+  struct Statistics
+  {
+    double min = 0.0;
+    double average = 0.0;
+    double p99 = 0.0;
+  };
+
+  struct PassStatistics
+  {
+    std::string name;
+    size_t samples = 0;
+    Statistics gpuMs;
+    Statistics cpuMs;
+  };
+
+  // Marks a pass on construction and destruction
+  class Scope : public Utility::Non_copyable
+  {
+  public:
+    Scope(GpuProfiler &profiler, const char *name) : m_profiler(profiler) { m_profiler.BeginPass(name); }
+    ~Scope() { m_profiler.EndPass(); }
+
+  private:
+    GpuProfiler &m_profiler;
+  };
+
+  GpuProfiler() = default;
+  ~GpuProfiler();
+
+  void BeginFrame();
+  void EndFrame();
+
+  // Passes can't be nested
+  void BeginPass(const char *name);
+  void EndPass();
+  // Tiled and software renderers (llvmpipe) defer the work until a flush, flushing at the end of every pass keeps
+  // it within its pass. It costs a submission per pass, so it's off unless asked for.
+  void SetFlushPerPass(bool flushPerPass) { m_flushPerPass = flushPerPass; }
+
+  std::vector<PassStatistics> GetStatistics() const;
+  u32 GetDroppedFrames() const { return m_droppedFrames; }
+  // GPU time of all passes of the latest frame whose results came back, FramesInFlight frames old
+  double GetLastFrameGpuMs() const { return m_lastFrameGpuMs; }
+  // Grows by one with every frame whose results came back
+  u32 GetCollectedFrames() const { return m_collectedFrames; }
+
+  // Human readable table of GetStatistics()
+  std::string GetReport() const;
+  bool DumpCSV(const std::string &path) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct PendingPass
+  {
+    size_t pass;
+    u32 beginQuery;
+    u32 endQuery;
+    double cpuMs;
+  };
+
+  struct FrameQueries
+  {
+    std::vector<PendingPass> passes;
+    // Pool of queries the frame reuses, grows on demand
+    std::vector<u32> queries;
+    size_t usedQueries = 0;
+  };
+
+  struct PassHistory
+  {
+    std::string name;
+    std::deque<double> gpuMs;
+    std::deque<double> cpuMs;
+  };
+
+  u32 AcquireQuery();
+  size_t FindPass(const char *name);
+  void CollectFrame(FrameQueries &frame);
+
+private:
+  std::array<FrameQueries, FramesInFlight> m_frames;
+  u32 m_frameIndex = 0;
+  u32 m_droppedFrames = 0;
+  u32 m_collectedFrames = 0;
+  double m_lastFrameGpuMs = 0.0;
+
+  std::vector<PassHistory> m_passes;
+
+  bool m_flushPerPass = false;
+  bool m_inPass = false;
+  PendingPass m_currentPass{};
+  Clock::time_point m_passStart;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include "Utility.hpp"
+
+#include <EGL/egl.h>
+
+#include <cstdint>
+#include <vector>
+
+// OpenGL 4.5 core context without any window or display server.
+// Uses the EGL surfaceless platform (Mesa llvmpipe works fine) and renders into an offscreen framebuffer.
+class HeadlessContext : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  HeadlessContext() = default;
+  ~HeadlessContext();
+
+  bool Initialize(u32 width, u32 height);
+  void Release();
+
+  u32 GetFramebuffer() const { return m_framebuffer; }
+  u32 GetWidth() const { return m_width; }
+  u32 GetHeight() const { return m_height; }
+
+  // Reads back the output framebuffer as tightly packed RGB rows, bottom row first
+  std::vector<uint8_t> ReadPixels() const;
+
+private:
+  bool CreateContext();
+  void CreateFramebuffer();
+
+private:
+  EGLDisplay m_display = EGL_NO_DISPLAY;
+  EGLContext m_context = EGL_NO_CONTEXT;
+
+  u32 m_framebuffer = 0;
+  u32 m_colorBuffer = 0;
+  u32 m_depthBuffer = 0;
+
+  u32 m_width = 0;
+  u32 m_height = 0;
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include "GeometryArena.hpp"
+#include "RenderQueue.hpp"
+#include "Utility.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Draws of arena geometry submitted with glMultiDrawElementsIndirect.
+// Draws are bucketed by arena pool and texture, each bucket is a single call. Per-instance data goes to a shader
+// storage buffer at DrawDataBinding, indexed by the draw id the arena VAOs feed from baseInstance (see
+// scene_indirect.vert). An instanced draw is one command whose instances read consecutive DrawData, consecutive adds
+// of the same geometry and texture are merged into one.
+// The texture is bound to unit 0 for its whole bucket. Buffers grow as needed and are uploaded whenever the batch
+// changed, commands and draw data of every draw in it. The scene batch is rebuilt from the visible objects every
+// frame, so every frame uploads a 20 byte command and 96 bytes of DrawData per visible object. Only submitting
+// stays a few GL calls whatever the batch size.
+// Adding draws and Prepare() make no GL calls, so a batch can be built on another thread than the one submitting it.
+class IndirectBatch : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  static constexpr u32 DrawDataBinding = 0;
+
+  // std430 layout of DrawData in scene_indirect.vert
+  struct DrawData
+  {
+    glm::mat4 model;
+    // Packed positions are decoded as offset + position * scale, xyz used
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+  };
+
+  IndirectBatch() = default;
+  ~IndirectBatch();
+
+  void Initialize(u32 reservedInstances = GeometryArena::InitialDrawIds);
+  void Release();
+
+  void Clear();
+  // False for geometry which isn't in an arena, the draw is dropped then
+  bool Add(const GeometryArena::Allocation &geometry, u32 texture, const DrawData &data);
+  bool AddInstances(const GeometryArena::Allocation &geometry, u32 texture, const DrawData *instances, u32 count);
+
+  // Sorts draws into buckets and builds the commands, done by Submit and Enqueue too when needed
+  void Prepare();
+
+  // Returns the number of indirect calls made
+  u32 Submit(GeometryArena &arena);
+  // Same calls recorded as packets drawn with `program`, returns their number
+  u32 Enqueue(GeometryArena &arena, RenderQueue &queue, RenderQueue::Pass pass, u32 program);
+
+  u32 GetDrawsCount() const { return static_cast<u32>(m_draws.size()); }
+  u32 GetInstancesCount() const { return static_cast<u32>(m_drawData.size()); }
+  bool IsEmpty() const { return m_draws.empty(); }
+
+private:
+  // Layout defined by glMultiDrawElementsIndirect
+  struct DrawElementsCommand
+  {
+    u32 count;
+    u32 instanceCount;
+    u32 firstIndex;
+    int32_t baseVertex;
+    u32 baseInstance;
+  };
+
+  struct Draw
+  {
+    GeometryArena::Allocation geometry;
+    u32 texture;
+    u32 firstInstance;
+    u32 instanceCount;
+  };
+
+  // Bucket of consecutive commands sharing VAO and texture
+  struct Bucket
+  {
+    u32 pool;
+    u32 texture;
+    u32 firstCommand;
+    u32 commandsCount;
+  };
+
+  void Upload(GeometryArena &arena);
+
+private:
+  u32 m_commandBuffer = 0;
+  u32 m_drawDataBuffer = 0;
+  size_t m_commandCapacity = 0;
+  size_t m_drawDataCapacity = 0;
+  bool m_prepared = false;
+  bool m_uploaded = false;
+
+  std::vector<Draw> m_draws;
+  std::vector<u32> m_order;
+  std::vector<DrawElementsCommand> m_commands;
+  std::vector<Bucket> m_buckets;
+  std::vector<DrawData> m_drawData;
+};
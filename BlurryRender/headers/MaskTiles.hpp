@@ -0,0 +1,32 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Screen tiles classified by the blur mask, so post-processing can skip the work the mask throws away.
+// Tiles are rectangles in texture coordinates of the frame: xy - min corner, zw - max corner.
+namespace MaskTiles
+{
+constexpr uint32_t DefaultTileSize = 32;
+
+struct Classification
+{
+  // Mask is 1.0 in every pixel, the blurred result is replaced by the sharp scene
+  std::vector<glm::vec4> sharp;
+  // Mask is 0.0 in every pixel, nothing of the sharp scene is left
+  std::vector<glm::vec4> blurred;
+  std::vector<glm::vec4> mixed;
+};
+
+// Mask red channel is stretched over the whole frame and sampled with GL_REPEAT, bilinear filtering and mipmaps,
+// like GradientMaskTexturePath is. Every texel that can contribute to a tile pixel is checked, so sharp and
+// blurred tiles are exact and everything uncertain ends up mixed.
+Classification Classify(const uint8_t *mask,
+  uint32_t maskWidth,
+  uint32_t maskHeight,
+  uint32_t maskChannels,
+  uint32_t width,
+  uint32_t height,
+  uint32_t tileSize = DefaultTileSize);
+}// namespace MaskTiles
@@ -0,0 +1,48 @@
+#pragma once
+#include "Utility.hpp"
+#include "mesh.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Baked binary copy of what Model::loadModel gets out of Assimp: interleaved Vertex and index arrays of every mesh
+// plus the material textures they reference. The file sits next to the source model and is memory mapped on load,
+// so mesh data goes from the page cache straight to glBufferData.
+// Cache is valid only for the same source file contents, Assimp import flags, format Version and Vertex layout,
+// otherwise Load fails and the model has to be imported and saved again.
+namespace MeshCache
+{
+// 2: meshes are stored after MeshOptimizer
+constexpr uint32_t Version = 2;
+
+struct MaterialTexture
+{
+  std::string type;
+  std::string path;
+};
+
+// Mesh data inside the mapped cache file, valid while the CachedModel is alive
+struct MeshView
+{
+  const Vertex *vertices = nullptr;
+  uint32_t vertexCount = 0;
+  const uint32_t *indices = nullptr;
+  uint32_t indexCount = 0;
+  std::vector<MaterialTexture> textures;
+};
+
+struct CachedModel
+{
+  Utility::MappedFile file;
+  std::vector<MeshView> meshes;
+};
+
+std::string GetCachePath(const std::string &sourcePath);
+
+// 64-bit FNV-1a of the file contents, 0 if it can't be read
+uint64_t HashFile(const std::string &path);
+
+bool Load(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags, CachedModel &model);
+bool Save(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags, const std::vector<Mesh> &meshes);
+}// namespace MeshCache
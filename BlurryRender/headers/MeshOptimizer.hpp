@@ -0,0 +1,56 @@
+#pragma once
+#include "mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Import-time optimization of indexed triangle lists, run by Model before meshes are uploaded and cached:
+// identical vertices are welded, triangles reordered for the post-transform vertex cache with Tipsify
+// (Sander et al. 2007), the resulting clusters sorted outside-in against overdraw, and vertices reordered
+// in the order the index buffer fetches them.
+namespace MeshOptimizer
+{
+// FIFO entries Tipsify optimizes for and ACMR is measured with
+constexpr uint32_t VertexCacheSize = 16;
+
+struct Statistics
+{
+  size_t vertexCount = 0;
+  size_t triangleCount = 0;
+  // Vertices transformed by a FIFO cache of VertexCacheSize entries
+  size_t cacheMisses = 0;
+  size_t vertexBytes = 0;
+  size_t indexBytes = 0;
+
+  // Average cache miss ratio, transformed vertices per triangle: 0.5 at best, 3.0 at worst
+  float GetACMR() const { return triangleCount ? static_cast<float>(cacheMisses) / triangleCount : 0.0f; }
+  Statistics &operator+=(const Statistics &other);
+};
+
+// Sizes of full vertices and indices of indexSize bytes, see Mesh::indexSize for what Mesh uploads
+Statistics Measure(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, size_t indexSize);
+
+size_t CountCacheMisses(const std::vector<unsigned int> &indices,
+  size_t vertexCount,
+  uint32_t cacheSize = VertexCacheSize);
+
+// Bitwise identical vertices are merged and the rest are kept in order of their first occurrence
+void WeldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+// Returns the first triangle of every cluster, cluster boundaries are where Tipsify had no cached vertex to fan from
+std::vector<size_t> OptimizeVertexCache(std::vector<unsigned int> &indices,
+  size_t vertexCount,
+  uint32_t cacheSize = VertexCacheSize);
+
+// Clusters facing away from the mesh center go first, they are the likeliest to occlude the rest
+void OptimizeOverdraw(std::vector<unsigned int> &indices,
+  const std::vector<Vertex> &vertices,
+  const std::vector<size_t> &clusters);
+
+// Vertices are renumbered in order of the first index that fetches them, unreferenced ones are dropped
+void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+// All of the above in order
+void Optimize(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+}// namespace MeshOptimizer
@@ -0,0 +1,143 @@
+#pragma once
+#include "GpuProfiler.hpp"
+#include "Utility.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Passes of a frame declared with the textures they read and write, then culled, allocated and run in order.
+// Textures created through the graph are transient: a pooled texture is taken for them right before their first
+// pass and goes back to the pool after their last one, so textures whose lifetimes don't overlap alias the same GL
+// texture. Passes whose writes nothing reads, directly or through other passes, are culled; imported resources
+// count as read after the frame. Pooled textures no frame used for a while are deleted, e.g. after a resize.
+class RenderGraph : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  using Handle = u32;
+  static constexpr Handle InvalidHandle = UINT32_MAX;
+
+  struct TextureDesc
+  {
+    u32 width = 0;
+    u32 height = 0;
+    // Sized internal format, depth formats go to the depth attachment
+    u32 format = 0;
+
+    bool operator==(const TextureDesc &other) const = default;
+  };
+
+  // GL objects of the resources, valid while the pass runs
+  class Context
+  {
+  public:
+    // 0 for an imported framebuffer
+    u32 GetTexture(Handle handle) const;
+    const TextureDesc &GetDesc(Handle handle) const;
+    // Framebuffer with the textures attached in order, an imported framebuffer is returned as it is
+    u32 GetFramebuffer(const std::vector<Handle> &attachments) const;
+
+  private:
+    friend class RenderGraph;
+    explicit Context(RenderGraph &graph) : m_graph(graph) {}
+
+    RenderGraph &m_graph;
+  };
+
+  using ExecuteFunction = std::function<void(const Context &context)>;
+
+  struct Statistics
+  {
+    u32 passes = 0;
+    u32 culledPasses = 0;
+    u32 transientTextures = 0;
+    // Pooled textures the transient ones of the frame were placed into
+    u32 usedTextures = 0;
+    u32 pooledTextures = 0;
+    size_t pooledBytes = 0;
+  };
+
+  RenderGraph() = default;
+  ~RenderGraph();
+
+  // Drops the passes and resources of the previous frame, the pool is kept
+  void Reset();
+
+  Handle CreateTexture(std::string name, const TextureDesc &desc);
+  Handle ImportTexture(std::string name, u32 texture, const TextureDesc &desc);
+  Handle ImportFramebuffer(std::string name, u32 framebuffer, u32 width, u32 height);
+
+  // Passes run in the order they are added, one that draws over what another wrote reads it too.
+  // Consecutive passes of the same profiler scope are timed as one.
+  void AddPass(std::string name,
+    const char *profilerScope,
+    std::vector<Handle> reads,
+    std::vector<Handle> writes,
+    ExecuteFunction execute);
+
+  // Culls, allocates and runs the passes, profiler may be null
+  void Execute(GpuProfiler *profiler);
+
+  // Deletes pooled textures and framebuffers
+  void Release();
+
+  const Statistics &GetStatistics() const { return m_statistics; }
+
+private:
+  struct Resource
+  {
+    std::string name;
+    TextureDesc desc;
+    bool imported = false;
+    u32 texture = 0;
+    u32 framebuffer = 0;
+    // Range of the passes using it, transient only
+    int32_t firstPass = -1;
+    int32_t lastPass = -1;
+  };
+
+  struct Pass
+  {
+    std::string name;
+    const char *profilerScope;
+    std::vector<Handle> reads;
+    std::vector<Handle> writes;
+    ExecuteFunction execute;
+    bool culled = false;
+  };
+
+  struct PooledTexture
+  {
+    TextureDesc desc;
+    u32 texture;
+    u32 lastUsedFrame;
+    bool busy;
+  };
+
+  struct PooledFramebuffer
+  {
+    std::vector<u32> textures;
+    u32 framebuffer;
+    u32 lastUsedFrame;
+  };
+
+  void Cull();
+  void ComputeLifetimes();
+  u32 AcquireTexture(const TextureDesc &desc);
+  void ReleaseTexture(u32 texture);
+  u32 GetFramebuffer(const std::vector<Handle> &attachments);
+  void TrimPool();
+
+private:
+  std::vector<Resource> m_resources;
+  std::vector<Pass> m_passes;
+
+  std::vector<PooledTexture> m_texturePool;
+  std::vector<PooledFramebuffer> m_framebufferPool;
+  u32 m_frame = 0;
+
+  Statistics m_statistics;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include "StateCache.hpp"
+#include "Utility.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Draws of a frame recorded as packets and issued in the order of their 64-bit sort keys.
+// From the most significant bits down a key holds pass, program, texture, vertex array and depth, so sorting groups
+// draws sharing state and issuing them through a StateCache binds every program, texture and vertex array once.
+// Keys are radix sorted, digits all keys share are skipped. Uniforms aren't part of a packet: programs are set up
+// with glProgramUniform while recording, so every packet of a program sees the same values.
+class RenderQueue : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+  using u64 = uint64_t;
+
+public:
+  // Passes are issued in this order
+  enum class Pass : uint8_t
+  {
+    Opaque,
+    // Goes last at the far plane, depth test rejects what opaque geometry covered
+    Background,
+    Count
+  };
+
+  enum class DrawType : uint8_t
+  {
+    Arrays,
+    ElementsBaseVertex,
+    MultiElementsIndirect
+  };
+
+  struct Packet
+  {
+    u32 program = 0;
+    u32 vertexArray = 0;
+    // Bound to unit 0
+    u32 texture = 0;
+    bool depthTest = true;
+
+    DrawType type = DrawType::Arrays;
+    // Arrays: vertices count; ElementsBaseVertex: indices count; MultiElementsIndirect: commands count
+    u32 count = 0;
+    // Arrays: first vertex
+    u32 first = 0;
+    int32_t baseVertex = 0;
+    u32 indexType = 0;
+    // Byte offset into the bound index or indirect buffer
+    size_t offset = 0;
+    u32 indirectBuffer = 0;
+    // Bound to storageBinding when not 0
+    u32 storageBuffer = 0;
+    u32 storageBinding = 0;
+  };
+
+  // Depth is in [0, 1], smaller goes first
+  static u64 MakeKey(Pass pass, const Packet &packet, float depth);
+
+  void Clear();
+  void Add(Pass pass, const Packet &packet, float depth = 0.0f);
+  void Sort();
+
+  // Issues the packets of the pass, returns how many. Sort has to be called after the last Add.
+  u32 Submit(Pass pass, StateCache &state) const;
+
+  u32 GetPacketsCount() const { return static_cast<u32>(m_packets.size()); }
+
+private:
+  struct SortEntry
+  {
+    u64 key;
+    u32 packet;
+  };
+
+  static void Issue(const Packet &packet, StateCache &state);
+
+private:
+  std::vector<Packet> m_packets;
+  std::vector<SortEntry> m_order;
+  std::vector<SortEntry> m_scratch;
+};
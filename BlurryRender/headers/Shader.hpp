@@ -1,36 +1,117 @@
 #pragma once
 #include <glm/glm.hpp>
+
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 
 class Shader
 {
 public:
+  // Uniform name with its hash, computed at compile time for string literals
+  struct UniformName
+  {
+    constexpr UniformName(const char *name) : UniformName(std::string_view(name)) {}
+    constexpr UniformName(std::string_view name) : name(name), hash(Hash(name)) {}
+    UniformName(const std::string &name) : UniformName(std::string_view(name)) {}
+
+    // 32-bit FNV-1a
+    static constexpr uint32_t Hash(std::string_view name)
+    {
+      uint32_t hash = 2166136261u;
+      for (char c : name)
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+      return hash;
+    }
+
+    std::string_view name;
+    uint32_t hash;
+  };
+
+  // Pre-resolved uniform location, setting an invalid one is ignored like location -1 is
+  struct UniformHandle
+  {
+    int32_t location = -1;
+
+    bool IsValid() const { return location >= 0; }
+  };
+
   Shader() = default;
   Shader(std::string vertexPath, std::string fragmentPath);
 
   ~Shader() = default;
 
+  // Starts building the program and returns without waiting for the driver, Finish waits and reports errors.
+  // Submitting every program before finishing any of them lets the driver compile them in parallel.
+  void Submit(const std::string &vertexPath, const std::string &fragmentPath);
+  // Same for a compute program of a single stage
+  void SubmitCompute(const std::string &computePath);
+  bool Finish();
+
   void use();
   unsigned int getDescriptor() { return m_descriptor; }
 
-  void setUniform(const std::string &name, bool value) const;
-  void setUniform(const std::string &name, int value) const;
-  void setUniform(const std::string &name, float value) const;
-  void setUniform(const std::string &name, const glm::vec2 &value) const;
-  void setUniform(const std::string &name, float x, float y) const;
-  void setUniform(const std::string &name, const glm::vec3 &value) const;
-  void setUniform(const std::string &name, float x, float y, float z) const;
-  void setUniform(const std::string &name, const glm::vec4 &value) const;
-  void setUniform(const std::string &name, float x, float y, float z, float w);
-  void setUniform(const std::string &name, const glm::mat2 &mat) const;
-  void setUniform(const std::string &name, const glm::mat3 &mat) const;
-  void setUniform(const std::string &name, const glm::mat4 &mat) const;
-
-  static unsigned int CreateShader(std::string shaderPath, unsigned int type);
+  // Looks the name up in the table of active uniforms, no GL calls
+  UniformHandle getUniform(UniformName name) const;
+
+  void setUniform(UniformName name, bool value) const { setUniform(getUniform(name), value); }
+  void setUniform(UniformName name, int value) const { setUniform(getUniform(name), value); }
+  void setUniform(UniformName name, float value) const { setUniform(getUniform(name), value); }
+  void setUniform(UniformName name, const glm::vec2 &value) const { setUniform(getUniform(name), value); }
+  void setUniform(UniformName name, float x, float y) const { setUniform(getUniform(name), x, y); }
+  void setUniform(UniformName name, const glm::vec3 &value) const { setUniform(getUniform(name), value); }
+  void setUniform(UniformName name, float x, float y, float z) const { setUniform(getUniform(name), x, y, z); }
+  void setUniform(UniformName name, const glm::vec4 &value) const { setUniform(getUniform(name), value); }
+  void setUniform(UniformName name, float x, float y, float z, float w) const
+  {
+    setUniform(getUniform(name), x, y, z, w);
+  }
+  void setUniform(UniformName name, const glm::mat2 &mat) const { setUniform(getUniform(name), mat); }
+  void setUniform(UniformName name, const glm::mat3 &mat) const { setUniform(getUniform(name), mat); }
+  void setUniform(UniformName name, const glm::mat4 &mat) const { setUniform(getUniform(name), mat); }
+
+  void setUniform(UniformHandle uniform, bool value) const;
+  void setUniform(UniformHandle uniform, int value) const;
+  void setUniform(UniformHandle uniform, float value) const;
+  void setUniform(UniformHandle uniform, const glm::vec2 &value) const;
+  void setUniform(UniformHandle uniform, float x, float y) const;
+  void setUniform(UniformHandle uniform, const glm::vec3 &value) const;
+  void setUniform(UniformHandle uniform, float x, float y, float z) const;
+  void setUniform(UniformHandle uniform, const glm::vec4 &value) const;
+  void setUniform(UniformHandle uniform, float x, float y, float z, float w) const;
+  void setUniform(UniformHandle uniform, const glm::mat2 &mat) const;
+  void setUniform(UniformHandle uniform, const glm::mat3 &mat) const;
+  void setUniform(UniformHandle uniform, const glm::mat4 &mat) const;
+
+  static unsigned int CreateShader(const std::string &shaderCode, unsigned int type);
 
 private:
-  void Initialize(std::string vertexPath, std::string fragmentPath);
+  void Link(const std::string &vertexSource, const std::string &fragmentSource);
+  void LinkCompute(const std::string &computeSource);
+  static void CheckCompileStatus(unsigned int shader, const std::string &shaderPath, unsigned int type);
+  // Fills the location table, called after linking
+  void CollectUniforms();
 
 private:
+  struct UniformEntry
+  {
+    uint32_t hash;
+    int32_t location;
+    std::string name;
+  };
+
   unsigned int m_descriptor;
+
+  // Build state between Submit and Finish, shaders are 0 when the program came from the cache
+  std::string m_vertexPath;
+  std::string m_fragmentPath;
+  std::string m_computePath;
+  unsigned int m_vertexShader = 0;
+  unsigned int m_fragmentShader = 0;
+  unsigned int m_computeShader = 0;
+  uint64_t m_cacheKey = 0;
+  bool m_loadedFromCache = false;
+  // Sorted by hash
+  std::vector<UniformEntry> m_uniforms;
 };
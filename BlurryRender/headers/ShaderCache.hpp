@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked programs as glGetProgramBinary blobs, one file per program under CacheDirectory.
+// Key covers both shader sources and the driver (vendor, renderer and version strings), so any change to either
+// misses the cache. Drivers can still reject a binary they produced earlier, the program then has to be linked
+// from sources again, see Shader::Finish.
+namespace ShaderCache
+{
+constexpr uint32_t Version = 1;
+
+// False when the driver has no program binary formats at all
+bool IsSupported();
+
+uint64_t GetKey(const std::string &vertexSource, const std::string &fragmentSource);
+std::string GetCachePath(uint64_t key);
+
+// Hands the cached binary to glProgramBinary, the program link status tells whether the driver accepted it
+bool Load(unsigned int program, uint64_t key);
+// Program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+bool Save(unsigned int program, uint64_t key);
+}// namespace ShaderCache
@@ -0,0 +1,57 @@
+#pragma once
+#include "Utility.hpp"
+
+#include <array>
+#include <cstdint>
+
+// Shadow copy of the GL bindings the renderer changes most often.
+// Every call that would bind what is bound already is skipped. The cache only knows what went through it, so code
+// binding behind its back must be followed by Invalidate(). Textures are bound with glBindTextureUnit, so the
+// active texture unit is never touched.
+class StateCache : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  static constexpr u32 TextureUnits = 8;
+  static constexpr u32 StorageBindings = 4;
+
+  struct Statistics
+  {
+    u32 issued = 0;
+    u32 skipped = 0;
+  };
+
+  StateCache() { Invalidate(); }
+
+  // Next call of every kind goes to GL whatever it binds
+  void Invalidate();
+
+  void UseProgram(u32 program);
+  void BindVertexArray(u32 vertexArray);
+  void BindTexture(u32 unit, u32 texture);
+  void BindFramebuffer(u32 framebuffer);
+  void BindDrawIndirectBuffer(u32 buffer);
+  void BindStorageBuffer(u32 binding, u32 buffer);
+  void SetDepthTest(bool enabled);
+
+  const Statistics &GetStatistics() const { return m_statistics; }
+  void ResetStatistics() { m_statistics = {}; }
+
+private:
+  // False when the call is redundant
+  bool Change(u32 &current, u32 value);
+
+private:
+  static constexpr u32 Unknown = UINT32_MAX;
+
+  u32 m_program;
+  u32 m_vertexArray;
+  std::array<u32, TextureUnits> m_textures;
+  u32 m_framebuffer;
+  u32 m_drawIndirectBuffer;
+  std::array<u32, StorageBindings> m_storageBuffers;
+  u32 m_depthTest;
+
+  Statistics m_statistics;
+};
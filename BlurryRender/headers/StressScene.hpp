@@ -0,0 +1,35 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Procedural field of objects around the demo scene to see how drawing scales with their number.
+// Objects fill grid cells ring by ring outwards from the clear middle, so the nearest ones come first.
+namespace StressScene
+{
+struct Layout
+{
+  // Distance between neighbouring cells
+  float spacing = 1.0f;
+  // Cells closer to the origin are left for the demo scene
+  float clearRadius = 3.0f;
+  // Floor the objects stand on
+  float floorHeight = -1.5f;
+  // Random offset from the cell center, part of spacing
+  float jitter = 0.25f;
+  uint32_t seed = 1;
+};
+
+struct Placement
+{
+  glm::vec3 position;
+  float yaw;
+};
+
+// Same count and layout always give the same placements
+std::vector<Placement> Generate(uint32_t count, const Layout &layout = {});
+
+// Object of the given scale rotated by yaw, raised by `lift` model units so its bottom stays on the floor
+glm::mat4 GetTransform(const Placement &placement, float scale, float lift);
+}// namespace StressScene
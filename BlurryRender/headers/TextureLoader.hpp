@@ -0,0 +1,132 @@
+#pragma once
+#include "CompressedTexture.hpp"
+#include "Utility.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous replacement of Utility::LoadTextureFromImage.
+// Load() returns the texture right away with a placeholder texel in it, images are decoded by a pool of worker
+// threads and handed back to the GL thread, which copies them into a persistently mapped pixel buffer ring and
+// uploads from there. Update() has to be called on the GL thread regularly (once per frame), it uploads no more
+// than the per-frame byte budget, so a burst of large textures doesn't stall a single frame.
+// Textures stream progressively: levels go up from the smallest mip of all pending textures to the largest one, and
+// the base level follows, so a texture is sampled at the best quality uploaded so far. Workers build the mip chain
+// of plain images, baked compressed files (preferred the same way LoadTextureFromImage does) come with theirs.
+class TextureLoader : public Utility::Non_copyable
+{
+  using u32 = uint32_t;
+
+public:
+  // Called on the GL thread once the texture got its image, or with loaded false when the image couldn't be
+  // decoded and the texture is left as it was
+  using LoadedCallback = std::function<void(u32 texture, bool loaded)>;
+  // Called on the GL thread for every level uploaded, with the number of bytes it takes
+  using LevelUploadedCallback = std::function<void(u32 texture, u32 level, u32 levelsCount, size_t size)>;
+
+  static constexpr size_t DefaultStagingSize = 64 * 1024 * 1024;
+  static constexpr size_t DefaultFrameBudget = 16 * 1024 * 1024;
+
+  TextureLoader() = default;
+  ~TextureLoader();
+
+  // Needs current GL context, 0 workers means one less than hardware threads
+  void Initialize(u32 workers = 0, size_t stagingSize = DefaultStagingSize, size_t frameBudget = DefaultFrameBudget);
+  void Release();
+
+  u32 Load(const std::string &path, bool flipVertically = false, LoadedCallback onLoaded = nullptr);
+  // Streams the image into a texture made by CreatePlaceholder
+  void LoadInto(u32 texture, const std::string &path, bool flipVertically = false, LoadedCallback onLoaded = nullptr);
+
+  void SetLevelUploadedCallback(LevelUploadedCallback onLevelUploaded)
+  {
+    m_onLevelUploaded = std::move(onLevelUploaded);
+  }
+
+  void Update();
+  // Blocks until every requested texture is uploaded
+  void Finish();
+
+  bool IsIdle() const { return m_pendingTextures == 0; }
+  u32 GetPendingCount() const { return m_pendingTextures; }
+  // Decoded images whose levels aren't all uploaded yet, in CPU memory
+  size_t GetStreamingBytes() const;
+
+  // 1x1 texture with the parameters loaded textures get
+  static u32 CreatePlaceholder();
+  // Frees all levelsCount levels of a loaded texture, leaving just the placeholder texel
+  static void ResetToPlaceholder(u32 texture, u32 levelsCount);
+
+private:
+  struct DecodeJob
+  {
+    u32 texture;
+    std::string path;
+    bool flipVertically;
+    LoadedCallback onLoaded;
+  };
+
+  struct DecodedImage
+  {
+    DecodeJob job;
+    // Plain images: the mip chain built by the worker, all levels one after another
+    std::vector<uint8_t> pixels;
+    int channels = 0;
+    // Used instead of pixels when the texture has a baked file
+    CompressedTexture::Image compressed;
+    std::vector<CompressedTexture::Level> levels;
+    // Levels are uploaded from the last (smallest) one, this is the next one to go
+    size_t nextLevel = 0;
+
+    bool IsCompressed() const { return compressed.data != nullptr; }
+    bool IsLoaded() const { return !levels.empty(); }
+    const uint8_t *GetLevelData(size_t level) const
+    {
+      return (IsCompressed() ? compressed.data : pixels.data()) + levels[level].offset;
+    }
+    size_t GetNextLevelSize() const { return levels[nextLevel].size; }
+  };
+
+  // Part of the staging ring an upload still reads from until its fence is signaled
+  struct StagingRegion
+  {
+    size_t offset;
+    size_t size;
+    void *fence;
+  };
+
+  void WorkerLoop();
+
+  // Uploads levels of decoded images until the budget is spent, `wait` blocks on the GPU when the ring is full
+  void Upload(size_t budget, bool wait);
+  void UploadLevel(const DecodedImage &image, const void *pixels);
+  bool AllocateStaging(size_t size, bool wait, size_t &offset);
+  void RetireStaging(bool wait);
+
+private:
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_jobAdded;
+  std::condition_variable m_imageDecoded;
+  std::deque<DecodeJob> m_jobs;
+  std::deque<DecodedImage> m_decoded;
+  bool m_stopping = false;
+
+  // GL thread only
+  std::vector<DecodedImage> m_streaming;
+  LevelUploadedCallback m_onLevelUploaded;
+  u32 m_stagingBuffer = 0;
+  uint8_t *m_stagingMemory = nullptr;
+  size_t m_stagingSize = 0;
+  size_t m_stagingHead = 0;
+  std::deque<StagingRegion> m_stagingRegions;
+  size_t m_frameBudget = 0;
+  u32 m_pendingTextures = 0;
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <cassert>
+#include <cstdint>
 #include <string>
 #include <filesystem>
 #include <functional>
@@ -44,7 +46,32 @@ private:
   std::function<void()> cleanup_;
 };
 
+// Read-only memory mapping of a whole file
+class MappedFile : public Non_copyable
+{
+public:
+  MappedFile() = default;
+  ~MappedFile() { Close(); }
+
+  bool Open(const std::string &path);
+  void Close();
+
+  const uint8_t *GetData() const { return m_data; }
+  size_t GetSize() const { return m_size; }
+
+private:
+  const uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+#ifdef _WIN32
+  void *m_file = nullptr;
+  void *m_mapping = nullptr;
+#else
+  int m_file = -1;
+#endif
+};
+
 std::string GetOpenGLContextInformation();
+void DebugOutput(const std::string &message);
 std::filesystem::path GetRootPath(std::wstring rootFolderName);
 std::string ReadContentFromFile(const std::string &filePath);
 unsigned int LoadTextureFromImage(char const *path);
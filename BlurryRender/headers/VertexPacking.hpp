@@ -0,0 +1,35 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Quantization of vertex attributes into the formats PackedVertex uploads, decoded by the vertex fetch hardware
+// (normalized integers and half floats) except for positions, which the vertex shader maps back from the mesh bounds.
+// Vertex layout a mesh is uploaded with, picked per model at import
+enum class VertexFormat
+{
+  Full,
+  Packed
+};
+
+namespace VertexPacking
+{
+struct Bounds
+{
+  glm::vec3 min{ 0.0f };
+  glm::vec3 max{ 0.0f };
+
+  // Maps a [0, 1] normalized position back to the object space, position = offset + normalized * scale
+  glm::vec3 GetOffset() const { return min; }
+  glm::vec3 GetScale() const { return max - min; }
+};
+
+// Position as 16-bit unsigned normalized fraction of the bounds, error is below 1 / 65535 of the bounds size
+void PackPosition(const glm::vec3 &position, const Bounds &bounds, uint16_t packed[3]);
+
+// GL_INT_2_10_10_10_REV signed normalized, xyz of a unit vector and w of -1 or 1
+uint32_t PackSnorm10(const glm::vec3 &vector, float w);
+
+// IEEE 754 binary16, rounded to nearest even, denormals flushed to zero
+uint16_t PackHalf(float value);
+}// namespace VertexPacking
@@ -63,7 +63,7 @@ public:
 
   // returns the view matrix calculated using Euler Angles and the LookAt Matrix
   glm::mat4 GetViewMatrix() { return glm::lookAt(m_position, m_position + m_front, m_up); }
-  glm::mat4 LookAt(glm::vec3 target) { return glm::lookAt(target, glm::vec3(0.0f, 0.0f, 0.0f), m_worldUp); }
+  glm::mat4 LookAt(glm::vec3 target) const { return glm::lookAt(target, glm::vec3(0.0f, 0.0f, 0.0f), m_worldUp); }
 
   // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined
   // ENUM (to abstract it from windowing systems)
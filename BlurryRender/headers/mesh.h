@@ -6,8 +6,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "GeometryArena.hpp"
 #include "Shader.hpp"
+#include "VertexPacking.hpp"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 using namespace std;
@@ -21,6 +24,17 @@ struct Vertex
   glm::vec3 Bitangent;
 };
 
+// 20 bytes instead of 56: positions are 16-bit fractions of the mesh bounds decoded by the vertex shader,
+// normal and tangent are 10_10_10_2 signed normalized with the bitangent sign in tangent w, UVs are half floats.
+// The bitangent itself is cross(normal, tangent.xyz) * tangent.w.
+struct PackedVertex
+{
+  uint16_t Position[4];// w is padding to keep the following attributes 4-byte aligned
+  uint32_t Normal;
+  uint32_t Tangent;
+  uint16_t TexCoords[2];
+};
+
 struct Texture
 {
   string type;
@@ -35,27 +49,137 @@ public:
   vector<unsigned int> indices;
   vector<Texture> textures;
   unsigned int VAO;
+  unsigned int vertexCount;
+  unsigned int indexCount;
+  // GL_UNSIGNED_SHORT when every vertex can be indexed with 16 bits, GL_UNSIGNED_INT otherwise
+  GLenum indexType;
+  VertexFormat format;
+  // object space bounding box, packed positions are fractions of it
+  VertexPacking::Bounds bounds;
+  // shared buffers the mesh is suballocated from, VAO is then the arena's one, nullptr when the mesh owns its buffers
+  GeometryArena *arena;
+  GeometryArena::Allocation allocation;
 
-  Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+  Mesh(vector<Vertex> vertices,
+    vector<unsigned int> indices,
+    vector<Texture> textures,
+    VertexFormat format = VertexFormat::Full,
+    GeometryArena *arena = nullptr)
   {
     this->vertices = vertices;
     this->indices = indices;
     this->textures = textures;
+    this->format = format;
+    this->arena = arena;
 
     // now that we have all the required data, set the vertex buffers and its attribute pointers.
-    setupMesh();
+    setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+  }
+
+  // uploads data owned by someone else (e.g. a mapped mesh cache), vertices and indices stay empty
+  Mesh(const Vertex *vertices,
+    size_t vertexCount,
+    const unsigned int *indices,
+    size_t indexCount,
+    vector<Texture> textures,
+    VertexFormat format = VertexFormat::Full,
+    GeometryArena *arena = nullptr)
+  {
+    this->textures = textures;
+    this->format = format;
+    this->arena = arena;
+    setupMesh(vertices, vertexCount, indices, indexCount);
+  }
+
+  // bytes per index the mesh is uploaded with
+  static size_t indexSize(size_t vertexCount) { return vertexCount <= 65536 ? sizeof(uint16_t) : sizeof(unsigned int); }
+
+  // bytes the mesh takes in GL buffers
+  size_t gpuBytes() const
+  {
+    const size_t vertexSize = format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    return vertexCount * vertexSize + indexCount * indexSize;
+  }
+
+  // texture the scene shader samples, the first diffuse one
+  unsigned int diffuseTexture() const
+  {
+    for (const Texture &texture : textures)
+    {
+      if (texture.type == "texture_diffuse")
+        return texture.id;
+    }
+    return 0;
+  }
+
+  // deletes the buffers the mesh owns, suballocations stay in the arena until it's released
+  void release()
+  {
+    if (arena)
+      return;
+
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
   }
 
   void Draw(Shader &shader)
   {
+    // sampler uniforms are resolved once per shader, drawing then neither allocates nor queries locations
+    if (samplerProgram != shader.getDescriptor())
+      resolveUniforms(shader);
+
+    // full vertices are decoded with an identity mapping, so both formats can share the shader
+    const bool packed = format == VertexFormat::Packed;
+    shader.setUniform(positionOffsetUniform, packed ? bounds.GetOffset() : glm::vec3(0.0f));
+    shader.setUniform(positionScaleUniform, packed ? bounds.GetScale() : glm::vec3(1.0f));
+
     // bind appropriate textures
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+      glActiveTexture(GL_TEXTURE0 + i);// active proper texture unit before binding
+      // now set the sampler to the correct texture unit
+      shader.setUniform(samplerUniforms[i], static_cast<int>(i));
+      // and finally bind the texture
+      glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    }
+
+    // draw mesh
+    if (arena)
+      arena->Draw(allocation);
+    else
+    {
+      glBindVertexArray(VAO);
+      glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+    }
+    glBindVertexArray(0);
+
+    // always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+  }
+
+private:
+  // render data
+  unsigned int VBO, EBO;
+
+  // uniforms of the shader the mesh was last drawn with, sampler of every texture and position decoding
+  unsigned int samplerProgram = 0;
+  vector<Shader::UniformHandle> samplerUniforms;
+  Shader::UniformHandle positionOffsetUniform;
+  Shader::UniformHandle positionScaleUniform;
+
+  // samplers are named <type>N, e.g. texture_diffuse1, counting from 1 per type
+  void resolveUniforms(Shader &shader)
+  {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
+    samplerUniforms.clear();
     for (size_t i = 0; i < textures.size(); i++)
     {
-      glActiveTexture(GL_TEXTURE0 + i);// active proper texture unit before binding
       // retrieve texture number (the N in diffuse_textureN)
       string number;
       string name = textures[i].type;
@@ -68,28 +192,32 @@ public:
       else if (name == "texture_height")
         number = std::to_string(heightNr++);// transfer unsigned int to stream
 
-      // now set the sampler to the correct texture unit
-      glUniform1i(glGetUniformLocation(shader.getDescriptor(), (name + number).c_str()), i);
-      // and finally bind the texture
-      glBindTexture(GL_TEXTURE_2D, textures[i].id);
+      samplerUniforms.push_back(shader.getUniform(name + number));
     }
-
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+    positionOffsetUniform = shader.getUniform("positionOffset");
+    positionScaleUniform = shader.getUniform("positionScale");
+    samplerProgram = shader.getDescriptor();
   }
 
-private:
-  // render data
-  unsigned int VBO, EBO;
-
   // initializes all the buffer objects/arrays
-  void setupMesh()
+  void setupMesh(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
   {
+    this->vertexCount = static_cast<unsigned int>(vertexCount);
+    this->indexCount = static_cast<unsigned int>(indexCount);
+    computeBounds(vertices, vertexCount);
+
+    if (arena)
+    {
+      const vector<PackedVertex> packedVertices =
+        format == VertexFormat::Packed ? packVertices(vertices, vertexCount) : vector<PackedVertex>();
+      const void *data = format == VertexFormat::Packed ? static_cast<const void *>(packedVertices.data()) : vertices;
+      allocation = arena->Allocate(format, data, vertexCount, indices, indexCount);
+      VAO = arena->GetVAO(allocation.pool);
+      VBO = EBO = 0;
+      indexType = arena->GetIndexType(allocation.pool);
+      return;
+    }
+
     // create buffers/arrays
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -98,13 +226,30 @@ private:
     glBindVertexArray(VAO);
     // load data into vertex buffers
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (format == VertexFormat::Packed)
+      setupPackedVertices(vertices, vertexCount);
+    else
+      setupVertices(vertices, vertexCount);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    indexType = indexSize(vertexCount) == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if (indexType == GL_UNSIGNED_SHORT)
+    {
+      const vector<uint16_t> narrowIndices(indices, indices + indexCount);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), narrowIndices.data(), GL_STATIC_DRAW);
+    }
+    else
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+  }
+
+  void setupVertices(const Vertex *vertices, size_t vertexCount)
+  {
     // A great thing about structs is that their memory layout is sequential for all its items.
     // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array
     // which again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
 
     // set the vertex attribute pointers
     // vertex Positions
@@ -122,8 +267,66 @@ private:
     // vertex bitangent
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Bitangent));
+  }
 
-    glBindVertexArray(0);
+  void computeBounds(const Vertex *vertices, size_t vertexCount)
+  {
+    bounds = {};
+    if (vertexCount > 0)
+      bounds = { vertices[0].Position, vertices[0].Position };
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+      bounds.min = glm::min(bounds.min, vertices[i].Position);
+      bounds.max = glm::max(bounds.max, vertices[i].Position);
+    }
+  }
+
+  // quantizes vertices into PackedVertex relative to the mesh bounds, which are kept for decoding
+  vector<PackedVertex> packVertices(const Vertex *vertices, size_t vertexCount)
+  {
+    vector<PackedVertex> packedVertices(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+      const Vertex &vertex = vertices[i];
+      PackedVertex &packed = packedVertices[i];
+      VertexPacking::PackPosition(vertex.Position, bounds, packed.Position);
+      packed.Position[3] = 0;
+      packed.Normal = VertexPacking::PackSnorm10(safeNormalize(vertex.Normal), 1.0f);
+      // tangent frames that aren't right-handed get their bitangent flipped back by the sign
+      const glm::vec3 bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+      const float bitangentSign = glm::dot(bitangent, vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+      packed.Tangent = VertexPacking::PackSnorm10(safeNormalize(vertex.Tangent), bitangentSign);
+      packed.TexCoords[0] = VertexPacking::PackHalf(vertex.TexCoords.x);
+      packed.TexCoords[1] = VertexPacking::PackHalf(vertex.TexCoords.y);
+    }
+    return packedVertices;
+  }
+
+  void setupPackedVertices(const Vertex *vertices, size_t vertexCount)
+  {
+    const vector<PackedVertex> packedVertices = packVertices(vertices, vertexCount);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), packedVertices.data(), GL_STATIC_DRAW);
+
+    constexpr GLsizei stride = sizeof(PackedVertex);
+
+    // vertex Positions, mapped back from the bounds by the vertex shader
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)offsetof(PackedVertex, Position));
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offsetof(PackedVertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offsetof(PackedVertex, TexCoords));
+    // vertex tangent, w is the bitangent sign
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offsetof(PackedVertex, Tangent));
+  }
+
+  static glm::vec3 safeNormalize(const glm::vec3 &vector)
+  {
+    const float length = glm::length(vector);
+    return length > 0.0f ? vector / length : glm::vec3(0.0f);
   }
 };
 #endif
@@ -10,7 +10,10 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-#include "Mesh.h"
+#include "AssetManager.hpp"
+#include "mesh.h"
+#include "MeshCache.hpp"
+#include "MeshOptimizer.hpp"
 #include "Shader.hpp"
 #include "Utility.hpp"
 
@@ -30,10 +33,29 @@ public:
   vector<Mesh> meshes;
   string directory;
   bool gammaCorrection;
+  // textures are requested from it when set (and load once used), otherwise they are loaded right away
+  AssetManager *assets;
+  // layout every mesh is uploaded with
+  VertexFormat vertexFormat;
+  // meshes are suballocated from it when set, otherwise every mesh gets buffers of its own
+  GeometryArena *arena;
 
-  Model() : gammaCorrection(0) {}
+  Model() : gammaCorrection(0), assets(nullptr), vertexFormat(VertexFormat::Full), arena(nullptr) {}
   // constructor, expects a filepath to a 3D model.
-  Model(string const &path, bool gamma = false) : gammaCorrection(gamma) { loadModel(path); }
+  Model(string const &path, bool gamma = false)
+    : gammaCorrection(gamma), assets(nullptr), vertexFormat(VertexFormat::Full), arena(nullptr)
+  {
+    loadModel(path);
+  }
+  Model(string const &path,
+    AssetManager *assets,
+    VertexFormat format = VertexFormat::Full,
+    GeometryArena *arena = nullptr,
+    bool gamma = false)
+    : gammaCorrection(gamma), assets(assets), vertexFormat(format), arena(arena)
+  {
+    loadModel(path);
+  }
 
   // draws the model, and thus all its meshes
   void Draw(Shader &shader)
@@ -43,22 +65,86 @@ public:
   }
 
 private:
+  // totals of all meshes imported through ASSIMP, before and after MeshOptimizer
+  MeshOptimizer::Statistics optimizedBefore;
+  MeshOptimizer::Statistics optimizedAfter;
+
   void loadModel(string const &path)
   {
+    const unsigned int importFlags =
+      aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    // baked cache of the same file and import flags skips ASSIMP completely
+    const string cachePath = MeshCache::GetCachePath(path);
+    const uint64_t sourceHash = MeshCache::HashFile(path);
+    if (loadCachedModel(cachePath, sourceHash, importFlags))
+    {
+      trackMeshes(path);
+      return;
+    }
+
     // read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(
-      path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    const aiScene *scene = importer.ReadFile(path, importFlags);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)// if is Not Zero
     {
       cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
       return;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
 
     // process ASSIMP's root node recursively
     processNode(scene->mRootNode, scene);
+    ostringstream statistics;
+    statistics << "INFO::MESH_OPTIMIZER:: " << path << ": vertices " << optimizedBefore.vertexCount << " -> "
+               << optimizedAfter.vertexCount << ", ACMR " << optimizedBefore.GetACMR() << " -> "
+               << optimizedAfter.GetACMR() << ", vertex bytes " << optimizedBefore.vertexBytes << " -> "
+               << optimizedAfter.vertexBytes << ", index bytes " << optimizedBefore.indexBytes << " -> "
+               << optimizedAfter.indexBytes << '\n';
+    Utility::DebugOutput(statistics.str());
+
+    if (!MeshCache::Save(cachePath, sourceHash, importFlags, meshes))
+      cout << "WARNING::MESH_CACHE:: failed to save " << cachePath << endl;
+
+    // GL buffers and the cache have the meshes now, the imported copies aren't needed anymore
+    for (Mesh &mesh : meshes)
+    {
+      vector<Vertex>().swap(mesh.vertices);
+      vector<unsigned int>().swap(mesh.indices);
+    }
+    trackMeshes(path);
+  }
+
+  void trackMeshes(string const &path)
+  {
+    if (!assets)
+      return;
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+    for (const Mesh &mesh : meshes)
+    {
+      cpuBytes += mesh.vertices.capacity() * sizeof(Vertex) + mesh.indices.capacity() * sizeof(unsigned int);
+      gpuBytes += mesh.gpuBytes();
+    }
+    assets->TrackMesh(path, cpuBytes, gpuBytes);
+  }
+
+  bool loadCachedModel(string const &cachePath, uint64_t sourceHash, unsigned int importFlags)
+  {
+    MeshCache::CachedModel cachedModel;
+    if (!MeshCache::Load(cachePath, sourceHash, importFlags, cachedModel))
+      return false;
+
+    for (const MeshCache::MeshView &mesh : cachedModel.meshes)
+    {
+      vector<Texture> textures;
+      for (const MeshCache::MaterialTexture &texture : mesh.textures)
+        textures.push_back(loadTexture(texture.path, texture.type));
+      meshes.push_back(
+        Mesh(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, textures, vertexFormat, arena));
+    }
+    return true;
   }
 
   // processes a node in a recursive wau. Processes each individual mesh located at the node and repeats this process on
@@ -159,8 +245,13 @@ private:
     std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
+    // weld, reorder for the vertex cache, overdraw and fetch locality, the cache saves the result
+    optimizedBefore += MeshOptimizer::Measure(vertices, indices, sizeof(unsigned int));
+    MeshOptimizer::Optimize(vertices, indices);
+    optimizedAfter += MeshOptimizer::Measure(vertices, indices, Mesh::indexSize(vertices.size()));
+
     // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    return Mesh(vertices, indices, textures, vertexFormat, arena);
   }
 
   // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -172,31 +263,32 @@ private:
     {
       aiString str;
       mat->GetTexture(type, i, &str);
-      // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-      bool skip = false;
-      for (unsigned int j = 0; j < textures_loaded.size(); j++)
-      {
-        if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-        {
-          textures.push_back(textures_loaded[j]);
-          skip = true;// a texture with the same filepath has already been loaded, continue to next one. (optimization)
-          break;
-        }
-      }
-      if (!skip)
-      {// if texture hasn't been loaded already, load it
-        Texture texture;
-        const std::string texturePath = this->directory + '/' + str.C_Str();
-        texture.id = Utility::LoadTextureFromImage(texturePath.c_str());
-        texture.type = typeName;
-        texture.path = str.C_Str();
-        textures.push_back(texture);
-        textures_loaded.push_back(texture);// store it as texture loaded for entire model, to ensure we won't unnecesery
-                                           // load duplicate textures.
-      }
+      textures.push_back(loadTexture(str.C_Str(), typeName));
     }
     return textures;
   }
+
+  // loads a texture relative to the model directory, unless it was loaded before
+  Texture loadTexture(const string &path, const string &typeName)
+  {
+    // check if texture was loaded before and if so, skip loading a new texture
+    for (unsigned int j = 0; j < textures_loaded.size(); j++)
+    {
+      // a texture with the same filepath has already been loaded, continue to next one. (optimization)
+      if (textures_loaded[j].path == path)
+        return textures_loaded[j];
+    }
+
+    // if texture hasn't been loaded already, load it
+    Texture texture;
+    const std::string texturePath = this->directory + '/' + path;
+    texture.id = assets ? assets->RequestTexture(texturePath) : Utility::LoadTextureFromImage(texturePath.c_str());
+    texture.type = typeName;
+    texture.path = path;
+    textures_loaded.push_back(texture);// store it as texture loaded for entire model, to ensure we won't unnecesery
+                                       // load duplicate textures.
+    return texture;
+  }
 };
 
 #endif
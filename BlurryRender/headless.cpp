@@ -0,0 +1,383 @@
+#include <glad/glad.h>
+
+#include "Utility.hpp"
+#include "CompressedTexture.hpp"
+#include "CpuBlur.hpp"
+#include "Culling.hpp"
+#include "GLRenderer.hpp"
+#include "HeadlessContext.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// Headless entry point for Linux render nodes, drives GLRenderer without opening any window.
+// Usage: BlurryRenderHeadless [--width W] [--height H] [--frames N] [--warmup N] [--output frame.ppm]
+//                             [--blur-mode separable|kernel|kawase|compute|running-sum] [--no-tiles]
+//                             [--cpu-blur-check] [--profile passes.csv] [--bake-textures] [--stress-cubes N]
+//                             [--stress-models N] [--texture-budget MB] [--target-ms MS] [--compare-blur MODE]
+//                             [--no-blur] [--paused]
+// --bake-textures compresses every image under resources/ into baked DDS files and exits.
+// --stress-cubes and --stress-models add a field of that many instanced objects around the scene.
+// --texture-budget limits GPU memory of scene textures, the least recently used ones are evicted over it.
+// --blur-mode separable is the default and the reference, the other modes mix the mask once after the whole blur
+// and only approximate it where the mask is between 0 and 1.
+// --compare-blur post-processes the last frame again with another blur mode and reports how far the images are,
+// it fails when they differ by more than the CPU blur check allows, as Kawase always does.
+// --target-ms makes the renderer hold that GPU frame time by lowering render scale and switching to cheaper blur
+// modes, the blur mode it ended with is printed.
+// --no-blur presents the scene without post-processing, its passes are culled from the render graph.
+// --paused stops the animation clock, frames with nothing changed only compose the last image again.
+
+namespace
+{
+constexpr uint32_t DefaultWidth = 1920;
+constexpr uint32_t DefaultHeight = 1080;
+constexpr uint32_t DefaultFrames = 100;
+constexpr uint32_t DefaultWarmupFrames = 5;
+
+struct HeadlessOptions
+{
+  uint32_t width = DefaultWidth;
+  uint32_t height = DefaultHeight;
+  uint32_t frames = DefaultFrames;
+  uint32_t warmupFrames = DefaultWarmupFrames;
+  std::string outputPath;
+  GLRenderer::BlurMode blurMode = GLRenderer::BlurMode::Separable;
+  bool tiledBlur = true;
+  bool cpuBlurCheck = false;
+  std::string profilePath;
+  bool bakeTextures = false;
+  uint32_t stressCubes = 0;
+  uint32_t stressModels = 0;
+  size_t textureBudget = AssetManager::DefaultTextureBudget;
+  double targetMs = 0.0;
+  bool compareBlur = false;
+  GLRenderer::BlurMode compareBlurMode = GLRenderer::BlurMode::Separable;
+  bool blur = true;
+  bool paused = false;
+};
+
+bool ParseBlurMode(const std::string &name, GLRenderer::BlurMode &mode)
+{
+  if (name == "separable")
+    mode = GLRenderer::BlurMode::Separable;
+  else if (name == "kernel")
+    mode = GLRenderer::BlurMode::EquivalentKernel;
+  else if (name == "kawase")
+    mode = GLRenderer::BlurMode::DualKawase;
+  else if (name == "compute")
+    mode = GLRenderer::BlurMode::ComputeShared;
+  else if (name == "running-sum")
+    mode = GLRenderer::BlurMode::ComputeRunningSum;
+  else
+    return false;
+  return true;
+}
+
+bool ParseOptions(int argc, char **argv, HeadlessOptions &options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string argument = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (argument == "--width" && hasValue)
+      options.width = static_cast<uint32_t>(std::atoi(argv[++i]));
+    else if (argument == "--height" && hasValue)
+      options.height = static_cast<uint32_t>(std::atoi(argv[++i]));
+    else if (argument == "--frames" && hasValue)
+      options.frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+    else if (argument == "--warmup" && hasValue)
+      options.warmupFrames = static_cast<uint32_t>(std::atoi(argv[++i]));
+    else if (argument == "--output" && hasValue)
+      options.outputPath = argv[++i];
+    else if (argument == "--blur-mode" && hasValue && ParseBlurMode(argv[i + 1], options.blurMode))
+      ++i;
+    else if (argument == "--no-tiles")
+      options.tiledBlur = false;
+    else if (argument == "--cpu-blur-check")
+      options.cpuBlurCheck = true;
+    else if (argument == "--profile" && hasValue)
+      options.profilePath = argv[++i];
+    else if (argument == "--bake-textures")
+      options.bakeTextures = true;
+    else if (argument == "--stress-cubes" && hasValue)
+      options.stressCubes = static_cast<uint32_t>(std::atoi(argv[++i]));
+    else if (argument == "--stress-models" && hasValue)
+      options.stressModels = static_cast<uint32_t>(std::atoi(argv[++i]));
+    else if (argument == "--texture-budget" && hasValue)
+      options.textureBudget = static_cast<size_t>(std::atoll(argv[++i])) * 1024 * 1024;
+    else if (argument == "--compare-blur" && hasValue && ParseBlurMode(argv[i + 1], options.compareBlurMode))
+    {
+      options.compareBlur = true;
+      ++i;
+    }
+    else if (argument == "--target-ms" && hasValue)
+      options.targetMs = std::atof(argv[++i]);
+    else if (argument == "--no-blur")
+      options.blur = false;
+    else if (argument == "--paused")
+      options.paused = true;
+    else
+    {
+      std::cerr << "Unknown or incomplete argument: " << argument << '\n';
+      return false;
+    }
+  }
+  return options.width > 0 && options.height > 0;
+}
+
+bool WritePPM(const std::string &path, uint32_t width, uint32_t height, const std::vector<uint8_t> &pixels)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  file << "P6\n" << width << ' ' << height << "\n255\n";
+  // OpenGL rows go bottom to top, PPM ones top to bottom
+  const size_t rowSize = static_cast<size_t>(width) * 3;
+  for (size_t row = height; row > 0; --row)
+    file.write(reinterpret_cast<const char *>(pixels.data() + (row - 1) * rowSize), rowSize);
+
+  return static_cast<bool>(file);
+}
+
+std::vector<uint8_t> ReadTexture(uint32_t texture, GLenum format, uint32_t channels, uint32_t &width, uint32_t &height)
+{
+  GLint textureWidth{}, textureHeight{};
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureWidth);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight);
+  width = static_cast<uint32_t>(textureWidth);
+  height = static_cast<uint32_t>(textureHeight);
+
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * channels);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glGetTexImage(GL_TEXTURE_2D, 0, format, GL_UNSIGNED_BYTE, pixels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return pixels;
+}
+
+bool BakeTextures()
+{
+  constexpr auto ResourcesPath = "resources";
+  bool succeeded = true;
+  for (const auto &entry : std::filesystem::recursive_directory_iterator(ResourcesPath))
+  {
+    const std::string extension = entry.path().extension().string();
+    if (!entry.is_regular_file() || (extension != ".jpg" && extension != ".png"))
+      continue;
+
+    const std::string path = entry.path().generic_string();
+    const bool baked = CompressedTexture::Bake(path);
+    std::cout << (baked ? "baked " : "failed to bake ") << path << " -> " << CompressedTexture::GetBakedPath(path)
+              << '\n';
+    succeeded = succeeded && baked;
+  }
+  return succeeded;
+}
+
+// Runs CpuBlur on the last frame's scene and compares it with what the GPU presented
+bool CheckCpuBlur(const GLRenderer &renderer, const HeadlessContext &context)
+{
+  constexpr uint32_t Channels = 3;
+  uint32_t width{}, height{}, maskWidth{}, maskHeight{};
+  std::vector<uint8_t> pixels = ReadTexture(renderer.GetSceneColorBuffer(), GL_RGB, Channels, width, height);
+  const std::vector<uint8_t> maskPixels = ReadTexture(renderer.GetMaskTexture(), GL_RED, 1, maskWidth, maskHeight);
+  const std::vector<uint8_t> gpuPixels = context.ReadPixels();
+  const std::vector<float> mask = CpuBlur::ResampleMask(maskPixels.data(), maskWidth, maskHeight, 1, width, height);
+
+  const auto blurStart = std::chrono::steady_clock::now();
+  CpuBlur::Blur(pixels.data(), width, height, Channels, mask.data(), renderer.GetBlurSettings());
+  const double blurMs =
+    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - blurStart).count();
+
+  uint32_t maxDifference = 0;
+  size_t exceeding = 0;
+  for (size_t i = 0; i < pixels.size(); ++i)
+  {
+    const uint32_t difference = static_cast<uint32_t>(std::abs(int32_t{ pixels[i] } - int32_t{ gpuPixels[i] }));
+    maxDifference = std::max(maxDifference, difference);
+    exceeding += difference > CpuBlur::Tolerance8Bit ? 1 : 0;
+  }
+
+  std::cout << "cpu blur (" << CpuBlur::GetInstructionSet() << "): " << blurMs << " ms, max difference "
+            << maxDifference << ", channels over tolerance " << exceeding << " of " << pixels.size() << '\n';
+  return exceeding <= static_cast<size_t>(pixels.size() * CpuBlur::OutliersFraction);
+}
+// Presented image against the same scene post-processed with another blur mode, they have to match as closely as
+// the CPU blur does. Where the mask is between 0 and 1 is reported on its own, only the separable blur mixes the
+// mask in every pass and the other modes differ there the most.
+bool CompareBlur(GLRenderer &renderer, const HeadlessContext &context, GLRenderer::BlurMode mode)
+{
+  constexpr uint32_t Channels = 3;
+  uint32_t maskWidth{}, maskHeight{};
+  const std::vector<uint8_t> maskPixels = ReadTexture(renderer.GetMaskTexture(), GL_RED, 1, maskWidth, maskHeight);
+  const std::vector<float> mask =
+    CpuBlur::ResampleMask(maskPixels.data(), maskWidth, maskHeight, 1, context.GetWidth(), context.GetHeight());
+  const std::vector<uint8_t> pixels = context.ReadPixels();
+  renderer.RepeatPostProcessing(mode);
+  const std::vector<uint8_t> otherPixels = context.ReadPixels();
+
+  uint32_t maxDifference = 0, mixedMaxDifference = 0;
+  size_t exceeding = 0, mixedChannels = 0;
+  double differenceSum = 0.0, mixedDifferenceSum = 0.0;
+  for (size_t i = 0; i < pixels.size(); ++i)
+  {
+    const uint32_t difference = static_cast<uint32_t>(std::abs(int32_t{ pixels[i] } - int32_t{ otherPixels[i] }));
+    maxDifference = std::max(maxDifference, difference);
+    exceeding += difference > CpuBlur::Tolerance8Bit ? 1 : 0;
+    differenceSum += difference;
+
+    const float maskValue = mask[i / Channels];
+    if (maskValue > 0.0f && maskValue < 1.0f)
+    {
+      mixedMaxDifference = std::max(mixedMaxDifference, difference);
+      mixedDifferenceSum += difference;
+      ++mixedChannels;
+    }
+  }
+  std::cout << "blur comparison: max difference " << maxDifference << ", mean "
+            << differenceSum / std::max<size_t>(pixels.size(), 1) << ", channels over tolerance " << exceeding
+            << " of " << pixels.size() << '\n';
+  std::cout << "where the mask mixes: max difference " << mixedMaxDifference << ", mean "
+            << mixedDifferenceSum / std::max<size_t>(mixedChannels, 1) << " over " << mixedChannels << " channels\n";
+  return exceeding <= static_cast<size_t>(pixels.size() * CpuBlur::OutliersFraction);
+}
+}// namespace
+
+int main(int argc, char **argv)
+{
+  HeadlessOptions options;
+  if (!ParseOptions(argc, argv, options))
+    return EXIT_FAILURE;
+
+  HeadlessContext context;
+  if (!context.Initialize(options.width, options.height))
+    return EXIT_FAILURE;
+
+  std::cout << Utility::GetOpenGLContextInformation();
+  std::cout << "OpenGL renderer: " << reinterpret_cast<const char *>(glGetString(GL_RENDERER)) << '\n';
+
+  if (options.bakeTextures)
+    return BakeTextures() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  using Clock = std::chrono::steady_clock;
+  const auto initializeStart = Clock::now();
+  std::unique_ptr<GLRenderer> glRenderer = std::make_unique<GLRenderer>(options.width, options.height);
+  glRenderer->Initialize();
+  const double initializeMs = std::chrono::duration<double, std::milli>(Clock::now() - initializeStart).count();
+  std::cout << "initialize ms: " << initializeMs << '\n';
+  glRenderer->SetOutputFramebuffer(context.GetFramebuffer());
+  glRenderer->SetBlurMode(options.blurMode);
+  glRenderer->SetTiledBlur(options.tiledBlur);
+  glRenderer->SetTextureBudget(options.textureBudget);
+  glRenderer->SetStressScene(options.stressCubes, options.stressModels);
+  glRenderer->SetFrameTimeTarget(options.targetMs, true);
+  glRenderer->SetPostProcessingBlur(options.blur);
+  glRenderer->SetAnimationPaused(options.paused);
+  // Render nodes are mostly llvmpipe, without flushes all the work would be timed by the pass that waits for it
+  glRenderer->SetProfilerFlushPerPass(true);
+
+  constexpr glm::vec3 initialCameraPos{ 0.0f, 0.0f, 8.0f };
+  glRenderer->SetCameraPosition(initialCameraPos);
+
+  // Textures start streaming with the first frame, it's drawn with placeholders
+  const auto firstFrameStart = Clock::now();
+  glRenderer->Render();
+  glFinish();
+  const double firstFrameMs = std::chrono::duration<double, std::milli>(Clock::now() - firstFrameStart).count();
+  std::cout << "first frame ms: " << firstFrameMs << '\n';
+
+  for (uint32_t i = 0; i < options.warmupFrames; ++i)
+    glRenderer->Render();
+  // Measured frames shouldn't include texture streaming
+  glRenderer->FinishLoading();
+  glFinish();
+
+  // glFinish per frame so that measured time is the real frame cost rather than submission only
+  double totalMs = 0.0;
+  double minMs = 0.0;
+  double maxMs = 0.0;
+  for (uint32_t i = 0; i < options.frames; ++i)
+  {
+    const auto frameStart = Clock::now();
+    glRenderer->Render();
+    glFinish();
+    const double frameMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+
+    totalMs += frameMs;
+    minMs = i == 0 ? frameMs : std::min(minMs, frameMs);
+    maxMs = std::max(maxMs, frameMs);
+  }
+
+  if (options.frames > 0)
+  {
+    const double averageMs = totalMs / options.frames;
+    std::cout << "frames: " << options.frames << ", resolution: " << options.width << "x" << options.height
+              << ", stress instances: " << glRenderer->GetStressInstancesCount() << '\n';
+    std::cout << "frame ms avg: " << averageMs << ", min: " << minMs << ", max: " << maxMs
+              << ", fps: " << 1000.0 / averageMs << '\n';
+  }
+
+  std::cout << "mask tiles: sharp " << glRenderer->GetSharpTilesCount() << ", blurred "
+            << glRenderer->GetBlurTilesCount() << '\n';
+  const Culling::Statistics &culling = glRenderer->GetCullingStatistics();
+  std::cout << "culling (" << Culling::GetInstructionSet() << "): boxes tested " << culling.tested
+            << ", objects culled " << culling.culled << ", drawn " << culling.visible << '\n';
+  const StateCache::Statistics &state = glRenderer->GetStateStatistics();
+  std::cout << "render queue packets: " << glRenderer->GetRenderQueuePacketsCount() << ", state changes issued "
+            << state.issued << ", skipped " << state.skipped << '\n';
+  const AssetManager::Statistics assets = glRenderer->GetAssetStatistics();
+  constexpr double Megabyte = 1024.0 * 1024.0;
+  std::cout << "assets: textures " << assets.textures << ", resident " << assets.resident << ", streaming "
+            << assets.streaming << ", failed " << assets.failed << ", evictions " << assets.evictions << ", GPU MB "
+            << assets.gpuBytes / Megabyte << ", CPU MB " << assets.cpuBytes / Megabyte << '\n';
+  const FrameBudget &budget = glRenderer->GetFrameBudget();
+  std::cout << "render size: " << glRenderer->GetRenderWidth() << "x" << glRenderer->GetRenderHeight()
+            << ", scale " << budget.GetRenderScale() << ", blur mode "
+            << GLRenderer::GetBlurModeName(glRenderer->GetEffectiveBlurMode()) << ", smoothed GPU ms "
+            << budget.GetSmoothedMs() << '\n';
+  const RenderGraph::Statistics &graph = glRenderer->GetRenderGraphStatistics();
+  std::cout << "render graph: passes " << graph.passes << ", culled " << graph.culledPasses << ", transient textures "
+            << graph.transientTextures << ", GL textures " << graph.usedTextures << ", pool MB "
+            << graph.pooledBytes / Megabyte << '\n';
+  const GLRenderer::FrameStatistics &frames = glRenderer->GetFrameStatistics();
+  std::cout << "frames rendered: " << frames.frames << ", scene " << frames.sceneFrames << ", post-processing "
+            << frames.postProcessingFrames << '\n';
+  std::cout << glRenderer->GetProfiler().GetReport();
+  if (!options.profilePath.empty() && !glRenderer->GetProfiler().DumpCSV(options.profilePath))
+  {
+    std::cerr << "Failed to write profile: " << options.profilePath << '\n';
+    return EXIT_FAILURE;
+  }
+
+  // CPU blur reproduces the separable blur at the output size only
+  const bool fullQuality = glRenderer->GetRenderWidth() == options.width
+                           && glRenderer->GetRenderHeight() == options.height
+                           && glRenderer->GetEffectiveBlurMode() == glRenderer->GetBlurMode();
+  if (options.cpuBlurCheck && !options.blur)
+    std::cout << "cpu blur check skipped, blur is off\n";
+  else if (options.cpuBlurCheck && !fullQuality)
+    std::cout << "cpu blur check skipped, frame budget lowered the quality\n";
+  else if (options.cpuBlurCheck && !CheckCpuBlur(*glRenderer, context))
+    return EXIT_FAILURE;
+
+  if (!options.outputPath.empty() && !WritePPM(options.outputPath, options.width, options.height, context.ReadPixels()))
+  {
+    std::cerr << "Failed to write output image: " << options.outputPath << '\n';
+    return EXIT_FAILURE;
+  }
+
+  // Last, it presents another image
+  if (options.compareBlur && !CompareBlur(*glRenderer, context, options.compareBlurMode))
+    return EXIT_FAILURE;
+
+  glRenderer.reset();
+  return EXIT_SUCCESS;
+}
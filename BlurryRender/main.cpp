@@ -3,8 +3,8 @@
 
 #include "Utility.hpp"
 #include "Shader.hpp"
-#include "Model.h"
-#include "Camera.h"
+#include "model.h"
+#include "camera.h"
 #include "GLRenderer.hpp"
 #include "Primitives.hpp"
 
@@ -15,7 +15,7 @@
 
 using U32 = unsigned int;
 
-#define NO_WINDOW_RESIZE (WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX | WS_MAXIMIZEBOX)
+#define RESIZABLE_WINDOW WS_OVERLAPPEDWINDOW
 
 constexpr auto AppName = L"BlurryRender";
 constexpr auto AppClassName = L"Win32BlurryRender";
@@ -28,6 +28,10 @@ HGLRC hglrc;
 
 namespace
 {
+// Nothing is rendered while the window is minimized or the app is in the background
+bool windowMinimized = false;
+bool appActive = true;
+
 LRESULT CALLBACK WndProc(HWND hWnd, uint32_t message, WPARAM wParam, LPARAM lParam);
 
 void CreateWin32Context(HINSTANCE hInstance);
@@ -77,15 +81,25 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int n
 
   MSG msg = { 0 };
 
-  while (true)
+  while (msg.message != WM_QUIT)
   {
-    if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+    // Whole queue goes before the frame, so that input piled up during a slow frame doesn't lag behind
+    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
     {
       if (msg.message == WM_QUIT)
         break;
       TranslateMessage(&msg);
       DispatchMessage(&msg);
     }
+    if (msg.message == WM_QUIT)
+      break;
+
+    // Sleeps until a message comes rather than presenting the same image again
+    if (windowMinimized || !appActive || !glRenderer->NeedsRender())
+    {
+      WaitMessage();
+      continue;
+    }
 
     glRenderer->Render();
     SwapBuffers(hDC);
@@ -114,6 +128,21 @@ LRESULT CALLBACK WndProc(HWND hWnd, uint32_t message, WPARAM wParam, LPARAM lPar
     }
     break;
   case WM_SIZE: {
+    // Minimized window keeps its render targets
+    windowMinimized = wParam == SIZE_MINIMIZED;
+    if (renderer && !windowMinimized)
+    {
+      renderer->OnResize(LOWORD(lParam), HIWORD(lParam));
+      renderer->InvalidateOutput();
+    }
+  }
+  break;
+
+  case WM_PAINT: {
+    // Uncovered parts of the window are drawn by the next frame
+    if (renderer)
+      renderer->InvalidateOutput();
+    ValidateRect(hWnd, nullptr);
   }
   break;
 
@@ -127,8 +156,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, uint32_t message, WPARAM wParam, LPARAM lPar
   }
   break;
 
-  case WM_ACTIVATEAPP:
-    break;
+  case WM_ACTIVATEAPP: {
+    appActive = wParam != FALSE;
+    if (renderer && appActive)
+      renderer->InvalidateOutput();
+  }
+  break;
   default:
     return DefWindowProc(hWnd, message, wParam, lParam);
   }
@@ -162,12 +195,12 @@ HWND CreateWin32Window(HINSTANCE hInstance, GLRenderer *renderer)
     (GetSystemMetrics(SM_CYSCREEN) / 2) - (WindowHeight / 2),
     (GetSystemMetrics(SM_CXSCREEN) / 2) + (WindowWidth / 2),
     (GetSystemMetrics(SM_CYSCREEN) / 2) + (WindowHeight / 2));
-  AdjustWindowRectEx(&windowRect, NO_WINDOW_RESIZE, FALSE, 0);
+  AdjustWindowRectEx(&windowRect, RESIZABLE_WINDOW, FALSE, 0);
 
   HWND hWnd = CreateWindowEx(0,
     AppClassName,
     AppName,
-    NO_WINDOW_RESIZE,
+    RESIZABLE_WINDOW,
     windowRect.left,
     windowRect.top,
     windowRect.right - windowRect.left,
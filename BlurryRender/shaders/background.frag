@@ -0,0 +1,10 @@
+#version 450 core
+out vec4 FragColor;
+
+// Chessboard rendered at the render size, texel per pixel
+uniform sampler2D chessboardTexture;
+
+void main()
+{
+  FragColor = texelFetch(chessboardTexture, ivec2(gl_FragCoord.xy), 0);
+}
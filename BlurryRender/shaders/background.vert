@@ -0,0 +1,8 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+
+// At the far plane, so depth test keeps only the pixels no geometry covered
+void main()
+{
+    gl_Position = vec4(aPos.xy, 1.0, 1.0);
+}
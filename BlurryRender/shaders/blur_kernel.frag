@@ -0,0 +1,42 @@
+#version 450 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// Has to match MaxBlurKernelTaps in GLRenderer.cpp
+const int MaxTaps = 128;
+
+// Equivalent kernel of all blur passes along one axis, computed on CPU
+layout (std140, binding = 0) uniform BlurKernel
+{
+  // x - offset in texels along direction, y - weight
+  vec4 taps[MaxTaps];
+};
+
+uniform sampler2D screenTexture;
+uniform sampler2D maskTexture;
+uniform sampler2D sharpTexture;
+
+uniform vec2 direction;
+uniform int tapsCount;
+// Mask is mixed once against the scene after the last axis, blur.frag mixes it in every pass, so where it is
+// between 0 and 1 the transition is softer than the separable blur's
+uniform bool applyMask;
+
+void main()
+{
+  vec2 texelStep = direction / textureSize(screenTexture, 0);
+
+  vec3 pixel = vec3(0.0);
+  for (int i = 0; i < tapsCount; i++)
+    pixel += texture(screenTexture, TexCoords + texelStep * taps[i].x).rgb * taps[i].y;
+
+  if (applyMask)
+  {
+    vec3 sharpPixel = texture(sharpTexture, TexCoords).rgb;
+    float maskValue = texture(maskTexture, TexCoords).r;
+    pixel = mix(pixel, sharpPixel, maskValue);
+  }
+
+  FragColor = vec4(pixel, 1.0);
+}
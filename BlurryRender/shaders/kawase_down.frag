@@ -0,0 +1,23 @@
+#version 450 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// Previous pyramid level, twice as large as the target
+uniform sampler2D screenTexture;
+
+uniform float offset;
+
+// Dual Kawase downsample: center and four diagonal bilinear taps
+void main()
+{
+  vec2 halfPixel = offset / textureSize(screenTexture, 0);
+
+  vec3 pixel = texture(screenTexture, TexCoords).rgb * 4.0;
+  pixel += texture(screenTexture, TexCoords - halfPixel).rgb;
+  pixel += texture(screenTexture, TexCoords + halfPixel).rgb;
+  pixel += texture(screenTexture, TexCoords + vec2(halfPixel.x, -halfPixel.y)).rgb;
+  pixel += texture(screenTexture, TexCoords - vec2(halfPixel.x, -halfPixel.y)).rgb;
+
+  FragColor = vec4(pixel / 8.0, 1.0);
+}
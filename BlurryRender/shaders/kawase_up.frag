@@ -0,0 +1,37 @@
+#version 450 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// Next pyramid level, half as large as the target
+uniform sampler2D screenTexture;
+uniform sampler2D maskTexture;
+uniform sampler2D sharpTexture;
+
+uniform float offset;
+uniform bool applyMask;
+
+// Dual Kawase upsample: four axial and four diagonal bilinear taps, diagonal ones weighted twice
+void main()
+{
+  vec2 halfPixel = 0.5 * offset / textureSize(screenTexture, 0);
+
+  vec3 pixel = texture(screenTexture, TexCoords + vec2(-halfPixel.x * 2.0, 0.0)).rgb;
+  pixel += texture(screenTexture, TexCoords + vec2(halfPixel.x * 2.0, 0.0)).rgb;
+  pixel += texture(screenTexture, TexCoords + vec2(0.0, -halfPixel.y * 2.0)).rgb;
+  pixel += texture(screenTexture, TexCoords + vec2(0.0, halfPixel.y * 2.0)).rgb;
+  pixel += texture(screenTexture, TexCoords + vec2(-halfPixel.x, halfPixel.y)).rgb * 2.0;
+  pixel += texture(screenTexture, TexCoords + vec2(halfPixel.x, halfPixel.y)).rgb * 2.0;
+  pixel += texture(screenTexture, TexCoords + vec2(-halfPixel.x, -halfPixel.y)).rgb * 2.0;
+  pixel += texture(screenTexture, TexCoords + vec2(halfPixel.x, -halfPixel.y)).rgb * 2.0;
+  pixel /= 12.0;
+
+  if (applyMask)
+  {
+    vec3 sharpPixel = texture(sharpTexture, TexCoords).rgb;
+    float maskValue = texture(maskTexture, TexCoords).r;
+    pixel = mix(pixel, sharpPixel, maskValue);
+  }
+
+  FragColor = vec4(pixel, 1.0);
+}
@@ -10,10 +10,14 @@ out vec3 Normal;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// Maps packed [0, 1] positions back to the mesh bounds, identity for full float vertices
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 position = positionOffset + aPos * positionScale;
+    FragPos = vec3(model * vec4(position, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;  
     TexCoords = aTexCoords;
 
@@ -0,0 +1,37 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// Per instance from GeometryArena, baseInstance of the indirect command picks it
+layout (location = 5) in uint aDrawID;
+
+struct DrawData
+{
+    mat4 model;
+    // Maps packed [0, 1] positions back to the mesh bounds, identity for full float vertices
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout (std430, binding = 0) readonly buffer DrawBuffer
+{
+    DrawData draws[];
+};
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out vec3 Normal;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    DrawData draw = draws[aDrawID];
+    vec3 position = draw.positionOffset.xyz + aPos * draw.positionScale.xyz;
+    FragPos = vec3(draw.model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(draw.model))) * aNormal;
+    TexCoords = aTexCoords;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
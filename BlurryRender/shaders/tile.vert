@@ -0,0 +1,14 @@
+#version 450 core
+// Tile rectangle in texture coordinates: xy - min corner, zw - max corner, one per instance
+layout (location = 0) in vec4 aTile;
+
+out vec2 TexCoords;
+
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                               vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main()
+{
+    TexCoords = mix(aTile.xy, aTile.zw, corners[gl_VertexID]);
+    gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,140 @@
+#include "AssetManager.hpp"
+#include <glad/glad.h>
+
+#include <algorithm>
+
+AssetManager::~AssetManager() { Release(); }
+
+void AssetManager::Initialize(TextureLoader &loader, size_t textureBudget)
+{
+  m_loader = &loader;
+  m_textureBudget = textureBudget;
+  m_loader->SetLevelUploadedCallback(
+    [this](u32 texture, u32, u32 levelsCount, size_t size) { OnLevelUploaded(texture, levelsCount, size); });
+}
+
+void AssetManager::Release()
+{
+  if (m_loader)
+  {
+    // Levels still in flight must not land in textures which are gone
+    m_loader->Finish();
+    m_loader->SetLevelUploadedCallback(nullptr);
+  }
+  for (const auto &[texture, asset] : m_textures)
+    glDeleteTextures(1, &texture);
+
+  m_loader = nullptr;
+  m_textures.clear();
+  m_texturesByPath.clear();
+  m_meshes.clear();
+  m_textureBytes = 0;
+  m_evictions = 0;
+  m_changes = 0;
+}
+
+AssetManager::u32 AssetManager::RequestTexture(const std::string &path,
+  bool flipVertically,
+  TextureLoader::LoadedCallback onLoaded)
+{
+  const std::string key = (flipVertically ? "flipped:" : "") + path;
+  if (auto found = m_texturesByPath.find(key); found != m_texturesByPath.end())
+    return found->second;
+
+  const u32 texture = TextureLoader::CreatePlaceholder();
+  m_textures[texture] = { path, flipVertically, std::move(onLoaded) };
+  m_texturesByPath[key] = texture;
+  return texture;
+}
+
+void AssetManager::Touch(u32 texture)
+{
+  auto found = m_textures.find(texture);
+  if (found == m_textures.end())
+    return;
+
+  TextureAsset &asset = found->second;
+  asset.lastUsedFrame = m_frame;
+  if (asset.state != State::Unloaded)
+    return;
+
+  asset.state = State::Loading;
+  m_loader->LoadInto(texture, asset.path, asset.flipVertically, [this](u32 texture, bool loaded) {
+    TextureAsset &asset = m_textures.at(texture);
+    asset.state = loaded ? State::Resident : State::Failed;
+    if (asset.onLoaded)
+      asset.onLoaded(texture, loaded);
+  });
+}
+
+void AssetManager::TrackMesh(const std::string &name, size_t cpuBytes, size_t gpuBytes)
+{
+  m_meshes.push_back({ name, cpuBytes, gpuBytes });
+}
+
+void AssetManager::Update()
+{
+  ++m_frame;
+  if (m_textureBytes <= m_textureBudget)
+    return;
+
+  // Textures still streaming can't be evicted, neither can the ones the last frame sampled
+  m_leastRecentlyUsed.clear();
+  for (const auto &[texture, asset] : m_textures)
+  {
+    if (asset.state == State::Resident && asset.lastUsedFrame + 1 < m_frame)
+      m_leastRecentlyUsed.emplace_back(asset.lastUsedFrame, texture);
+  }
+  std::sort(m_leastRecentlyUsed.begin(), m_leastRecentlyUsed.end());
+
+  for (const auto &[lastUsedFrame, texture] : m_leastRecentlyUsed)
+  {
+    if (m_textureBytes <= m_textureBudget)
+      break;
+    Evict(texture, m_textures.at(texture));
+  }
+}
+
+AssetManager::Statistics AssetManager::GetStatistics() const
+{
+  Statistics statistics;
+  statistics.textures = static_cast<u32>(m_textures.size());
+  statistics.evictions = m_evictions;
+  statistics.gpuBytes = m_textureBytes;
+  statistics.cpuBytes = m_loader ? m_loader->GetStreamingBytes() : 0;
+  for (const auto &[texture, asset] : m_textures)
+  {
+    statistics.resident += asset.state == State::Resident;
+    statistics.streaming += asset.state == State::Loading;
+    statistics.failed += asset.state == State::Failed;
+  }
+  for (const MeshAsset &mesh : m_meshes)
+  {
+    statistics.gpuBytes += mesh.gpuBytes;
+    statistics.cpuBytes += mesh.cpuBytes;
+  }
+  return statistics;
+}
+
+void AssetManager::OnLevelUploaded(u32 texture, u32 levelsCount, size_t size)
+{
+  // Textures loaded around the manager aren't its business
+  auto found = m_textures.find(texture);
+  if (found == m_textures.end())
+    return;
+
+  found->second.levelsCount = levelsCount;
+  found->second.gpuBytes += size;
+  m_textureBytes += size;
+  ++m_changes;
+}
+
+void AssetManager::Evict(u32 texture, TextureAsset &asset)
+{
+  TextureLoader::ResetToPlaceholder(texture, asset.levelsCount);
+  m_textureBytes -= asset.gpuBytes;
+  asset.gpuBytes = 0;
+  asset.state = State::Unloaded;
+  ++m_evictions;
+  ++m_changes;
+}
@@ -0,0 +1,179 @@
+#include "BlurKernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Tail taps lighter than this part of the heaviest one are dropped
+constexpr float InitialTrimThreshold = 1e-4f;
+
+BlurKernel::Kernel Convolve(const BlurKernel::Kernel &lhs, const BlurKernel::Kernel &rhs)
+{
+  BlurKernel::Kernel result;
+  result.first = lhs.first + rhs.first;
+  result.weights.assign(lhs.weights.size() + rhs.weights.size() - 1, 0.0f);
+  for (size_t i = 0; i < lhs.weights.size(); ++i)
+    for (size_t j = 0; j < rhs.weights.size(); ++j)
+      result.weights[i + j] += lhs.weights[i] * rhs.weights[j];
+  return result;
+}
+
+BlurKernel::Kernel Trim(const BlurKernel::Kernel &kernel, float threshold)
+{
+  const float cutoff = *std::max_element(kernel.weights.begin(), kernel.weights.end()) * threshold;
+  const auto isHeavy = [cutoff](float weight) { return weight >= cutoff; };
+
+  const auto begin = std::find_if(kernel.weights.begin(), kernel.weights.end(), isHeavy);
+  const auto end = std::find_if(kernel.weights.rbegin(), kernel.weights.rend(), isHeavy).base();
+
+  BlurKernel::Kernel result;
+  result.first = kernel.first + static_cast<int32_t>(begin - kernel.weights.begin());
+  result.weights.assign(begin, end);
+  return result;
+}
+}// namespace
+
+namespace BlurKernel
+{
+Kernel BuildPassKernel(int32_t samples, float sigmaFactor)
+{
+  Kernel kernel;
+  const int32_t halfSamples = std::max(samples, 1) / 2;
+  const float sigma = static_cast<float>(samples) * sigmaFactor;
+  const float s = 2.0f * sigma * sigma;
+
+  // Zero sigma would turn weights into NaNs, it's no blur at all
+  if (halfSamples == 0 || s <= 0.0f)
+    return kernel;
+
+  kernel.first = -halfSamples;
+  kernel.weights.clear();
+  float weightSum = 0.0f;
+  for (int32_t i = -halfSamples; i < halfSamples; ++i)
+  {
+    kernel.weights.push_back(std::exp(-static_cast<float>(i * i) / s));
+    weightSum += kernel.weights.back();
+  }
+  for (float &weight : kernel.weights)
+    weight /= weightSum;
+
+  return kernel;
+}
+
+Kernel Compose(const Kernel &kernel, uint32_t times)
+{
+  Kernel result;
+  for (uint32_t i = 0; i < times; ++i)
+    result = Convolve(result, kernel);
+  return result;
+}
+
+float GetStandardDeviation(const Kernel &kernel)
+{
+  const float mean = GetMean(kernel);
+  float weightSum = 0.0f;
+  float variance = 0.0f;
+  for (size_t i = 0; i < kernel.weights.size(); ++i)
+  {
+    weightSum += kernel.weights[i];
+    const float distance = static_cast<float>(kernel.first + static_cast<int32_t>(i)) - mean;
+    variance += kernel.weights[i] * distance * distance;
+  }
+  return std::sqrt(variance / weightSum);
+}
+
+float GetMean(const Kernel &kernel)
+{
+  float weightSum = 0.0f;
+  float mean = 0.0f;
+  for (size_t i = 0; i < kernel.weights.size(); ++i)
+  {
+    weightSum += kernel.weights[i];
+    mean += kernel.weights[i] * static_cast<float>(kernel.first + static_cast<int32_t>(i));
+  }
+  return mean / weightSum;
+}
+
+Kernel BuildTrimmedKernel(const Kernel &kernel, uint32_t maxWeights)
+{
+  Kernel trimmed = Trim(kernel, InitialTrimThreshold);
+  for (float threshold = InitialTrimThreshold * 2.0f; trimmed.weights.size() > maxWeights && threshold < 1.0f;
+       threshold *= 2.0f)
+    trimmed = Trim(kernel, threshold);
+
+  float weightSum = 0.0f;
+  for (float weight : trimmed.weights)
+    weightSum += weight;
+  for (float &weight : trimmed.weights)
+    weight /= weightSum;
+  return trimmed;
+}
+
+std::vector<Box> BuildBoxes(const Kernel &kernel, uint32_t count)
+{
+  std::vector<Box> boxes;
+  if (count == 0)
+    return boxes;
+
+  // Fetch between two texels at fraction f blurs by variance f * (1 - f) on its own
+  const float mean = GetMean(kernel);
+  const float fraction = mean - std::floor(mean);
+  // Box of width w has variance (w^2 - 1) / 12, widths are picked among two neighbouring odd ones so that the
+  // variances of all boxes add up to the kernel's one
+  const float sigma = GetStandardDeviation(kernel);
+  const float variance = std::max(sigma * sigma - fraction * (1.0f - fraction), 0.0f);
+  const float n = static_cast<float>(count);
+  const float idealWidth = std::sqrt(12.0f * variance / n + 1.0f);
+  int32_t lowerWidth = static_cast<int32_t>(std::floor(idealWidth));
+  if (lowerWidth % 2 == 0)
+    --lowerWidth;
+  lowerWidth = std::max(lowerWidth, 1);
+  const float w = static_cast<float>(lowerWidth);
+  const float lowerCount = (12.0f * variance - n * w * w - 4.0f * n * w - 3.0f * n) / (-4.0f * w - 4.0f);
+  const uint32_t lowerBoxes = static_cast<uint32_t>(std::clamp(std::lround(lowerCount), 0l, static_cast<long>(count)));
+
+  const int32_t shift = static_cast<int32_t>(std::floor(mean));
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const int32_t width = i < lowerBoxes ? lowerWidth : lowerWidth + 2;
+    const int32_t offset = shift * static_cast<int32_t>(i + 1) / static_cast<int32_t>(count)
+                           - shift * static_cast<int32_t>(i) / static_cast<int32_t>(count);
+    boxes.push_back({ width / 2, static_cast<float>(offset) + (i == 0 ? fraction : 0.0f) });
+  }
+  return boxes;
+}
+
+std::vector<LinearTap> BuildLinearTaps(const Kernel &kernel, uint32_t maxTaps)
+{
+  std::vector<LinearTap> taps;
+  for (float threshold = InitialTrimThreshold; threshold < 1.0f; threshold *= 2.0f)
+  {
+    const Kernel trimmed = Trim(kernel, threshold);
+
+    taps.clear();
+    float weightSum = 0.0f;
+    for (size_t i = 0; i < trimmed.weights.size(); i += 2)
+    {
+      const float offset = static_cast<float>(trimmed.first + static_cast<int32_t>(i));
+      const float weight = trimmed.weights[i];
+      const float nextWeight = i + 1 < trimmed.weights.size() ? trimmed.weights[i + 1] : 0.0f;
+
+      // Linear filtering between texels i and i + 1 gives exactly this weighted sum of both
+      const float pairWeight = weight + nextWeight;
+      taps.push_back({ offset + nextWeight / pairWeight, pairWeight });
+      weightSum += pairWeight;
+    }
+
+    if (taps.size() <= maxTaps)
+    {
+      // Trimmed tails shouldn't darken the image
+      for (LinearTap &tap : taps)
+        tap.weight /= weightSum;
+      break;
+    }
+  }
+
+  return taps;
+}
+}// namespace BlurKernel
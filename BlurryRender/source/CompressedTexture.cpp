@@ -0,0 +1,319 @@
+#include "CompressedTexture.hpp"
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+namespace
+{
+constexpr auto BakedExtension = ".dds";
+
+constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+  return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+constexpr uint32_t DDSMagic = MakeFourCC('D', 'D', 'S', ' ');
+constexpr uint32_t FourCCDX10 = MakeFourCC('D', 'X', '1', '0');
+constexpr uint32_t FourCCDXT1 = MakeFourCC('D', 'X', 'T', '1');
+constexpr uint32_t FourCCATI1 = MakeFourCC('A', 'T', 'I', '1');
+constexpr uint32_t FourCCBC4U = MakeFourCC('B', 'C', '4', 'U');
+
+// DDS_HEADER flags
+constexpr uint32_t DDSDCaps = 0x1;
+constexpr uint32_t DDSDHeight = 0x2;
+constexpr uint32_t DDSDWidth = 0x4;
+constexpr uint32_t DDSDPixelFormat = 0x1000;
+constexpr uint32_t DDSDMipMapCount = 0x20000;
+constexpr uint32_t DDSDLinearSize = 0x80000;
+constexpr uint32_t DDPFFourCC = 0x4;
+constexpr uint32_t DDSCapsTexture = 0x1000;
+constexpr uint32_t DDSCapsComplex = 0x8;
+constexpr uint32_t DDSCapsMipMap = 0x400000;
+constexpr uint32_t D3D10ResourceDimensionTexture2D = 3;
+
+// DXGI_FORMAT values
+constexpr uint32_t DXGIFormatBC1 = 71;
+constexpr uint32_t DXGIFormatBC4 = 80;
+constexpr uint32_t DXGIFormatBC7 = 98;
+
+struct DDSPixelFormat
+{
+  uint32_t size;
+  uint32_t flags;
+  uint32_t fourCC;
+  uint32_t rgbBitCount;
+  uint32_t masks[4];
+};
+
+struct DDSHeader
+{
+  uint32_t size;
+  uint32_t flags;
+  uint32_t height;
+  uint32_t width;
+  uint32_t pitchOrLinearSize;
+  uint32_t depth;
+  uint32_t mipMapCount;
+  uint32_t reserved1[11];
+  DDSPixelFormat pixelFormat;
+  uint32_t caps[4];
+  uint32_t reserved2;
+};
+
+struct DDSHeaderDX10
+{
+  uint32_t dxgiFormat;
+  uint32_t resourceDimension;
+  uint32_t miscFlag;
+  uint32_t arraySize;
+  uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDS header layout");
+
+struct BlockFormat
+{
+  GLenum internalFormat;
+  uint32_t dxgiFormat;
+  uint32_t blockSize;
+};
+
+constexpr BlockFormat BC1Format = { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, DXGIFormatBC1, 8 };
+constexpr BlockFormat BC4Format = { GL_COMPRESSED_RED_RGTC1, DXGIFormatBC4, 8 };
+constexpr BlockFormat BC7Format = { GL_COMPRESSED_RGBA_BPTC_UNORM, DXGIFormatBC7, 16 };
+
+bool IsSupported(GLenum internalFormat)
+{
+  // BPTC and RGTC are core since 4.2 and 3.0
+  return internalFormat != GL_COMPRESSED_RGB_S3TC_DXT1_EXT || GLAD_GL_EXT_texture_compression_s3tc;
+}
+
+size_t GetLevelSize(uint32_t width, uint32_t height, uint32_t blockSize)
+{
+  return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+bool IsNewer(const std::filesystem::path &path, const std::filesystem::path &than)
+{
+  std::error_code error;
+  const auto pathTime = std::filesystem::last_write_time(path, error);
+  if (error)
+    return false;
+  const auto thanTime = std::filesystem::last_write_time(than, error);
+  // Baked file without the source around is fine to use
+  return error || pathTime >= thanTime;
+}
+}// namespace
+
+namespace CompressedTexture
+{
+std::string GetBakedPath(const std::string &sourcePath)
+{
+  return std::filesystem::path(sourcePath).replace_extension(BakedExtension).string();
+}
+
+bool HasBakedFile(const std::string &sourcePath)
+{
+  const std::string bakedPath = GetBakedPath(sourcePath);
+  return bakedPath != sourcePath && IsNewer(bakedPath, sourcePath);
+}
+
+bool Load(const std::string &bakedPath, Image &image)
+{
+  image.file = std::make_unique<Utility::MappedFile>();
+  if (!image.file->Open(bakedPath))
+    return false;
+
+  const uint8_t *data = image.file->GetData();
+  const size_t size = image.file->GetSize();
+  size_t offset = sizeof(uint32_t) + sizeof(DDSHeader);
+
+  uint32_t magic{};
+  DDSHeader header{};
+  if (size < offset)
+    return false;
+  std::memcpy(&magic, data, sizeof(magic));
+  std::memcpy(&header, data + sizeof(magic), sizeof(header));
+  if (magic != DDSMagic || header.size != sizeof(DDSHeader) || !(header.pixelFormat.flags & DDPFFourCC))
+    return false;
+
+  uint32_t dxgiFormat = 0;
+  if (header.pixelFormat.fourCC == FourCCDX10)
+  {
+    DDSHeaderDX10 headerDX10{};
+    if (size < offset + sizeof(headerDX10))
+      return false;
+    std::memcpy(&headerDX10, data + offset, sizeof(headerDX10));
+    offset += sizeof(headerDX10);
+    dxgiFormat = headerDX10.dxgiFormat;
+  }
+  else if (header.pixelFormat.fourCC == FourCCDXT1)
+    dxgiFormat = DXGIFormatBC1;
+  else if (header.pixelFormat.fourCC == FourCCATI1 || header.pixelFormat.fourCC == FourCCBC4U)
+    dxgiFormat = DXGIFormatBC4;
+
+  static constexpr BlockFormat Formats[] = { BC1Format, BC4Format, BC7Format };
+  const BlockFormat *format = std::find_if(
+    std::begin(Formats), std::end(Formats), [dxgiFormat](const BlockFormat &f) { return f.dxgiFormat == dxgiFormat; });
+  if (format == std::end(Formats) || !IsSupported(format->internalFormat) || header.width == 0 || header.height == 0)
+    return false;
+
+  image.internalFormat = format->internalFormat;
+  image.width = header.width;
+  image.height = header.height;
+  image.data = data + offset;
+  image.levels.clear();
+
+  const uint32_t levels = (header.flags & DDSDMipMapCount) ? std::max(header.mipMapCount, 1u) : 1u;
+  // A full chain ends at 1x1, more levels than that would shift the size by 32 bits or more
+  const uint32_t maxLevels = 1 + static_cast<uint32_t>(std::log2(std::max(header.width, header.height)));
+  if (levels > maxLevels)
+    return false;
+  size_t levelOffset = 0;
+  for (uint32_t level = 0; level < levels; ++level)
+  {
+    const uint32_t width = std::max(header.width >> level, 1u);
+    const uint32_t height = std::max(header.height >> level, 1u);
+    const size_t levelSize = GetLevelSize(width, height, format->blockSize);
+    if (offset + levelOffset + levelSize > size)
+      return false;
+
+    image.levels.push_back({ width, height, levelOffset, levelSize });
+    levelOffset += levelSize;
+  }
+  image.dataSize = levelOffset;
+  return true;
+}
+
+void TexLevel(const Image &image, size_t level, const void *data)
+{
+  const Level &mip = image.levels[level];
+  glCompressedTexImage2D(GL_TEXTURE_2D,
+    static_cast<GLint>(level),
+    image.internalFormat,
+    mip.width,
+    mip.height,
+    0,
+    static_cast<GLsizei>(mip.size),
+    data);
+}
+
+void TexImage(const Image &image, const void *data)
+{
+  const uint8_t *base = static_cast<const uint8_t *>(data);
+  for (size_t level = 0; level < image.levels.size(); ++level)
+    TexLevel(image, level, base + image.levels[level].offset);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+bool Bake(const std::string &sourcePath)
+{
+  const std::string bakedPath = GetBakedPath(sourcePath);
+  if (bakedPath == sourcePath)
+    return false;
+
+  // Same orientation as LoadTextureFromImage loads it with
+  stbi_set_flip_vertically_on_load_thread(false);
+  int width{}, height{}, channels{};
+  // Grey with alpha has no block format of its own, stb expands it to RGBA which goes to BC7
+  const int requestedChannels = stbi_info(sourcePath.c_str(), &width, &height, &channels) && channels == 2 ? 4 : 0;
+  std::unique_ptr<uint8_t, void (*)(void *)> pixels(
+    stbi_load(sourcePath.c_str(), &width, &height, &channels, requestedChannels), stbi_image_free);
+  if (!pixels)
+  {
+    std::cerr << "Texture failed to load at path: " << sourcePath << '\n';
+    return false;
+  }
+  if (requestedChannels != 0)
+    channels = requestedChannels;
+
+  BlockFormat format = channels == 1 ? BC4Format : channels == 3 ? BC1Format : BC7Format;
+  if (!IsSupported(format.internalFormat))
+    format = BC7Format;
+  const GLenum sourceFormat = channels == 1 ? GL_RED : channels == 3 ? GL_RGB : GL_RGBA;
+  // Bytes per texel of sourceFormat, what glGetTexImage writes
+  const size_t sourceComponents = sourceFormat == GL_RED ? 1 : sourceFormat == GL_RGB ? 3 : 4;
+
+  // Mips are generated from the uncompressed image, compressed formats aren't renderable
+  GLuint sourceTexture{}, compressedTexture{};
+  glGenTextures(1, &sourceTexture);
+  glGenTextures(1, &compressedTexture);
+  glBindTexture(GL_TEXTURE_2D, sourceTexture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, sourceFormat, width, height, 0, sourceFormat, GL_UNSIGNED_BYTE, pixels.get());
+  glGenerateMipmap(GL_TEXTURE_2D);
+
+  const uint32_t levels = 1 + static_cast<uint32_t>(std::log2(std::max(width, height)));
+  std::vector<uint8_t> levelPixels;
+  std::vector<uint8_t> blocks;
+  for (uint32_t level = 0; level < levels; ++level)
+  {
+    const uint32_t levelWidth = std::max(static_cast<uint32_t>(width) >> level, 1u);
+    const uint32_t levelHeight = std::max(static_cast<uint32_t>(height) >> level, 1u);
+    levelPixels.resize(static_cast<size_t>(levelWidth) * levelHeight * sourceComponents);
+
+    glBindTexture(GL_TEXTURE_2D, sourceTexture);
+    glGetTexImage(GL_TEXTURE_2D, level, sourceFormat, GL_UNSIGNED_BYTE, levelPixels.data());
+    glBindTexture(GL_TEXTURE_2D, compressedTexture);
+    glTexImage2D(GL_TEXTURE_2D,
+      level,
+      format.internalFormat,
+      levelWidth,
+      levelHeight,
+      0,
+      sourceFormat,
+      GL_UNSIGNED_BYTE,
+      levelPixels.data());
+
+    const size_t offset = blocks.size();
+    blocks.resize(offset + GetLevelSize(levelWidth, levelHeight, format.blockSize));
+    glGetCompressedTexImage(GL_TEXTURE_2D, level, blocks.data() + offset);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDeleteTextures(1, &sourceTexture);
+  glDeleteTextures(1, &compressedTexture);
+
+  DDSHeader header{};
+  header.size = sizeof(DDSHeader);
+  header.flags = DDSDCaps | DDSDHeight | DDSDWidth | DDSDPixelFormat | DDSDMipMapCount | DDSDLinearSize;
+  header.height = height;
+  header.width = width;
+  header.pitchOrLinearSize = static_cast<uint32_t>(GetLevelSize(width, height, format.blockSize));
+  header.mipMapCount = levels;
+  header.pixelFormat.size = sizeof(DDSPixelFormat);
+  header.pixelFormat.flags = DDPFFourCC;
+  header.pixelFormat.fourCC = FourCCDX10;
+  header.caps[0] = DDSCapsTexture | DDSCapsComplex | DDSCapsMipMap;
+
+  DDSHeaderDX10 headerDX10{};
+  headerDX10.dxgiFormat = format.dxgiFormat;
+  headerDX10.resourceDimension = D3D10ResourceDimensionTexture2D;
+  headerDX10.arraySize = 1;
+
+  std::ofstream file(bakedPath, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(&DDSMagic), sizeof(DDSMagic));
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(&headerDX10), sizeof(headerDX10));
+  file.write(reinterpret_cast<const char *>(blocks.data()), static_cast<std::streamsize>(blocks.size()));
+  return static_cast<bool>(file);
+}
+}// namespace CompressedTexture
@@ -0,0 +1,408 @@
+#include "CpuBlur.hpp"
+#include "BlurKernel.hpp"
+#include "CpuFeatures.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+// Rows convolved together before being written out transposed, 16 rows of 1080p RGB floats fit into L2
+constexpr uint32_t BlockRows = 16;
+constexpr uint32_t TransposeBlock = 32;
+
+// Convolves `count` interleaved elements: tap t of element j is padded[j + t * tapStride].
+// The blurred value is then mixed with sharp[j] by mask[j], the same as mix(blurred, sharp, mask) in blur.frag.
+using ConvolveRowFn = void (*)(const float *padded,
+  const float *sharp,
+  const float *mask,
+  float *out,
+  size_t count,
+  const float *weights,
+  uint32_t taps,
+  size_t tapStride);
+using WidenRowFn = void (*)(const uint8_t *src, float *dst, size_t count);
+using NarrowRowFn = void (*)(const float *src, uint8_t *dst, size_t count);
+
+void ConvolveRowScalar(const float *padded,
+  const float *sharp,
+  const float *mask,
+  float *out,
+  size_t count,
+  const float *weights,
+  uint32_t taps,
+  size_t tapStride)
+{
+  for (size_t j = 0; j < count; ++j)
+  {
+    float blurred = 0.0f;
+    for (uint32_t t = 0; t < taps; ++t)
+      blurred += weights[t] * padded[j + t * tapStride];
+    out[j] = blurred + (sharp[j] - blurred) * mask[j];
+  }
+}
+
+void WidenRowScalar(const uint8_t *src, float *dst, size_t count)
+{
+  for (size_t j = 0; j < count; ++j)
+    dst[j] = static_cast<float>(src[j]);
+}
+
+void NarrowRowScalar(const float *src, uint8_t *dst, size_t count)
+{
+  for (size_t j = 0; j < count; ++j)
+    dst[j] = static_cast<uint8_t>(std::clamp(std::lrint(src[j]), 0L, 255L));
+}
+
+#ifdef CPU_FEATURES_X86
+CPU_TARGET("sse4.1")
+void ConvolveRowSSE41(const float *padded,
+  const float *sharp,
+  const float *mask,
+  float *out,
+  size_t count,
+  const float *weights,
+  uint32_t taps,
+  size_t tapStride)
+{
+  size_t j = 0;
+  for (; j + 4 <= count; j += 4)
+  {
+    __m128 blurred = _mm_setzero_ps();
+    for (uint32_t t = 0; t < taps; ++t)
+      blurred = _mm_add_ps(blurred, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(padded + j + t * tapStride)));
+    const __m128 delta = _mm_sub_ps(_mm_loadu_ps(sharp + j), blurred);
+    _mm_storeu_ps(out + j, _mm_add_ps(blurred, _mm_mul_ps(delta, _mm_loadu_ps(mask + j))));
+  }
+  ConvolveRowScalar(padded + j, sharp + j, mask + j, out + j, count - j, weights, taps, tapStride);
+}
+
+CPU_TARGET("sse4.1")
+void WidenRowSSE41(const uint8_t *src, float *dst, size_t count)
+{
+  size_t j = 0;
+  for (; j + 4 <= count; j += 4)
+  {
+    int32_t packed{};
+    std::memcpy(&packed, src + j, sizeof(packed));
+    _mm_storeu_ps(dst + j, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed))));
+  }
+  WidenRowScalar(src + j, dst + j, count - j);
+}
+
+CPU_TARGET("sse4.1")
+void NarrowRowSSE41(const float *src, uint8_t *dst, size_t count)
+{
+  size_t j = 0;
+  for (; j + 4 <= count; j += 4)
+  {
+    const __m128i words = _mm_packus_epi32(_mm_cvtps_epi32(_mm_loadu_ps(src + j)), _mm_setzero_si128());
+    const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    std::memcpy(dst + j, &packed, sizeof(packed));
+  }
+  NarrowRowScalar(src + j, dst + j, count - j);
+}
+
+CPU_TARGET("avx2,fma")
+void ConvolveRowAVX2(const float *padded,
+  const float *sharp,
+  const float *mask,
+  float *out,
+  size_t count,
+  const float *weights,
+  uint32_t taps,
+  size_t tapStride)
+{
+  size_t j = 0;
+  for (; j + 8 <= count; j += 8)
+  {
+    __m256 blurred = _mm256_setzero_ps();
+    for (uint32_t t = 0; t < taps; ++t)
+      blurred = _mm256_fmadd_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(padded + j + t * tapStride), blurred);
+    const __m256 delta = _mm256_sub_ps(_mm256_loadu_ps(sharp + j), blurred);
+    _mm256_storeu_ps(out + j, _mm256_fmadd_ps(delta, _mm256_loadu_ps(mask + j), blurred));
+  }
+  ConvolveRowScalar(padded + j, sharp + j, mask + j, out + j, count - j, weights, taps, tapStride);
+}
+
+CPU_TARGET("avx2,fma")
+void WidenRowAVX2(const uint8_t *src, float *dst, size_t count)
+{
+  size_t j = 0;
+  for (; j + 8 <= count; j += 8)
+  {
+    const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + j));
+    _mm256_storeu_ps(dst + j, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)));
+  }
+  WidenRowScalar(src + j, dst + j, count - j);
+}
+
+CPU_TARGET("avx2,fma")
+void NarrowRowAVX2(const float *src, uint8_t *dst, size_t count)
+{
+  size_t j = 0;
+  for (; j + 8 <= count; j += 8)
+  {
+    const __m256i dwords = _mm256_cvtps_epi32(_mm256_loadu_ps(src + j));
+    const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(dwords), _mm256_extracti128_si256(dwords, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(words, words));
+  }
+  NarrowRowScalar(src + j, dst + j, count - j);
+}
+#endif
+
+struct Kernels
+{
+  ConvolveRowFn convolveRow = ConvolveRowScalar;
+  WidenRowFn widenRow = WidenRowScalar;
+  NarrowRowFn narrowRow = NarrowRowScalar;
+  const char *instructionSet = "Scalar";
+};
+
+const Kernels &GetKernels()
+{
+  static const Kernels kernels = [] {
+    Kernels result;
+#ifdef CPU_FEATURES_X86
+    if (CpuFeatures::HasAVX2())
+      result = { ConvolveRowAVX2, WidenRowAVX2, NarrowRowAVX2, "AVX2" };
+    else if (CpuFeatures::HasSSE41())
+      result = { ConvolveRowSSE41, WidenRowSSE41, NarrowRowSSE41, "SSE4.1" };
+#endif
+    return result;
+  }();
+  return kernels;
+}
+
+void LoadRow(const uint8_t *src, float *dst, size_t count)
+{
+  GetKernels().widenRow(src, dst, count);
+}
+
+void LoadRow(const float *src, float *dst, size_t count)
+{
+  std::memcpy(dst, src, count * sizeof(float));
+}
+
+void StoreRow(const float *src, uint8_t *dst, size_t count)
+{
+  GetKernels().narrowRow(src, dst, count);
+}
+
+void StoreRow(const float *src, float *dst, size_t count)
+{
+  std::memcpy(dst, src, count * sizeof(float));
+}
+
+// Splits [0, count) into contiguous ranges, one per worker, and runs func(first, last) for each of them
+template<typename Func>
+void ParallelFor(uint32_t count, uint32_t threads, const Func &func)
+{
+  const uint32_t workers = std::max(1u, std::min(count, threads));
+  const uint32_t chunk = (count + workers - 1) / workers;
+
+  std::vector<std::thread> pool;
+  pool.reserve(workers - 1);
+  for (uint32_t first = chunk; first < count; first += chunk)
+    pool.emplace_back(func, first, std::min(count, first + chunk));
+
+  func(0u, std::min(count, chunk));
+  for (std::thread &worker : pool)
+    worker.join();
+}
+
+template<typename T>
+void Transpose(const T *src, T *dst, uint32_t width, uint32_t height, uint32_t channels, uint32_t threads)
+{
+  const uint32_t rowBlocks = (height + TransposeBlock - 1) / TransposeBlock;
+  ParallelFor(rowBlocks, threads, [&](uint32_t firstBlock, uint32_t lastBlock) {
+    for (uint32_t y0 = firstBlock * TransposeBlock; y0 < std::min(height, lastBlock * TransposeBlock);
+         y0 += TransposeBlock)
+    {
+      const uint32_t y1 = std::min(height, y0 + TransposeBlock);
+      for (uint32_t x0 = 0; x0 < width; x0 += TransposeBlock)
+      {
+        const uint32_t x1 = std::min(width, x0 + TransposeBlock);
+        for (uint32_t y = y0; y < y1; ++y)
+          for (uint32_t x = x0; x < x1; ++x)
+            std::memcpy(dst + (static_cast<size_t>(x) * height + y) * channels,
+              src + (static_cast<size_t>(y) * width + x) * channels,
+              channels * sizeof(T));
+      }
+    }
+  });
+}
+
+// One blur pass along rows of src (rows x rowLength pixels), written transposed into dst (rowLength x rows),
+// so the next pass which goes along the other axis runs along rows again
+template<typename T>
+void RunPass(const T *src,
+  T *dst,
+  uint32_t rowLength,
+  uint32_t rows,
+  uint32_t channels,
+  const float *mask,
+  const BlurKernel::Kernel &kernel,
+  uint32_t threads)
+{
+  const ConvolveRowFn convolveRow = GetKernels().convolveRow;
+  // Number of clamped texels around every row, the first tap reads the leftmost of them
+  const uint32_t halo = static_cast<uint32_t>(std::max(-kernel.first, kernel.GetLast()));
+  const size_t rowElements = static_cast<size_t>(rowLength) * channels;
+  const size_t haloElements = static_cast<size_t>(halo) * channels;
+  const uint32_t blocks = (rows + BlockRows - 1) / BlockRows;
+
+  ParallelFor(blocks, threads, [&](uint32_t firstBlock, uint32_t lastBlock) {
+    std::vector<float> padded(rowElements + 2 * haloElements);
+    std::vector<float> maskRow(rowElements);
+    std::vector<float> blurred(rowElements);
+    std::vector<T> block(rowElements * BlockRows);
+
+    for (uint32_t blockIndex = firstBlock; blockIndex < lastBlock; ++blockIndex)
+    {
+      const uint32_t firstRow = blockIndex * BlockRows;
+      const uint32_t blockRows = std::min(BlockRows, rows - firstRow);
+
+      for (uint32_t r = 0; r < blockRows; ++r)
+      {
+        const size_t row = firstRow + r;
+        float *sharp = padded.data() + haloElements;
+        LoadRow(src + row * rowElements, sharp, rowElements);
+        // GL_CLAMP_TO_EDGE for taps outside of the image
+        for (uint32_t h = 0; h < halo; ++h)
+        {
+          std::memcpy(padded.data() + h * channels, sharp, channels * sizeof(float));
+          std::memcpy(sharp + rowElements + h * channels, sharp + rowElements - channels, channels * sizeof(float));
+        }
+
+        const float *rowMask = mask + row * rowLength;
+        for (uint32_t x = 0; x < rowLength; ++x)
+          std::fill_n(maskRow.data() + static_cast<size_t>(x) * channels, channels, rowMask[x]);
+
+        convolveRow(padded.data() + static_cast<size_t>(kernel.first + static_cast<int32_t>(halo)) * channels,
+          sharp,
+          maskRow.data(),
+          blurred.data(),
+          rowElements,
+          kernel.weights.data(),
+          static_cast<uint32_t>(kernel.weights.size()),
+          channels);
+        StoreRow(blurred.data(), block.data() + r * rowElements, rowElements);
+      }
+
+      for (uint32_t x = 0; x < rowLength; ++x)
+      {
+        T *column = dst + (static_cast<size_t>(x) * rows + firstRow) * channels;
+        for (uint32_t r = 0; r < blockRows; ++r)
+          std::memcpy(column + r * channels, block.data() + r * rowElements + x * channels, channels * sizeof(T));
+      }
+    }
+  });
+}
+
+template<typename T>
+void BlurImage(T *pixels, uint32_t width, uint32_t height, uint32_t channels, const float *mask, const CpuBlur::Settings &settings)
+{
+  if (settings.passes == 0 || width == 0 || height == 0 || channels == 0)
+    return;
+
+  const uint32_t threads = settings.threads ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+  const BlurKernel::Kernel kernel = BlurKernel::BuildPassKernel(settings.samples, settings.sigmaFactor);
+  const size_t pixelsCount = static_cast<size_t>(width) * height;
+
+  // Mask is needed in both layouts since passes alternate between them
+  std::vector<float> masks[2];
+  masks[0] = mask ? std::vector<float>(mask, mask + pixelsCount) : std::vector<float>(pixelsCount, 0.0f);
+  masks[1].resize(pixelsCount);
+  Transpose(masks[0].data(), masks[1].data(), width, height, 1, threads);
+
+  std::vector<T> scratch(pixelsCount * channels);
+  T *current = pixels;
+  T *next = scratch.data();
+  bool transposed = false;
+
+  // `horizontal` pass of blur.frag goes along columns, so it starts on the transposed image
+  if (settings.horizontal)
+  {
+    Transpose(current, next, width, height, channels, threads);
+    std::swap(current, next);
+    transposed = true;
+  }
+
+  for (uint32_t pass = 0; pass < settings.passes; ++pass)
+  {
+    const uint32_t rowLength = transposed ? height : width;
+    const uint32_t rows = transposed ? width : height;
+    RunPass(current, next, rowLength, rows, channels, masks[transposed].data(), kernel, threads);
+    std::swap(current, next);
+    transposed = !transposed;
+  }
+
+  if (transposed)
+  {
+    Transpose(current, next, height, width, channels, threads);
+    std::swap(current, next);
+  }
+
+  if (current != pixels)
+    std::memcpy(pixels, current, pixelsCount * channels * sizeof(T));
+}
+}// namespace
+
+namespace CpuBlur
+{
+void Blur(uint8_t *pixels, uint32_t width, uint32_t height, uint32_t channels, const float *mask, const Settings &settings)
+{
+  BlurImage(pixels, width, height, channels, mask, settings);
+}
+
+void Blur(float *pixels, uint32_t width, uint32_t height, uint32_t channels, const float *mask, const Settings &settings)
+{
+  BlurImage(pixels, width, height, channels, mask, settings);
+}
+
+std::vector<float> ResampleMask(const uint8_t *mask,
+  uint32_t maskWidth,
+  uint32_t maskHeight,
+  uint32_t maskChannels,
+  uint32_t width,
+  uint32_t height)
+{
+  std::vector<float> result(static_cast<size_t>(width) * height);
+
+  // Sampling at pixel centers with GL_LINEAR filter and GL_REPEAT wrapping the mask texture is created with
+  const int32_t wrapWidth = static_cast<int32_t>(maskWidth);
+  const int32_t wrapHeight = static_cast<int32_t>(maskHeight);
+  const auto texel = [&](int32_t x, int32_t y) {
+    x = (x % wrapWidth + wrapWidth) % wrapWidth;
+    y = (y % wrapHeight + wrapHeight) % wrapHeight;
+    return mask[(static_cast<size_t>(y) * maskWidth + x) * maskChannels] / 255.0f;
+  };
+
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    const float v = (y + 0.5f) / height * maskHeight - 0.5f;
+    const int32_t y0 = static_cast<int32_t>(std::floor(v));
+    const float fy = v - y0;
+    for (uint32_t x = 0; x < width; ++x)
+    {
+      const float u = (x + 0.5f) / width * maskWidth - 0.5f;
+      const int32_t x0 = static_cast<int32_t>(std::floor(u));
+      const float fx = u - x0;
+
+      const float bottom = texel(x0, y0) + (texel(x0 + 1, y0) - texel(x0, y0)) * fx;
+      const float top = texel(x0, y0 + 1) + (texel(x0 + 1, y0 + 1) - texel(x0, y0 + 1)) * fx;
+      result[static_cast<size_t>(y) * width + x] = bottom + (top - bottom) * fy;
+    }
+  }
+
+  return result;
+}
+
+const char *GetInstructionSet()
+{
+  return GetKernels().instructionSet;
+}
+}// namespace CpuBlur
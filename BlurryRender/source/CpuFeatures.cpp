@@ -0,0 +1,39 @@
+#include "CpuFeatures.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace CpuFeatures
+{
+bool HasSSE41()
+{
+#if !defined(CPU_FEATURES_X86)
+  return false;
+#elif defined(_MSC_VER)
+  int info[4]{};
+  __cpuid(info, 1);
+  return (info[2] & (1 << 19)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+bool HasAVX2()
+{
+#if !defined(CPU_FEATURES_X86)
+  return false;
+#elif defined(_MSC_VER)
+  int info[4]{};
+  __cpuid(info, 1);
+  const bool fma = (info[2] & (1 << 12)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  __cpuidex(info, 7, 0);
+  const bool avx2 = (info[1] & (1 << 5)) != 0;
+  // OS has to preserve YMM registers as well
+  return fma && avx2 && osxsave && (_xgetbv(0) & 0x6) == 0x6;
+#else
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+}// namespace CpuFeatures
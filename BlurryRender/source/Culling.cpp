@@ -0,0 +1,321 @@
+#include "Culling.hpp"
+#include "CpuFeatures.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+constexpr uint32_t NodeWidth = Culling::Bvh::NodeWidth;
+// Splitting the biggest group first keeps the depth below log4 of the objects count, 16 levels for 4G objects
+constexpr size_t MaxStackSize = 16 * NodeWidth;
+
+// SoA boxes of a node: minX, minY, minZ, maxX, maxY, maxZ, NodeWidth floats each
+using NodeBoxes = const float *const[6];
+
+// Bit i of `intersecting` is set when box i isn't fully outside of the frustum, of `inside` when it's fully inside.
+// Box vertex furthest along the plane normal decides the former, the nearest one the latter.
+using TestBoxesFn = void (*)(const Culling::Frustum &frustum,
+  NodeBoxes boxes,
+  uint32_t &intersecting,
+  uint32_t &inside);
+
+void TestBoxesScalar(const Culling::Frustum &frustum, NodeBoxes boxes, uint32_t &intersecting, uint32_t &inside)
+{
+  intersecting = 0;
+  inside = 0;
+  for (uint32_t i = 0; i < NodeWidth; ++i)
+  {
+    bool isIntersecting = true;
+    bool isInside = true;
+    for (const glm::vec4 &plane : frustum.planes)
+    {
+      float farthest = plane.w;
+      float nearest = plane.w;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        const bool positive = plane[axis] >= 0.0f;
+        farthest += plane[axis] * boxes[positive ? axis + 3 : axis][i];
+        nearest += plane[axis] * boxes[positive ? axis : axis + 3][i];
+      }
+      isIntersecting = isIntersecting && farthest >= 0.0f;
+      isInside = isInside && nearest >= 0.0f;
+    }
+    intersecting |= isIntersecting ? 1u << i : 0u;
+    inside |= isIntersecting && isInside ? 1u << i : 0u;
+  }
+}
+
+#ifdef CPU_FEATURES_X86
+CPU_TARGET("sse2")
+void TestBoxesSSE2(const Culling::Frustum &frustum, NodeBoxes boxes, uint32_t &intersecting, uint32_t &inside)
+{
+  intersecting = 0;
+  inside = 0;
+  for (uint32_t i = 0; i < NodeWidth; i += 4)
+  {
+    __m128 outside = _mm_setzero_ps();
+    __m128 notInside = _mm_setzero_ps();
+    for (const glm::vec4 &plane : frustum.planes)
+    {
+      __m128 farthest = _mm_set1_ps(plane.w);
+      __m128 nearest = farthest;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        const bool positive = plane[axis] >= 0.0f;
+        const __m128 normal = _mm_set1_ps(plane[axis]);
+        farthest = _mm_add_ps(farthest, _mm_mul_ps(normal, _mm_load_ps(boxes[positive ? axis + 3 : axis] + i)));
+        nearest = _mm_add_ps(nearest, _mm_mul_ps(normal, _mm_load_ps(boxes[positive ? axis : axis + 3] + i)));
+      }
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(farthest, _mm_setzero_ps()));
+      notInside = _mm_or_ps(notInside, _mm_cmplt_ps(nearest, _mm_setzero_ps()));
+    }
+    const uint32_t intersectingMask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xF;
+    intersecting |= intersectingMask << i;
+    inside |= (intersectingMask & ~static_cast<uint32_t>(_mm_movemask_ps(notInside))) << i;
+  }
+}
+
+CPU_TARGET("avx2,fma")
+void TestBoxesAVX2(const Culling::Frustum &frustum, NodeBoxes boxes, uint32_t &intersecting, uint32_t &inside)
+{
+  static_assert(NodeWidth == 8, "A node is tested with one 8-wide register");
+  __m256 outside = _mm256_setzero_ps();
+  __m256 notInside = _mm256_setzero_ps();
+  for (const glm::vec4 &plane : frustum.planes)
+  {
+    __m256 farthest = _mm256_set1_ps(plane.w);
+    __m256 nearest = farthest;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      const bool positive = plane[axis] >= 0.0f;
+      const __m256 normal = _mm256_set1_ps(plane[axis]);
+      farthest = _mm256_fmadd_ps(normal, _mm256_load_ps(boxes[positive ? axis + 3 : axis]), farthest);
+      nearest = _mm256_fmadd_ps(normal, _mm256_load_ps(boxes[positive ? axis : axis + 3]), nearest);
+    }
+    outside = _mm256_or_ps(outside, _mm256_cmp_ps(farthest, _mm256_setzero_ps(), _CMP_LT_OQ));
+    notInside = _mm256_or_ps(notInside, _mm256_cmp_ps(nearest, _mm256_setzero_ps(), _CMP_LT_OQ));
+  }
+  intersecting = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFF;
+  inside = intersecting & ~static_cast<uint32_t>(_mm256_movemask_ps(notInside));
+}
+#endif
+
+struct Kernels
+{
+  TestBoxesFn testBoxes = TestBoxesScalar;
+  const char *instructionSet = "Scalar";
+};
+
+const Kernels &GetKernels()
+{
+  static const Kernels kernels = [] {
+    Kernels result;
+#ifdef CPU_FEATURES_X86
+    if (CpuFeatures::HasAVX2())
+      result = { TestBoxesAVX2, "AVX2" };
+    else
+      result = { TestBoxesSSE2, "SSE2" };
+#endif
+    return result;
+  }();
+  return kernels;
+}
+
+glm::vec4 NormalizePlane(const glm::vec4 &plane)
+{
+  return plane / glm::length(glm::vec3(plane));
+}
+}// namespace
+
+namespace Culling
+{
+Frustum ExtractFrustum(const glm::mat4 &viewProjection)
+{
+  // Rows of the matrix, clip space -w <= x, y, z <= w gives a plane per inequality
+  const glm::mat4 &m = viewProjection;
+  glm::vec4 rows[4];
+  for (int row = 0; row < 4; ++row)
+    rows[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+
+  Frustum frustum;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    frustum.planes[axis * 2] = NormalizePlane(rows[3] + rows[axis]);
+    frustum.planes[axis * 2 + 1] = NormalizePlane(rows[3] - rows[axis]);
+  }
+  return frustum;
+}
+
+Bounds Transform(const Bounds &bounds, const glm::mat4 &transform)
+{
+  // Center is transformed as a point, half extents by the absolute values of the linear part
+  const glm::vec3 center = glm::vec3(transform * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+  const glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+  glm::vec3 transformedExtent(0.0f);
+  for (int column = 0; column < 3; ++column)
+    for (int row = 0; row < 3; ++row)
+      transformedExtent[row] += std::abs(transform[column][row]) * extent[column];
+  return { center - transformedExtent, center + transformedExtent };
+}
+
+void Bvh::Build(const std::vector<Bounds> &objects)
+{
+  Clear();
+  if (objects.empty())
+    return;
+
+  std::vector<glm::vec3> centers(objects.size());
+  for (size_t i = 0; i < objects.size(); ++i)
+    centers[i] = (objects[i].min + objects[i].max) * 0.5f;
+
+  m_objects.resize(objects.size());
+  std::iota(m_objects.begin(), m_objects.end(), 0u);
+  m_nodes.reserve(objects.size() / (NodeWidth - 1) + 1);
+  BuildNode(objects, centers, 0, static_cast<u32>(objects.size()));
+}
+
+void Bvh::Clear()
+{
+  m_nodes.clear();
+  m_objects.clear();
+}
+
+Bvh::u32 Bvh::BuildNode(const std::vector<Bounds> &objects,
+  const std::vector<glm::vec3> &centers,
+  u32 first,
+  u32 count)
+{
+  struct Group
+  {
+    u32 first;
+    u32 count;
+  };
+
+  // Children are groups of objects, the biggest group is halved along its longest axis until there are enough
+  std::array<Group, NodeWidth> groups;
+  u32 groupsCount = 0;
+  if (count <= NodeWidth)
+  {
+    for (; groupsCount < count; ++groupsCount)
+      groups[groupsCount] = { first + groupsCount, 1 };
+  }
+  else
+  {
+    groups[groupsCount++] = { first, count };
+    while (groupsCount < NodeWidth)
+    {
+      Group &biggest = *std::max_element(groups.begin(),
+        groups.begin() + groupsCount,
+        [](const Group &lhs, const Group &rhs) { return lhs.count < rhs.count; });
+
+      glm::vec3 low = centers[m_objects[biggest.first]];
+      glm::vec3 high = low;
+      for (u32 i = biggest.first; i < biggest.first + biggest.count; ++i)
+      {
+        low = glm::min(low, centers[m_objects[i]]);
+        high = glm::max(high, centers[m_objects[i]]);
+      }
+      const glm::vec3 size = high - low;
+      const int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+
+      const u32 half = biggest.count / 2;
+      const auto begin = m_objects.begin() + biggest.first;
+      std::nth_element(begin, begin + half, begin + biggest.count, [&centers, axis](u32 lhs, u32 rhs) {
+        return centers[lhs][axis] < centers[rhs][axis];
+      });
+      groups[groupsCount++] = { biggest.first + half, biggest.count - half };
+      biggest.count = half;
+    }
+  }
+
+  const u32 index = static_cast<u32>(m_nodes.size());
+  m_nodes.emplace_back();
+  for (u32 slot = 0; slot < NodeWidth; ++slot)
+  {
+    Bounds box{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    int32_t child = 0;
+    if (slot < groupsCount)
+    {
+      const Group &group = groups[slot];
+      for (u32 i = group.first; i < group.first + group.count; ++i)
+      {
+        box.min = glm::min(box.min, objects[m_objects[i]].min);
+        box.max = glm::max(box.max, objects[m_objects[i]].max);
+      }
+      // Recursion grows m_nodes, so the node is only referenced afterwards
+      child = group.count == 1 ? ~static_cast<int32_t>(m_objects[group.first])
+                               : static_cast<int32_t>(BuildNode(objects, centers, group.first, group.count));
+    }
+
+    Node &node = m_nodes[index];
+    node.minX[slot] = box.min.x;
+    node.minY[slot] = box.min.y;
+    node.minZ[slot] = box.min.z;
+    node.maxX[slot] = box.max.x;
+    node.maxY[slot] = box.max.y;
+    node.maxZ[slot] = box.max.z;
+    node.children[slot] = child;
+  }
+
+  Node &node = m_nodes[index];
+  node.childrenCount = groupsCount;
+  node.first = first;
+  node.count = count;
+  return index;
+}
+
+Statistics Bvh::Cull(const Frustum &frustum, std::vector<uint8_t> &visible) const
+{
+  Statistics statistics;
+  visible.assign(m_objects.size(), 0);
+  if (m_nodes.empty())
+    return statistics;
+
+  const TestBoxesFn testBoxes = GetKernels().testBoxes;
+  std::array<u32, MaxStackSize> stack;
+  size_t stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0)
+  {
+    const Node &node = m_nodes[stack[--stackSize]];
+    const float *const boxes[6] = { node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ };
+    u32 intersecting{}, inside{};
+    testBoxes(frustum, boxes, intersecting, inside);
+    statistics.tested += node.childrenCount;
+
+    for (u32 slot = 0; slot < node.childrenCount; ++slot)
+    {
+      if ((intersecting & (1u << slot)) == 0)
+        continue;
+
+      const int32_t child = node.children[slot];
+      if (child < 0)
+      {
+        visible[~child] = 1;
+        ++statistics.visible;
+      }
+      else if ((inside & (1u << slot)) != 0)
+      {
+        // Everything below is visible, no need to test it
+        const Node &subtree = m_nodes[child];
+        for (u32 i = subtree.first; i < subtree.first + subtree.count; ++i)
+          visible[m_objects[i]] = 1;
+        statistics.visible += subtree.count;
+      }
+      else
+        stack[stackSize++] = static_cast<u32>(child);
+    }
+  }
+
+  statistics.culled = static_cast<u32>(m_objects.size()) - statistics.visible;
+  return statistics;
+}
+
+const char *GetInstructionSet()
+{
+  return GetKernels().instructionSet;
+}
+}// namespace Culling
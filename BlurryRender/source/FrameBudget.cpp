@@ -0,0 +1,88 @@
+#include "FrameBudget.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// Weight of the newest frame in the smoothed frame time
+constexpr double SmoothingFactor = 0.2;
+constexpr float MinRenderScale = 0.25f;
+}// namespace
+
+void FrameBudget::SetSettings(const Settings &settings)
+{
+  m_settings = settings;
+  m_settings.targetMs = std::max(m_settings.targetMs, 0.0);
+  m_settings.maxScale = std::clamp(m_settings.maxScale, MinRenderScale, 1.0f);
+  m_settings.minScale = std::clamp(m_settings.minScale, MinRenderScale, m_settings.maxScale);
+  m_settings.scaleStep = std::clamp(m_settings.scaleStep, 0.01f, 1.0f);
+  m_settings.headroom = std::clamp(m_settings.headroom, 0.1, 1.0);
+  Reset();
+}
+
+void FrameBudget::Reset()
+{
+  m_renderScale = m_settings.maxScale;
+  m_blurLevel = 0;
+  m_smoothedMs = -1.0;
+  m_cooldown = 0;
+}
+
+bool FrameBudget::Update(double gpuMs)
+{
+  if (!IsEnabled())
+    return false;
+
+  // Frames measured meanwhile were rendered with the previous settings
+  if (m_cooldown > 0)
+  {
+    --m_cooldown;
+    return false;
+  }
+
+  m_smoothedMs = m_smoothedMs < 0.0 ? gpuMs : m_smoothedMs + (gpuMs - m_smoothedMs) * SmoothingFactor;
+
+  bool changed = false;
+  if (m_smoothedMs > m_settings.targetMs)
+    changed = Degrade();
+  else if (m_smoothedMs < m_settings.targetMs * m_settings.headroom)
+    changed = Improve();
+
+  if (changed)
+  {
+    m_smoothedMs = -1.0;
+    m_cooldown = m_settings.cooldownFrames;
+  }
+  return changed;
+}
+
+bool FrameBudget::Degrade()
+{
+  // Cheaper blur costs less quality than fewer pixels
+  if (m_blurLevel < m_settings.maxBlurLevel)
+  {
+    ++m_blurLevel;
+    return true;
+  }
+  if (m_renderScale > m_settings.minScale)
+  {
+    m_renderScale = std::max(m_renderScale - m_settings.scaleStep, m_settings.minScale);
+    return true;
+  }
+  return false;
+}
+
+bool FrameBudget::Improve()
+{
+  if (m_renderScale < m_settings.maxScale)
+  {
+    m_renderScale = std::min(m_renderScale + m_settings.scaleStep, m_settings.maxScale);
+    return true;
+  }
+  if (m_blurLevel > 0)
+  {
+    --m_blurLevel;
+    return true;
+  }
+  return false;
+}
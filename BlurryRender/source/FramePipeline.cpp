@@ -0,0 +1,90 @@
+#include "FramePipeline.hpp"
+
+FramePipeline::~FramePipeline() { Release(); }
+
+void FramePipeline::Initialize(PrepareFunction prepare)
+{
+  m_prepare = std::move(prepare);
+  for (FramePacket &packet : m_packets)
+    packet.sceneBatch.Initialize();
+
+  m_stopping = false;
+  m_worker = std::thread(&FramePipeline::WorkerLoop, this);
+}
+
+void FramePipeline::Release()
+{
+  if (!m_worker.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_started.notify_one();
+  m_worker.join();
+
+  for (FramePacket &packet : m_packets)
+    packet.sceneBatch.Release();
+  m_preparing = -1;
+  m_inFlight = false;
+}
+
+FramePacket &FramePipeline::Next(const FramePacket::Input &input)
+{
+  // Nothing prepared ahead after a flush, the frame waits for its own packet
+  if (!m_inFlight)
+    Start(m_current, input);
+  Wait();
+
+  const u32 current = m_current;
+  m_current = (m_current + 1) % PacketsCount;
+  Start(m_current, input);
+  m_inFlight = true;
+  return m_packets[current];
+}
+
+void FramePipeline::Flush()
+{
+  Wait();
+  m_inFlight = false;
+}
+
+void FramePipeline::Start(u32 packet, const FramePacket::Input &input)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_packets[packet].input = input;
+    m_preparing = static_cast<int32_t>(packet);
+  }
+  m_started.notify_one();
+}
+
+void FramePipeline::Wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_finished.wait(lock, [this] { return m_preparing < 0; });
+}
+
+void FramePipeline::WorkerLoop()
+{
+  while (true)
+  {
+    int32_t packet{};
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_started.wait(lock, [this] { return m_stopping || m_preparing >= 0; });
+      if (m_stopping)
+        return;
+      packet = m_preparing;
+    }
+
+    m_prepare(m_packets[packet]);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_preparing = -1;
+    }
+    m_finished.notify_all();
+  }
+}
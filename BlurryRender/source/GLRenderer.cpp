@@ -1,24 +1,39 @@
 #include "GLRenderer.hpp"
+#include "BlurKernel.hpp"
+#include "MaskTiles.hpp"
+#include "MeshOptimizer.hpp"
+#include "StressScene.hpp"
 #include "Primitives.hpp"
 #include "Utility.hpp"
 
 #include <stb_image.h>
 
+#include <algorithm>
+#include <cmath>
+
 // Hard-coded pases for shaders for now
 // TODO: Need to be fixed later
 namespace
 {
 // SHADERS
-constexpr auto BackgroundVertexShaderPath = "shaders/chessboard.vert";
-constexpr auto BackgroundFragmentShaderPath = "shaders/chessboard.frag";
-constexpr auto SceneVertexShaderPath = "shaders/scene.vert";
+constexpr auto ChessboardVertexShaderPath = "shaders/chessboard.vert";
+constexpr auto ChessboardFragmentShaderPath = "shaders/chessboard.frag";
+constexpr auto BackgroundVertexShaderPath = "shaders/background.vert";
+constexpr auto BackgroundFragmentShaderPath = "shaders/background.frag";
+constexpr auto SceneIndirectVertexShaderPath = "shaders/scene_indirect.vert";
 constexpr auto SceneFragmentShaderPath = "shaders/scene.frag";
 constexpr auto BlurVertexShaderPath = "shaders/blur.vert";
 constexpr auto BlurFragmentShaderPath = "shaders/blur.frag";
+constexpr auto BlurKernelFragmentShaderPath = "shaders/blur_kernel.frag";
+constexpr auto KawaseDownFragmentShaderPath = "shaders/kawase_down.frag";
+constexpr auto KawaseUpFragmentShaderPath = "shaders/kawase_up.frag";
+constexpr auto TileVertexShaderPath = "shaders/tile.vert";
 constexpr auto LightSourceVertexShaderPath = "shaders/light_source.vert";
 constexpr auto LightSourceFragmentShaderPath = "shaders/light_source.frag";
 constexpr auto ComposeVertShaderPath = "shaders/compose.vert";
 constexpr auto ComposeFragShaderPath = "shaders/compose.frag";
+constexpr auto ComputeSharedBlurShaderPath = "shaders/blur_shared.comp";
+constexpr auto RunningSumBlurShaderPath = "shaders/blur_running_sum.comp";
 
 // MODELS
 constexpr auto BackpackModelPath = "resources/models/backpack/backpack.obj";
@@ -27,47 +42,186 @@ constexpr auto BackpackModelPath = "resources/models/backpack/backpack.obj";
 constexpr auto ContainerTexturePath = "resources/textures/container.jpg";
 constexpr auto BackgroundTexturePath = "resources/textures/back.jpg";
 constexpr auto GradientMaskTexturePath = "resources/textures/gradient_mask.png";
+
+// POST-PROCESSING
+constexpr int32_t BlurSamples = 8;
+// Has to match MaxTaps in blur_kernel.frag
+constexpr uint32_t MaxBlurKernelTaps = 128;
+// std140 layout of the BlurKernel uniform block, every tap is a vec4
+constexpr GLsizeiptr BlurKernelBlockSize = MaxBlurKernelTaps * sizeof(glm::vec4);
+constexpr uint32_t BlurKernelBinding = 0;
+// Render graph targets, compute blur stores to images and RGB8 isn't an image format
+constexpr GLenum RenderTargetFormat = GL_RGBA8;
+constexpr GLenum DepthTargetFormat = GL_DEPTH_COMPONENT24;
+constexpr auto PostProcessingScope = "PostProcessing";
+// Axis the first separable blur pass goes along, blur.frag's `horizontal`
+constexpr bool FirstBlurHorizontal = true;
+// Sample spread of the Kawase filters in texels of their input
+constexpr float KawaseOffset = 1.0f;
+// Have to match GroupSize and MaxWeights in blur_shared.comp
+constexpr uint32_t ComputeBlurGroupSize = 128;
+constexpr uint32_t MaxComputeBlurWeights = 256;
+// Has to match LinesPerGroup in blur_running_sum.comp
+constexpr uint32_t ComputeBlurLinesPerGroup = 64;
+constexpr uint32_t BlurWeightsBinding = 1;
+// Fewest boxes that stay within the CPU blur tolerance of the equivalent kernel
+constexpr uint32_t RunningSumBoxes = 5;
+// Rounding every box to 8 bits adds up past what the equivalent kernel differs by
+constexpr GLenum RunningSumIntermediateFormat = GL_RGBA16F;
+constexpr uint32_t MaxBlurPasses = 64;
+constexpr float MinBlurSigma = 0.1f;
+constexpr float MaxBlurSigma = 4.0f;
+
+// Longest step the animation clock makes, so that it doesn't jump after frames stopped for a while
+constexpr double MaxAnimationStep = 0.1;
+// GPU frame time the 'F' key makes the frame budget hold
+constexpr double FrameBudgetTargetMs = 1000.0 / 60.0;
+
+// Texels past its ends a box reads to fill a line, a fractional offset fetches one more
+int32_t GetBoxReach(const BlurKernel::Box &box)
+{
+  return box.radius + static_cast<int32_t>(std::ceil(std::abs(box.offset))) + 1;
+}
+
+int32_t GetBoxesReach(const std::vector<BlurKernel::Box> &boxes)
+{
+  int32_t reach = 0;
+  for (const BlurKernel::Box &box : boxes)
+    reach += GetBoxReach(box);
+  return reach;
+}
+
+// Primitive vertices of PositionNormalTextureAttrib floats each, welded and indexed into the arena
+GeometryArena::Allocation AllocatePrimitive(GeometryArena &arena,
+  const float *primitiveVertices,
+  uint32_t count,
+  Culling::Bounds &bounds)
+{
+  std::vector<Vertex> vertices(count);
+  std::vector<unsigned int> indices(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const float *attributes = primitiveVertices + i * PositionNormalTextureAttrib;
+    vertices[i] = {};
+    vertices[i].Position = glm::vec3(attributes[0], attributes[1], attributes[2]);
+    vertices[i].Normal = glm::vec3(attributes[3], attributes[4], attributes[5]);
+    vertices[i].TexCoords = glm::vec2(attributes[6], attributes[7]);
+    indices[i] = i;
+    bounds.min = i == 0 ? vertices[i].Position : glm::min(bounds.min, vertices[i].Position);
+    bounds.max = i == 0 ? vertices[i].Position : glm::max(bounds.max, vertices[i].Position);
+  }
+  MeshOptimizer::Optimize(vertices, indices);
+  return arena.Allocate(VertexFormat::Full, vertices.data(), vertices.size(), indices.data(), indices.size());
+}
 }// namespace
 
 GLRenderer::GLRenderer(u32 width, u32 height)
-  : m_width{ width },
-    m_height{ height },
+  : m_initialized{ false },
     m_postProcessingBlur{ true },
-    m_horizontal{ true },
+    m_outputFBO{ 0 },
+    m_sceneColorBuffer{ 0 },
+    m_composeImage{ 0 },
+    m_sceneVersion{ 1 },
+    m_renderedSceneVersion{ 0 },
+    m_assetChanges{ 0 },
+    m_postProcessingDirty{ true },
+    m_outputDirty{ true },
+    m_frameStatistics{},
+    m_animationPaused{ false },
+    m_animationTime{ 0.0 },
+    m_clockTime{ 0.0 },
+    m_chessboardFBO{ 0 },
+    m_chessboardTexture{ 0 },
     m_blurSigma{ 0.4f },
-    m_blurPasses{ 25 }
+    m_blurPasses{ 25 },
+    m_blurMode{ BlurMode::Separable },
+    m_blurKernelUBO{ 0 },
+    m_blurKernelTapsCount{},
+    m_blurKernelSigma{ 0.0f },
+    m_blurKernelPasses{ 0 },
+    m_blurWeightsSSBO{ 0 },
+    m_computeBlurKernels{},
+    m_pyramidLevels{ 1 },
+    m_tiledBlur{ true },
+    m_tileVAO{ 0 },
+    m_tileVBO{ 0 },
+    m_sharpTilesCount{ 0 },
+    m_blurTilesCount{ 0 },
+    m_budgetFrames{ 0 },
+    m_width{ width },
+    m_height{ height },
+    m_renderWidth{ width },
+    m_renderHeight{ height }
 {
 }
 
 void GLRenderer::Initialize()
 {
+  m_textureLoader.Initialize();
+  m_assets.Initialize(m_textureLoader);
+
   CreateShaders();
   ConfigureShaders();
 
-  CreateModels();
   LoadTextures();
+  CreateModels();
 
-  ConfigureFramebuffer();
+  CreateBlurBuffers();
+  glCreateFramebuffers(1, &m_chessboardFBO);
+  UpdateChessboard();
+  // Background is drawn at the far plane after the scene, the depth buffer is cleared to it
+  glDepthFunc(GL_LEQUAL);
 
   stbi_set_flip_vertically_on_load(true);
 
   m_lightPosition = glm::vec3(1.2f, 2.0f, 2.0f);
+  m_clockTime = Utility::seconds_now();
+  m_initialized = true;
+
+  m_framePipeline.Initialize([this](FramePacket &frame) { PrepareFrame(frame); });
 }
 
 void GLRenderer::CreateShaders()
 {
-  m_backgroundShader = Shader(BackgroundVertexShaderPath, BackgroundFragmentShaderPath);
-  m_sceneShader = Shader(SceneVertexShaderPath, SceneFragmentShaderPath);
-  m_blurShader = Shader(BlurVertexShaderPath, BlurFragmentShaderPath);
-  m_lightSourceShader = Shader(LightSourceVertexShaderPath, LightSourceFragmentShaderPath);
-  m_composeShader = Shader(ComposeVertShaderPath, ComposeFragShaderPath);
+  // Driver compiles on its own threads, so programs are all submitted first and waited for afterwards
+  if (GLAD_GL_KHR_parallel_shader_compile)
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+  m_chessboardShader.Submit(ChessboardVertexShaderPath, ChessboardFragmentShaderPath);
+  m_backgroundShader.Submit(BackgroundVertexShaderPath, BackgroundFragmentShaderPath);
+  m_sceneShader.Submit(SceneIndirectVertexShaderPath, SceneFragmentShaderPath);
+  m_blurShader.Submit(BlurVertexShaderPath, BlurFragmentShaderPath);
+  m_lightSourceShader.Submit(LightSourceVertexShaderPath, LightSourceFragmentShaderPath);
+  m_composeShader.Submit(ComposeVertShaderPath, ComposeFragShaderPath);
+  m_blurKernelShader.Submit(BlurVertexShaderPath, BlurKernelFragmentShaderPath);
+  m_kawaseDownShader.Submit(BlurVertexShaderPath, KawaseDownFragmentShaderPath);
+  m_kawaseUpShader.Submit(BlurVertexShaderPath, KawaseUpFragmentShaderPath);
+  m_blurTileShader.Submit(TileVertexShaderPath, BlurFragmentShaderPath);
+  m_copyTileShader.Submit(TileVertexShaderPath, ComposeFragShaderPath);
+  m_computeSharedBlurShader.SubmitCompute(ComputeSharedBlurShaderPath);
+  m_runningSumBlurShader.SubmitCompute(RunningSumBlurShaderPath);
+
+  for (Shader *shader : { &m_chessboardShader,
+         &m_backgroundShader,
+         &m_sceneShader,
+         &m_blurShader,
+         &m_lightSourceShader,
+         &m_composeShader,
+         &m_blurKernelShader,
+         &m_kawaseDownShader,
+         &m_kawaseUpShader,
+         &m_blurTileShader,
+         &m_copyTileShader,
+         &m_computeSharedBlurShader,
+         &m_runningSumBlurShader })
+    shader->Finish();
 }
 
 void GLRenderer::ConfigureShaders()
 {
-  m_backgroundShader.use();
-  glm::vec2 resolution = glm::vec2(static_cast<float>(m_width), static_cast<float>(m_height));
-  m_backgroundShader.setUniform("resolution", resolution);
+  glm::vec2 resolution = glm::vec2(static_cast<float>(m_renderWidth), static_cast<float>(m_renderHeight));
+  m_chessboardShader.setUniform("resolution", resolution);
+  m_backgroundShader.setUniform("chessboardTexture", 0);
 
   m_sceneShader.use();
   m_sceneShader.setUniform("material.diffuse", 0);
@@ -78,219 +232,1016 @@ void GLRenderer::ConfigureShaders()
   m_sceneShader.setUniform("light.ambient", ambientColor);
   m_sceneShader.setUniform("light.diffuse", diffuseColor);
   m_sceneShader.setUniform("light.specular", 1.0f, 1.0f, 1.0f);
+  m_sceneUniforms.view = m_sceneShader.getUniform("view");
+  m_sceneUniforms.projection = m_sceneShader.getUniform("projection");
+  m_sceneUniforms.lightPosition = m_sceneShader.getUniform("light.position");
+  m_sceneUniforms.viewPos = m_sceneShader.getUniform("viewPos");
+
+  m_lightSourceUniforms.model = m_lightSourceShader.getUniform("model");
+  m_lightSourceUniforms.view = m_lightSourceShader.getUniform("view");
+  m_lightSourceUniforms.projection = m_lightSourceShader.getUniform("projection");
 
   m_blurShader.use();
   m_blurShader.setUniform("resolution", resolution);
   m_blurShader.setUniform("screenTexture", 0);
   m_blurShader.setUniform("maskTexture", 1);
+  m_blurUniforms.samples = m_blurShader.getUniform("samples");
+  m_blurUniforms.sigmaFactor = m_blurShader.getUniform("sigmaFactor");
+  m_blurUniforms.horizontal = m_blurShader.getUniform("horizontal");
+
+  m_blurKernelShader.use();
+  m_blurKernelShader.setUniform("screenTexture", 0);
+  m_blurKernelShader.setUniform("maskTexture", 1);
+  m_blurKernelShader.setUniform("sharpTexture", 2);
+  m_blurKernelUniforms.direction = m_blurKernelShader.getUniform("direction");
+  m_blurKernelUniforms.tapsCount = m_blurKernelShader.getUniform("tapsCount");
+  m_blurKernelUniforms.applyMask = m_blurKernelShader.getUniform("applyMask");
+
+  m_kawaseDownShader.use();
+  m_kawaseDownShader.setUniform("screenTexture", 0);
+  m_kawaseDownShader.setUniform("offset", KawaseOffset);
+
+  m_kawaseUpShader.use();
+  m_kawaseUpShader.setUniform("screenTexture", 0);
+  m_kawaseUpShader.setUniform("maskTexture", 1);
+  m_kawaseUpShader.setUniform("sharpTexture", 2);
+  m_kawaseUpShader.setUniform("offset", KawaseOffset);
+  m_kawaseUpApplyMask = m_kawaseUpShader.getUniform("applyMask");
+
+  m_blurTileShader.use();
+  m_blurTileShader.setUniform("screenTexture", 0);
+  m_blurTileShader.setUniform("maskTexture", 1);
+  m_blurTileUniforms.samples = m_blurTileShader.getUniform("samples");
+  m_blurTileUniforms.sigmaFactor = m_blurTileShader.getUniform("sigmaFactor");
+  m_blurTileUniforms.horizontal = m_blurTileShader.getUniform("horizontal");
+
+  m_copyTileShader.use();
+  m_copyTileShader.setUniform("screenTexture", 0);
+
+  for (Shader *shader : { &m_computeSharedBlurShader, &m_runningSumBlurShader })
+  {
+    shader->setUniform("screenTexture", 0);
+    shader->setUniform("maskTexture", 1);
+    shader->setUniform("sharpTexture", 2);
+  }
+  m_computeSharedBlurUniforms.axis = m_computeSharedBlurShader.getUniform("axis");
+  m_computeSharedBlurUniforms.weightsOffset = m_computeSharedBlurShader.getUniform("weightsOffset");
+  m_computeSharedBlurUniforms.weightsCount = m_computeSharedBlurShader.getUniform("weightsCount");
+  m_computeSharedBlurUniforms.first = m_computeSharedBlurShader.getUniform("first");
+  m_computeSharedBlurUniforms.applyMask = m_computeSharedBlurShader.getUniform("applyMask");
+  m_runningSumBlurUniforms.axis = m_runningSumBlurShader.getUniform("axis");
+  m_runningSumBlurUniforms.lineSize = m_runningSumBlurShader.getUniform("lineSize");
+  m_runningSumBlurUniforms.linesCount = m_runningSumBlurShader.getUniform("linesCount");
+  m_runningSumBlurUniforms.radius = m_runningSumBlurShader.getUniform("radius");
+  m_runningSumBlurUniforms.offset = m_runningSumBlurShader.getUniform("offset");
+  m_runningSumBlurUniforms.inputPadding = m_runningSumBlurShader.getUniform("inputPadding");
+  m_runningSumBlurUniforms.outputPadding = m_runningSumBlurShader.getUniform("outputPadding");
+  m_runningSumBlurUniforms.inputExtent = m_runningSumBlurShader.getUniform("inputExtent");
+  m_runningSumBlurUniforms.outputExtent = m_runningSumBlurShader.getUniform("outputExtent");
+  m_runningSumBlurUniforms.applyMask = m_runningSumBlurShader.getUniform("applyMask");
 
   m_composeShader.setUniform("screenTexture", 0);
 }
 
-void GLRenderer::ConfigureFramebuffer()
+void GLRenderer::CreateBlurBuffers()
 {
-  // Background framebuffer configuration
-  glGenFramebuffers(1, &m_sceneFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFBO);
+  // Equivalent blur kernel taps, one block per axis
+  glGenBuffers(1, &m_blurKernelUBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, m_blurKernelUBO);
+  glBufferData(GL_UNIFORM_BUFFER, BlurKernelBlockSize * 2, nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-  glGenTextures(1, &m_sceneColorBuffer);
-  glBindTexture(GL_TEXTURE_2D, m_sceneColorBuffer);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  // attach texture to framebuffer
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_sceneColorBuffer, 0);
+  // Discrete equivalent kernel weights for the compute blur, MaxComputeBlurWeights per axis
+  glCreateBuffers(1, &m_blurWeightsSSBO);
+  glNamedBufferStorage(m_blurWeightsSSBO, MaxComputeBlurWeights * 2 * sizeof(float), nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
 
-  u32 sceneDepthRBO{};
-  glGenRenderbuffers(1, &sceneDepthRBO);
-  glBindRenderbuffer(GL_RENDERBUFFER, sceneDepthRBO);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepthRBO);
-  W_CHECK(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    std::cerr << "Error, framebuffer is not complete!\n";
+void GLRenderer::UpdateChessboard()
+{
+  // Immutable storage can't be resized
+  glDeleteTextures(1, &m_chessboardTexture);
+  glCreateTextures(GL_TEXTURE_2D, 1, &m_chessboardTexture);
+  glTextureStorage2D(m_chessboardTexture, 1, RenderTargetFormat, m_renderWidth, m_renderHeight);
+  glTextureParameteri(m_chessboardTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTextureParameteri(m_chessboardTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glNamedFramebufferTexture(m_chessboardFBO, GL_COLOR_ATTACHMENT0, m_chessboardTexture, 0);
+
+  W_CHECK(glCheckNamedFramebufferStatus(m_chessboardFBO, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
 
+  // Happens between frames, the state cache is invalidated when the next one starts
+  glBindFramebuffer(GL_FRAMEBUFFER, m_chessboardFBO);
+  glViewport(0, 0, m_renderWidth, m_renderHeight);
+  glDisable(GL_DEPTH_TEST);
+  m_chessboardShader.use();
+  glBindVertexArray(m_quad.VAO);
+  glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GLRenderer::OnResize(u32 width, u32 height)
+{
+  if (width == 0 || height == 0 || (width == m_width && height == m_height))
+    return;
+
+  m_width = width;
+  m_height = height;
+  // Aspect ratio of the projection follows the output
+  MarkSceneChanged();
+  m_outputDirty = true;
+  UpdateRenderSize();
+}
+
+void GLRenderer::UpdateRenderSize()
+{
+  const float scale = m_frameBudget.GetRenderScale();
+  const u32 renderWidth = std::max(static_cast<u32>(std::lround(m_width * scale)), 1u);
+  const u32 renderHeight = std::max(static_cast<u32>(std::lround(m_height * scale)), 1u);
+  if (renderWidth == m_renderWidth && renderHeight == m_renderHeight)
+    return;
+
+  m_renderWidth = renderWidth;
+  m_renderHeight = renderHeight;
+  MarkSceneChanged();
+  // Render graph allocates targets of the new size, shaders and tiles are set up by Initialize otherwise
+  if (!m_initialized)
+    return;
+
+  const glm::vec2 resolution = glm::vec2(static_cast<float>(m_renderWidth), static_cast<float>(m_renderHeight));
+  m_chessboardShader.setUniform("resolution", resolution);
+  m_blurShader.setUniform("resolution", resolution);
+  UpdateChessboard();
+  // Tiles are sized in pixels of the frame they cover
+  ClassifyMaskTiles();
+}
 
-  // Blur framebuffers configuration
-  glGenFramebuffers(BlurFramebuffersCount, m_blurFBO.data());
-  glGenTextures(BlurFramebuffersCount, m_blurColorBuffers.data());
-  for (size_t i = 0; i < BlurFramebuffersCount; ++i)
+void GLRenderer::SetFrameTimeTarget(double targetMs, bool lowerBlurMode)
+{
+  FrameBudget::Settings settings = m_frameBudget.GetSettings();
+  settings.targetMs = targetMs;
+  // Every cheaper blur mode is a level, up to dual Kawase
+  settings.maxBlurLevel = lowerBlurMode ? static_cast<u32>(BlurMode::DualKawase) : 0;
+  m_frameBudget.SetSettings(settings);
+  UpdateRenderSize();
+}
+
+void GLRenderer::UpdateFrameBudget()
+{
+  // Only frames the profiler got results of count, most frames start before the previous result comes back
+  if (!m_frameBudget.IsEnabled() || m_profiler.GetCollectedFrames() == m_budgetFrames)
+    return;
+
+  m_budgetFrames = m_profiler.GetCollectedFrames();
+  const BlurMode blurMode = GetEffectiveBlurMode();
+  if (m_frameBudget.Update(m_profiler.GetLastFrameGpuMs()))
   {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_blurFBO[i]);
-    // create a color attachment texture
-    glBindTexture(GL_TEXTURE_2D, m_blurColorBuffers[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_blurColorBuffers[i], 0);
+    // Blur level may have changed instead of the size
+    m_postProcessingDirty = true;
+    UpdateRenderSize();
+    if (GetEffectiveBlurMode() != blurMode)
+      Utility::DebugOutput(std::string("Frame budget blur mode: ") + GetBlurModeName(GetEffectiveBlurMode()) + "\n");
+  }
+}
 
-    W_CHECK(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-      std::cerr << "Error, framebuffer is not complete!\n";
+void GLRenderer::AdvanceAnimationClock()
+{
+  const double now = Utility::seconds_now();
+  const double step = std::min(now - m_clockTime, MaxAnimationStep);
+  m_clockTime = now;
+  if (m_animationPaused || step <= 0.0)
+    return;
+
+  m_animationTime += step;
+  // Camera orbits and the light moves by the clock
+  MarkSceneChanged();
+}
+
+bool GLRenderer::NeedsRender() const
+{
+  return !m_animationPaused || !m_textureLoader.IsIdle() || m_sceneVersion != m_renderedSceneVersion
+         || m_postProcessingDirty || m_outputDirty;
+}
+
+const char *GLRenderer::GetBlurModeName(BlurMode mode)
+{
+  switch (mode)
+  {
+  case BlurMode::Separable:
+    return "separable";
+  case BlurMode::EquivalentKernel:
+    return "equivalent kernel (approximate)";
+  case BlurMode::DualKawase:
+    return "dual Kawase (approximate)";
+  case BlurMode::ComputeShared:
+    return "compute shared (approximate)";
+  case BlurMode::ComputeRunningSum:
+    return "compute running sum (approximate)";
+  default:
+    return "unknown";
   }
+}
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+GLRenderer::BlurMode GLRenderer::GetEffectiveBlurMode() const
+{
+  return static_cast<BlurMode>(std::max(static_cast<u32>(m_blurMode), m_frameBudget.GetBlurLevel()));
 }
 
 void GLRenderer::CreateModels()
 {
-  m_cube = Primitive(CubeVertices, CubeVerticesAmount * PositionNormalTextureAttrib, Primitive::PositionNormalTexture);
-  m_plane =
-    Primitive(PlaneVertices, PlaneVerticesAmount * PositionNormalTextureAttrib, Primitive::PositionNormalTexture);
   m_quad = Primitive(QuadVertices, PlaneVerticesAmount * PositionTextureAttrib, Primitive::PositionTexture);
-  m_lightSource = LightPrimitive(CubeVertices, CubeVerticesAmount * PositionNormalTextureAttrib);
 
-  m_model = Model(BackpackModelPath);
+  // Scene geometry shares the arena buffers, light source is drawn with the cube geometry too
+  m_cubeGeometry = AllocatePrimitive(m_geometryArena, CubeVertices, CubeVerticesAmount, m_cubeBounds);
+  m_planeGeometry = AllocatePrimitive(m_geometryArena, PlaneVertices, PlaneVerticesAmount, m_planeBounds);
+  m_model = Model(BackpackModelPath, &m_assets, VertexFormat::Packed, &m_geometryArena);
+
+  IndirectBatch::DrawData draw{ glm::mat4(1.0f), glm::vec4(0.0f), glm::vec4(1.0f) };
+  // cubes
+  draw.model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.6f, -1.0f, -1.0f));
+  AddSceneObject(m_cubeGeometry, m_cubeBounds, m_cubeTexture, draw);
+  draw.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, -0.5f));
+  AddSceneObject(m_cubeGeometry, m_cubeBounds, m_cubeTexture, draw);
+  // floor
+  draw.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+  AddSceneObject(m_planeGeometry, m_planeBounds, m_planeTexture, draw);
+
+  // model
+  glm::mat4 model = glm::mat4(1.0f);
+  model = glm::translate(model, glm::vec3(1.4f, -1.0f, 0.3f));
+  model = glm::scale(model, glm::vec3(0.4f, 0.4f, 0.4f));
+  AddModelObjects(m_model, &model, 1);
+
+  m_demoObjectsCount = static_cast<u32>(m_sceneObjects.size());
+  m_sceneBvh.Build(m_sceneObjectBounds);
 }
 
-void GLRenderer::LoadTextures()
+void GLRenderer::AddSceneObject(const GeometryArena::Allocation &geometry,
+  const Culling::Bounds &bounds,
+  u32 texture,
+  const IndirectBatch::DrawData &data)
 {
-  m_cubeTexture = Utility::LoadTextureFromImage(ContainerTexturePath);
-  m_planeTexture = Utility::LoadTextureFromImage(BackgroundTexturePath);
-  m_maskTexture = Utility::LoadTextureFromImage(GradientMaskTexturePath);
+  m_sceneObjects.push_back({ geometry, texture, data });
+  m_sceneObjectBounds.push_back(Culling::Transform(bounds, data.model));
 }
 
-inline void GLRenderer::ClearFrame() const
+void GLRenderer::AddModelObjects(const Model &model, const glm::mat4 *transforms, size_t count)
 {
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  // Mesh by mesh, so that the batch merges instances of the same mesh into one command
+  for (const Mesh &mesh : model.meshes)
+  {
+    const bool packed = mesh.format == VertexFormat::Packed;
+    const glm::vec4 positionOffset(packed ? mesh.bounds.GetOffset() : glm::vec3(0.0f), 0.0f);
+    const glm::vec4 positionScale(packed ? mesh.bounds.GetScale() : glm::vec3(1.0f), 0.0f);
+    for (size_t i = 0; i < count; ++i)
+    {
+      const IndirectBatch::DrawData data{ transforms[i], positionOffset, positionScale };
+      AddSceneObject(mesh.allocation, mesh.bounds, mesh.diffuseTexture(), data);
+    }
+  }
 }
 
-void GLRenderer::RenderBackground()
+void GLRenderer::LoadTextures()
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFBO);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  // Nothing is loaded yet, textures stream in once a frame uses them
+  m_cubeTexture = m_assets.RequestTexture(ContainerTexturePath);
+  m_planeTexture = m_assets.RequestTexture(BackgroundTexturePath);
+  // Placeholder mask is classified as mixed everywhere, the real one once it's uploaded
+  m_maskTexture = m_assets.RequestTexture(GradientMaskTexturePath, false, [this](u32, bool loaded) {
+    if (loaded)
+      ClassifyMaskTiles();
+  });
 
-  glDisable(GL_DEPTH_TEST);
-  m_backgroundShader.use();
-  glBindVertexArray(m_quad.VAO);
-  glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
-  glEnable(GL_DEPTH_TEST);
-  glDepthMask(GL_TRUE);
+  ClassifyMaskTiles();
 }
 
-void GLRenderer::RenderScene()
+void GLRenderer::ClassifyMaskTiles()
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFBO);
+  GLint maskWidth{}, maskHeight{};
+  glBindTexture(GL_TEXTURE_2D, m_maskTexture);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &maskWidth);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &maskHeight);
 
-  m_sceneShader.use();
-  glm::mat4 model = glm::mat4(1.0f);
+  std::vector<uint8_t> mask(static_cast<size_t>(maskWidth) * maskHeight);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, mask.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // Mask that failed to load has no texels, blurring every tile keeps the original behavior then
+  MaskTiles::Classification tiles;
+  if (!mask.empty())
+    tiles = MaskTiles::Classify(mask.data(), maskWidth, maskHeight, 1, m_renderWidth, m_renderHeight);
+  else
+    tiles.mixed.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+
+  std::vector<glm::vec4> instances = tiles.sharp;
+  instances.insert(instances.end(), tiles.blurred.begin(), tiles.blurred.end());
+  instances.insert(instances.end(), tiles.mixed.begin(), tiles.mixed.end());
+  m_sharpTilesCount = static_cast<u32>(tiles.sharp.size());
+  m_blurTilesCount = static_cast<u32>(tiles.blurred.size() + tiles.mixed.size());
+
+  if (m_tileVAO == 0)
+  {
+    glGenVertexArrays(1, &m_tileVAO);
+    glGenBuffers(1, &m_tileVBO);
+
+    glBindVertexArray(m_tileVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_tileVBO);
+    glEnableVertexAttribArray(PositionVertexAttribute);
+    glVertexAttribPointer(PositionVertexAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)0);
+    glVertexAttribDivisor(PositionVertexAttribute, 1);
+    glBindVertexArray(0);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, m_tileVBO);
+  glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), instances.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GLRenderer::RenderScene(u32 framebuffer)
+{
+  // Background fills whatever stays at the far plane, color needn't be cleared
+  m_stateCache.BindFramebuffer(framebuffer);
+  glViewport(0, 0, m_renderWidth, m_renderHeight);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  m_renderQueue.Submit(RenderQueue::Pass::Opaque, m_stateCache);
+}
+
+void GLRenderer::RenderBackground(u32 framebuffer)
+{
+  m_stateCache.BindFramebuffer(framebuffer);
+  m_renderQueue.Submit(RenderQueue::Pass::Background, m_stateCache);
+}
+
+void GLRenderer::PrepareFrame(FramePacket &frame) const
+{
+  constexpr float NearPlane = 0.1f;
+  constexpr float FarPlane = 100.0f;
+  const FramePacket::Input &input = frame.input;
 
   constexpr float rotationRadius = 7.0f;
   constexpr float rotationSpeed = 0.4;
-  const float camX = sin(Utility::seconds_now() * rotationSpeed) * rotationRadius;
-  const float camZ = cos(Utility::seconds_now() * rotationSpeed) * rotationRadius;
-  glm::mat4 view = m_camera.LookAt(glm::vec3(camX, 0.0, camZ));
+  const float camX = sin(input.time * rotationSpeed) * rotationRadius;
+  const float camZ = cos(input.time * rotationSpeed) * rotationRadius;
+  frame.view = m_camera.LookAt(glm::vec3(camX, 0.0, camZ));
+  frame.projection = glm::perspective(glm::radians(input.cameraZoom), input.aspectRatio, NearPlane, FarPlane);
+
+  // Light source
+  frame.lightPosition = m_lightPosition;
+  frame.lightPosition.z = 1.5 + sin(input.time / 1.0) * 4.0f;
+  frame.lightModel = glm::translate(glm::mat4(1.0f), frame.lightPosition);
+  frame.lightModel = glm::scale(frame.lightModel, glm::vec3(0.2f));
+  frame.lightDepth = -(frame.view * glm::vec4(frame.lightPosition, 1.0f)).z / FarPlane;
+
+  // Whole scene goes through a few indirect draws, one per arena pool and texture, of the objects in the frustum
+  frame.culling = m_sceneBvh.Cull(Culling::ExtractFrustum(frame.projection * frame.view), frame.visibleObjects);
+  frame.sceneBatch.Clear();
+  frame.usedTextures.clear();
+  for (size_t i = 0; i < m_sceneObjects.size(); ++i)
+  {
+    if (!frame.visibleObjects[i])
+      continue;
+    const SceneObject &object = m_sceneObjects[i];
+    if (frame.usedTextures.empty() || frame.usedTextures.back() != object.texture)
+      frame.usedTextures.push_back(object.texture);
+    frame.sceneBatch.Add(object.geometry, object.texture, object.data);
+  }
+  frame.sceneBatch.Prepare();
+}
 
-  glm::mat4 projection =
-    glm::perspective(glm::radians(m_camera.m_zoom), (float)m_width / (float)m_height, 0.1f, 100.0f);
-  m_sceneShader.setUniform("view", view);
-  m_sceneShader.setUniform("projection", projection);
-  m_sceneShader.setUniform("light.position", m_lightPosition);
-  m_sceneShader.setUniform("viewPos", m_camera.m_position);
+void GLRenderer::BuildRenderQueue()
+{
+  m_renderQueue.Clear();
 
-  // cubes
-  glBindVertexArray(m_cube.VAO);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, m_cubeTexture);
-  model = glm::translate(model, glm::vec3(-1.6f, -1.0f, -1.0f));
-  m_sceneShader.setUniform("model", model);
-  glDrawArrays(GL_TRIANGLES, 0, CubeVerticesAmount);
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(0.0f, -1.0f, -0.5f));
-  m_sceneShader.setUniform("model", model);
-  glDrawArrays(GL_TRIANGLES, 0, CubeVerticesAmount);
-  // floor
-  glBindVertexArray(m_plane.VAO);
-  glBindTexture(GL_TEXTURE_2D, m_planeTexture);
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
-  m_sceneShader.setUniform("model", model);
+  RenderQueue::Packet background;
+  background.program = m_backgroundShader.getDescriptor();
+  background.texture = m_chessboardTexture;
+  background.vertexArray = m_quad.VAO;
+  background.count = PlaneVerticesAmount;
+  m_renderQueue.Add(RenderQueue::Pass::Background, background);
+
+  // Built by the worker while the previous frame was being submitted
+  FramePacket::Input input;
+  input.time = m_animationTime;
+  input.sceneVersion = m_sceneVersion;
+  input.cameraZoom = m_camera.m_zoom;
+  input.aspectRatio = static_cast<float>(m_width) / static_cast<float>(m_height);
+  FramePacket &frame = m_framePipeline.Next(input);
+  m_cullingStatistics = frame.culling;
+  // Packet was prepared from the previous frame's input, the scene is up to date only if nothing changed since
+  m_renderedSceneVersion = frame.input.sceneVersion;
+
+  m_sceneShader.setUniform(m_sceneUniforms.view, frame.view);
+  m_sceneShader.setUniform(m_sceneUniforms.projection, frame.projection);
+  m_sceneShader.setUniform(m_sceneUniforms.lightPosition, frame.lightPosition);
+  m_sceneShader.setUniform(m_sceneUniforms.viewPos, m_camera.m_position);
+
+  // Only textures of visible objects count as used, so the ones behind the camera can be evicted
+  for (u32 texture : frame.usedTextures)
+    m_assets.Touch(texture);
+  frame.sceneBatch.Enqueue(m_geometryArena, m_renderQueue, RenderQueue::Pass::Opaque, m_sceneShader.getDescriptor());
+
+  m_lightSourceShader.setUniform(m_lightSourceUniforms.model, frame.lightModel);
+  m_lightSourceShader.setUniform(m_lightSourceUniforms.projection, frame.projection);
+  m_lightSourceShader.setUniform(m_lightSourceUniforms.view, frame.view);
+
+  RenderQueue::Packet lightSource;
+  lightSource.program = m_lightSourceShader.getDescriptor();
+  lightSource.vertexArray = m_geometryArena.GetVAO(m_cubeGeometry.pool);
+  lightSource.type = RenderQueue::DrawType::ElementsBaseVertex;
+  lightSource.count = m_cubeGeometry.indexCount;
+  lightSource.indexType = m_geometryArena.GetIndexType(m_cubeGeometry.pool);
+  lightSource.offset = m_cubeGeometry.firstIndex * m_geometryArena.GetIndexSize(m_cubeGeometry.pool);
+  lightSource.baseVertex = m_cubeGeometry.baseVertex;
+  m_renderQueue.Add(RenderQueue::Pass::Opaque, lightSource, frame.lightDepth);
+
+  m_renderQueue.Sort();
+}
+
+void GLRenderer::SetStressScene(u32 cubes, u32 models)
+{
+  // Same sizes as the demo scene ones, lifts put cube and backpack bottoms onto the floor
+  constexpr float CubeScale = 0.5f;
+  constexpr float CubeLift = 0.5f;
+  constexpr float ModelScale = 0.4f;
+  constexpr float ModelLift = 1.25f;
+
+  // The worker reads the scene objects
+  m_framePipeline.Flush();
+  m_sceneObjects.resize(m_demoObjectsCount);
+  m_sceneObjectBounds.resize(m_demoObjectsCount);
+
+  const u32 count = cubes + models;
+  const std::vector<StressScene::Placement> placements = StressScene::Generate(count);
+  std::vector<glm::mat4> modelTransforms;
+  modelTransforms.reserve(models);
+  for (u32 i = 0; i < count; ++i)
+  {
+    // Models are spread evenly among the cubes rather than all ending up in the outer rings
+    const bool isModel = (uint64_t{ i } + 1) * models / count != uint64_t{ i } * models / count;
+    if (isModel)
+      modelTransforms.push_back(StressScene::GetTransform(placements[i], ModelScale, ModelLift));
+    else
+      AddSceneObject(m_cubeGeometry,
+        m_cubeBounds,
+        m_cubeTexture,
+        { StressScene::GetTransform(placements[i], CubeScale, CubeLift), glm::vec4(0.0f), glm::vec4(1.0f) });
+  }
+  AddModelObjects(m_model, modelTransforms.data(), modelTransforms.size());
+
+  m_sceneBvh.Build(m_sceneObjectBounds);
+  MarkSceneChanged();
+}
+
+RenderGraph::TextureDesc GLRenderer::GetRenderTargetDesc(u32 format) const
+{
+  return { m_renderWidth, m_renderHeight, format };
+}
+
+void GLRenderer::AddScenePasses(RenderGraph::Handle color, RenderGraph::Handle depth)
+{
+  // Output framebuffer comes with a depth buffer of its own
+  std::vector<RenderGraph::Handle> targets = { color };
+  if (depth != RenderGraph::InvalidHandle)
+    targets.push_back(depth);
+
+  const RenderGraph::Handle chessboard =
+    m_renderGraph.ImportTexture("Chessboard", m_chessboardTexture, GetRenderTargetDesc(RenderTargetFormat));
+  // Opaque geometry first, so that the background only shades the pixels it left uncovered
+  m_renderGraph.AddPass("Scene", "Scene", {}, targets, [this, targets](const RenderGraph::Context &context) {
+    RenderScene(context.GetFramebuffer(targets));
+  });
+  std::vector<RenderGraph::Handle> backgroundReads = targets;
+  backgroundReads.push_back(chessboard);
+  m_renderGraph.AddPass(
+    "Background", "Background", backgroundReads, targets, [this, targets](const RenderGraph::Context &context) {
+      RenderBackground(context.GetFramebuffer(targets));
+      m_sceneColorBuffer = context.GetTexture(targets.front());
+    });
+}
+
+void GLRenderer::AddComposePass(RenderGraph::Handle image, RenderGraph::Handle output)
+{
+  m_renderGraph.AddPass(
+    "Compose", "Compose", { image }, { output }, [this, image, output](const RenderGraph::Context &context) {
+      m_composeImage = context.GetTexture(image);
+      RenderCompose(m_composeImage, context.GetFramebuffer({ output }));
+    });
+}
+
+RenderGraph::Handle GLRenderer::AddPostProcessingPasses(RenderGraph::Handle sceneColor)
+{
+  // Kernels decide how many passes and targets some of the modes need
+  UpdateBlurKernel();
+
+  switch (GetEffectiveBlurMode())
+  {
+  case BlurMode::Separable:
+    return AddSeparableBlurPass(sceneColor);
+  case BlurMode::EquivalentKernel:
+    return AddEquivalentKernelBlurPass(sceneColor);
+  case BlurMode::DualKawase:
+    return AddDualKawaseBlurPasses(sceneColor);
+  case BlurMode::ComputeShared:
+    return AddComputeSharedBlurPass(sceneColor);
+  case BlurMode::ComputeRunningSum:
+    return AddComputeRunningSumBlurPass(sceneColor);
+  default:
+    return sceneColor;
+  }
+}
+
+RenderGraph::Handle GLRenderer::AddSeparableBlurPass(RenderGraph::Handle sceneColor)
+{
+  const RenderGraph::TextureDesc desc = GetRenderTargetDesc(RenderTargetFormat);
+  const std::array<RenderGraph::Handle, 2> targets = { m_renderGraph.CreateTexture("BlurPing", desc),
+    m_renderGraph.CreateTexture("BlurPong", desc) };
+  m_renderGraph.AddPass("SeparableBlur",
+    PostProcessingScope,
+    { sceneColor },
+    { targets[0], targets[1] },
+    [this, sceneColor, targets](const RenderGraph::Context &context) {
+      RenderSeparableBlur(context, sceneColor, targets);
+    });
+
+  // Pass i writes targets[horizontal] and flips it, so the last one is known upfront
+  const bool lastHorizontal = (m_blurPasses % 2 == 1) ? FirstBlurHorizontal : !FirstBlurHorizontal;
+  return targets[lastHorizontal];
+}
+
+void GLRenderer::RenderSeparableBlur(const RenderGraph::Context &context,
+  RenderGraph::Handle sceneColor,
+  const std::array<RenderGraph::Handle, 2> &targets)
+{
+  const u32 sceneTexture = context.GetTexture(sceneColor);
+  const std::array<u32, 2> framebuffers = { context.GetFramebuffer({ targets[0] }),
+    context.GetFramebuffer({ targets[1] }) };
+  const std::array<u32, 2> textures = { context.GetTexture(targets[0]), context.GetTexture(targets[1]) };
+  glViewport(0, 0, m_renderWidth, m_renderHeight);
+
+  if (m_tiledBlur)
+  {
+    // Every pass leaves the scene as is in sharp tiles, so it is copied there once instead
+    m_stateCache.BindVertexArray(m_tileVAO);
+    m_stateCache.UseProgram(m_copyTileShader.getDescriptor());
+    m_stateCache.BindTexture(0, sceneTexture);
+    for (u32 fbo : framebuffers)
+    {
+      m_stateCache.BindFramebuffer(fbo);
+      glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, PlaneVerticesAmount, m_sharpTilesCount, 0);
+    }
+  }
+  else
+    m_stateCache.BindVertexArray(m_quad.VAO);
+
+  bool horizontal = FirstBlurHorizontal;
+  Shader &blurShader = m_tiledBlur ? m_blurTileShader : m_blurShader;
+  const SeparableBlurUniforms &uniforms = m_tiledBlur ? m_blurTileUniforms : m_blurUniforms;
+  m_stateCache.UseProgram(blurShader.getDescriptor());
+  blurShader.setUniform(uniforms.samples, BlurSamples);
+  blurShader.setUniform(uniforms.sigmaFactor, m_blurSigma);
+  m_stateCache.BindTexture(1, m_maskTexture);
+  for (u32 i = 0; i < m_blurPasses; i++)
+  {
+    m_stateCache.BindFramebuffer(framebuffers[horizontal]);
+    blurShader.setUniform(uniforms.horizontal, horizontal);
+    m_stateCache.BindTexture(0, i == 0 ? sceneTexture : textures[!horizontal]);
+
+    if (m_tiledBlur)
+      glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, PlaneVerticesAmount, m_blurTilesCount, m_sharpTilesCount);
+    else
+      glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
+
+    horizontal = !horizontal;
+  }
+}
+
+RenderGraph::Handle GLRenderer::AddEquivalentKernelBlurPass(RenderGraph::Handle sceneColor)
+{
+  const RenderGraph::TextureDesc desc = GetRenderTargetDesc(RenderTargetFormat);
+  const RenderGraph::Handle firstAxis = m_renderGraph.CreateTexture("KernelBlurFirstAxis", desc);
+  const RenderGraph::Handle blurred = m_renderGraph.CreateTexture("KernelBlurred", desc);
+  m_renderGraph.AddPass("EquivalentKernelBlur",
+    PostProcessingScope,
+    { sceneColor },
+    { firstAxis, blurred },
+    [this, sceneColor, firstAxis, blurred](const RenderGraph::Context &context) {
+      RenderEquivalentKernelBlur(context, sceneColor, firstAxis, blurred);
+    });
+  return blurred;
+}
+
+void GLRenderer::RenderEquivalentKernelBlur(const RenderGraph::Context &context,
+  RenderGraph::Handle sceneColor,
+  RenderGraph::Handle firstAxis,
+  RenderGraph::Handle blurred)
+{
+  // Axis the separable blur would start with gets the extra pass for odd m_blurPasses
+  const glm::vec2 firstDirection = FirstBlurHorizontal ? glm::vec2(0.0f, 1.0f) : glm::vec2(1.0f, 0.0f);
+  const glm::vec2 secondDirection = glm::vec2(firstDirection.y, firstDirection.x);
+  const u32 sceneTexture = context.GetTexture(sceneColor);
+
+  glViewport(0, 0, m_renderWidth, m_renderHeight);
+  m_stateCache.BindVertexArray(m_quad.VAO);
+  m_stateCache.UseProgram(m_blurKernelShader.getDescriptor());
+  m_stateCache.BindTexture(1, m_maskTexture);
+  m_stateCache.BindTexture(2, sceneTexture);
+
+  // First axis, mask is applied once at the end
+  m_stateCache.BindFramebuffer(context.GetFramebuffer({ firstAxis }));
+  glBindBufferRange(GL_UNIFORM_BUFFER, BlurKernelBinding, m_blurKernelUBO, 0, BlurKernelBlockSize);
+  m_blurKernelShader.setUniform(m_blurKernelUniforms.direction, firstDirection);
+  m_blurKernelShader.setUniform(m_blurKernelUniforms.tapsCount, static_cast<int>(m_blurKernelTapsCount[0]));
+  m_blurKernelShader.setUniform(m_blurKernelUniforms.applyMask, false);
+  m_stateCache.BindTexture(0, sceneTexture);
   glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
 
-  // model
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(1.4f, -1.0f, 0.3f));
-  model = glm::scale(model, glm::vec3(0.4f, 0.4f, 0.4f));
-  m_sceneShader.setUniform("model", model);
-  m_model.Draw(m_sceneShader);
+  // Second axis, mixed with the sharp scene by mask
+  m_stateCache.BindFramebuffer(context.GetFramebuffer({ blurred }));
+  glBindBufferRange(GL_UNIFORM_BUFFER, BlurKernelBinding, m_blurKernelUBO, BlurKernelBlockSize, BlurKernelBlockSize);
+  m_blurKernelShader.setUniform(m_blurKernelUniforms.direction, secondDirection);
+  m_blurKernelShader.setUniform(m_blurKernelUniforms.tapsCount, static_cast<int>(m_blurKernelTapsCount[1]));
+  m_blurKernelShader.setUniform(m_blurKernelUniforms.applyMask, true);
+  m_stateCache.BindTexture(0, context.GetTexture(firstAxis));
+  glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
 
-  // Light source
-  m_lightSourceShader.use();
+  glBindBufferBase(GL_UNIFORM_BUFFER, BlurKernelBinding, 0);
+}
 
-  model = glm::mat4(1.0f);
-  m_lightPosition.z = 1.5 + sin(Utility::seconds_now() / 1.0) * 4.0f;
-  model = glm::translate(model, m_lightPosition);
-  model = glm::scale(model, glm::vec3(0.2f));
+RenderGraph::Handle GLRenderer::AddDualKawaseBlurPasses(RenderGraph::Handle sceneColor)
+{
+  const auto getLevelDesc = [this](u32 level) {
+    const u32 width = std::max(m_renderWidth >> (level + 1), 1u);
+    const u32 height = std::max(m_renderHeight >> (level + 1), 1u);
+    return RenderGraph::TextureDesc{ width, height, RenderTargetFormat };
+  };
 
-  m_lightSourceShader.setUniform("model", model);
-  m_lightSourceShader.setUniform("projection", projection);
-  m_lightSourceShader.setUniform("view", view);
+  // Every level is a pass of its own, so a level of the way up reuses the texture of the way down once that's read
+  RenderGraph::Handle input = sceneColor;
+  for (u32 level = 0; level < m_pyramidLevels; ++level)
+  {
+    const std::string name = "KawaseDown" + std::to_string(level);
+    const RenderGraph::Handle output = m_renderGraph.CreateTexture(name, getLevelDesc(level));
+    m_renderGraph.AddPass(
+      name, PostProcessingScope, { input }, { output }, [this, input, output](const RenderGraph::Context &context) {
+        RenderKawasePass(context, m_kawaseDownShader, {}, input, output);
+      });
+    input = output;
+  }
 
-  glBindVertexArray(m_lightSource.VAO);
-  glDrawArrays(GL_TRIANGLES, 0, CubeVerticesAmount);
+  for (u32 level = m_pyramidLevels - 1; level > 0; --level)
+  {
+    const std::string name = "KawaseUp" + std::to_string(level - 1);
+    const RenderGraph::Handle output = m_renderGraph.CreateTexture(name, getLevelDesc(level - 1));
+    m_renderGraph.AddPass(
+      name, PostProcessingScope, { input }, { output }, [this, input, output](const RenderGraph::Context &context) {
+        RenderKawasePass(context, m_kawaseUpShader, m_kawaseUpApplyMask, input, output);
+      });
+    input = output;
+  }
+
+  // Last step goes to full resolution and is mixed with the sharp scene by mask
+  const RenderGraph::Handle blurred =
+    m_renderGraph.CreateTexture("KawaseBlurred", GetRenderTargetDesc(RenderTargetFormat));
+  m_renderGraph.AddPass("KawaseUp",
+    PostProcessingScope,
+    { input, sceneColor },
+    { blurred },
+    [this, input, blurred, sceneColor](const RenderGraph::Context &context) {
+      RenderKawasePass(context, m_kawaseUpShader, m_kawaseUpApplyMask, input, blurred, sceneColor);
+    });
+  return blurred;
 }
 
-void GLRenderer::RenderPostProcessing()
+void GLRenderer::RenderKawasePass(const RenderGraph::Context &context,
+  Shader &shader,
+  Shader::UniformHandle applyMask,
+  RenderGraph::Handle input,
+  RenderGraph::Handle output,
+  RenderGraph::Handle sharp)
 {
-  bool first_iteration = true;
-  m_blurShader.use();
-  m_blurShader.setUniform("samples", 8);
-  m_blurShader.setUniform("sigmaFactor", m_blurSigma);
-  glBindVertexArray(m_quad.VAO);
-  for (size_t i = 0; i < m_blurPasses; i++)
+  const RenderGraph::TextureDesc &desc = context.GetDesc(output);
+  m_stateCache.BindFramebuffer(context.GetFramebuffer({ output }));
+  glViewport(0, 0, desc.width, desc.height);
+  m_stateCache.BindVertexArray(m_quad.VAO);
+  m_stateCache.UseProgram(shader.getDescriptor());
+  // Downsampling has no mask, its handle is invalid and setting it is ignored then
+  shader.setUniform(applyMask, sharp != RenderGraph::InvalidHandle);
+  if (sharp != RenderGraph::InvalidHandle)
   {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_blurFBO[m_horizontal]);
-    m_blurShader.setUniform("horizontal", m_horizontal);
+    m_stateCache.BindTexture(1, m_maskTexture);
+    m_stateCache.BindTexture(2, context.GetTexture(sharp));
+  }
+  m_stateCache.BindTexture(0, context.GetTexture(input));
+  glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, first_iteration ? m_sceneColorBuffer : m_blurColorBuffers[!m_horizontal]);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_maskTexture);
+RenderGraph::Handle GLRenderer::AddComputeSharedBlurPass(RenderGraph::Handle sceneColor)
+{
+  const RenderGraph::TextureDesc desc = GetRenderTargetDesc(RenderTargetFormat);
+  const RenderGraph::Handle firstAxis = m_renderGraph.CreateTexture("ComputeBlurFirstAxis", desc);
+  const RenderGraph::Handle blurred = m_renderGraph.CreateTexture("ComputeBlurred", desc);
+  m_renderGraph.AddPass("ComputeSharedBlur",
+    PostProcessingScope,
+    { sceneColor },
+    { firstAxis, blurred },
+    [this, sceneColor, firstAxis, blurred](const RenderGraph::Context &context) {
+      RenderComputeSharedBlur(context, sceneColor, firstAxis, blurred);
+    });
+  return blurred;
+}
+
+void GLRenderer::RenderComputeSharedBlur(const RenderGraph::Context &context,
+  RenderGraph::Handle sceneColor,
+  RenderGraph::Handle firstAxis,
+  RenderGraph::Handle blurred)
+{
+  // Same axis order as the equivalent kernel blur
+  const std::array<int, 2> axes = { FirstBlurHorizontal ? 1 : 0, FirstBlurHorizontal ? 0 : 1 };
+  const std::array<u32, 2> inputs = { context.GetTexture(sceneColor), context.GetTexture(firstAxis) };
+  const std::array<u32, 2> outputs = { context.GetTexture(firstAxis), context.GetTexture(blurred) };
 
-    glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
+  const Shader &shader = m_computeSharedBlurShader;
+  const ComputeSharedBlurUniforms &uniforms = m_computeSharedBlurUniforms;
+  m_stateCache.UseProgram(m_computeSharedBlurShader.getDescriptor());
+  m_stateCache.BindStorageBuffer(BlurWeightsBinding, m_blurWeightsSSBO);
+  m_stateCache.BindTexture(1, m_maskTexture);
+  m_stateCache.BindTexture(2, inputs[0]);
+  for (size_t pass = 0; pass < axes.size(); ++pass)
+  {
+    const ComputeBlurKernel &kernel = m_computeBlurKernels[pass];
+    const u32 lineSize = axes[pass] == 0 ? m_renderWidth : m_renderHeight;
+    const u32 linesCount = axes[pass] == 0 ? m_renderHeight : m_renderWidth;
 
-    m_horizontal = !m_horizontal;
-    if (first_iteration)
-      first_iteration = false;
+    shader.setUniform(uniforms.axis, axes[pass]);
+    shader.setUniform(uniforms.weightsOffset, static_cast<int>(MaxComputeBlurWeights * pass));
+    shader.setUniform(uniforms.weightsCount, static_cast<int>(kernel.weightsCount));
+    shader.setUniform(uniforms.first, static_cast<int>(kernel.first));
+    shader.setUniform(uniforms.applyMask, pass + 1 == axes.size());
+    m_stateCache.BindTexture(0, inputs[pass]);
+    glBindImageTexture(0, outputs[pass], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    glDispatchCompute((lineSize + ComputeBlurGroupSize - 1) / ComputeBlurGroupSize, linesCount, 1);
+    // The next pass and compose sample what was stored
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
   }
-  glBindVertexArray(0);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+RenderGraph::Handle GLRenderer::AddComputeRunningSumBlurPass(RenderGraph::Handle sceneColor)
+{
+  const RenderGraph::TextureDesc desc = GetRenderTargetDesc(RenderTargetFormat);
+  // Boxes between the first and the last one go to fp16 images padded with what the next boxes read past the
+  // edges, so the cascade sees the scene clamped once like the single kernel does
+  const int32_t padding = std::max(GetBoxesReach(m_blurBoxes[0]), GetBoxesReach(m_blurBoxes[1]));
+  const u32 paddedBorders = static_cast<u32>(2 * padding);
+  const RenderGraph::TextureDesc paddedDesc{
+    desc.width + paddedBorders, desc.height + paddedBorders, RunningSumIntermediateFormat
+  };
+  const std::array<RenderGraph::Handle, 2> intermediates = {
+    m_renderGraph.CreateTexture("RunningSumPing", paddedDesc), m_renderGraph.CreateTexture("RunningSumPong", paddedDesc)
+  };
+  const RenderGraph::Handle blurred = m_renderGraph.CreateTexture("RunningSumBlurred", desc);
+  m_renderGraph.AddPass("ComputeRunningSumBlur",
+    PostProcessingScope,
+    { sceneColor },
+    { intermediates[0], intermediates[1], blurred },
+    [this, sceneColor, intermediates, blurred, padding](const RenderGraph::Context &context) {
+      RenderComputeRunningSumBlur(context, sceneColor, intermediates, blurred, padding);
+    });
+  return blurred;
+}
+
+void GLRenderer::RenderComputeRunningSumBlur(const RenderGraph::Context &context,
+  RenderGraph::Handle sceneColor,
+  const std::array<RenderGraph::Handle, 2> &intermediates,
+  RenderGraph::Handle blurred,
+  int32_t padding)
+{
+  const std::array<int, 2> axes = { FirstBlurHorizontal ? 1 : 0, FirstBlurHorizontal ? 0 : 1 };
+  const size_t passesCount = m_blurBoxes[0].size() + m_blurBoxes[1].size();
+  const u32 sceneTexture = context.GetTexture(sceneColor);
+
+  const Shader &shader = m_runningSumBlurShader;
+  const RunningSumBlurUniforms &uniforms = m_runningSumBlurUniforms;
+  m_stateCache.UseProgram(m_runningSumBlurShader.getDescriptor());
+  m_stateCache.BindTexture(1, m_maskTexture);
+  m_stateCache.BindTexture(2, sceneTexture);
+  // Boxes ping-pong between the intermediates, the first one reads the scene and the last one writes blurred
+  u32 input = sceneTexture;
+  int32_t inputPadding = 0;
+  size_t pass = 0;
+  for (size_t axis = 0; axis < axes.size(); ++axis)
+  {
+    const bool horizontal = axes[axis] == 0;
+    shader.setUniform(uniforms.axis, axes[axis]);
+    shader.setUniform(uniforms.lineSize, static_cast<int>(horizontal ? m_renderWidth : m_renderHeight));
+    shader.setUniform(uniforms.linesCount, static_cast<int>(horizontal ? m_renderHeight : m_renderWidth));
+    // The previous axis was only stored inside the lines, past them the first box clamps
+    int32_t inputExtent = 0;
+    int32_t extent = GetBoxesReach(m_blurBoxes[axis]);
+    for (const BlurKernel::Box &box : m_blurBoxes[axis])
+    {
+      extent -= GetBoxReach(box);
+      const bool last = ++pass == passesCount;
+      const int32_t outputPadding = last ? 0 : padding;
+      const u32 output = context.GetTexture(last ? blurred : intermediates[pass % intermediates.size()]);
+      shader.setUniform(uniforms.radius, box.radius);
+      shader.setUniform(uniforms.offset, box.offset);
+      shader.setUniform(uniforms.inputPadding, inputPadding);
+      shader.setUniform(uniforms.outputPadding, outputPadding);
+      shader.setUniform(uniforms.inputExtent, inputExtent);
+      shader.setUniform(uniforms.outputExtent, extent);
+      shader.setUniform(uniforms.applyMask, last);
+      m_stateCache.BindTexture(0, input);
+      glBindImageTexture(
+        0, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, last ? RenderTargetFormat : RunningSumIntermediateFormat);
+      const u32 linesCount = horizontal ? m_renderHeight : m_renderWidth;
+      glDispatchCompute((linesCount + ComputeBlurLinesPerGroup - 1) / ComputeBlurLinesPerGroup, 1, 1);
+      glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+      input = output;
+      inputPadding = outputPadding;
+      inputExtent = extent;
+    }
+  }
+}
+
+void GLRenderer::UpdateBlurKernel()
+{
+  if (m_blurKernelSigma == m_blurSigma && m_blurKernelPasses == m_blurPasses)
+    return;
+
+  // blur.frag passes alternate between axes, so every axis gets its half of them convolved into one kernel
+  const BlurKernel::Kernel passKernel = BlurKernel::BuildPassKernel(BlurSamples, m_blurSigma);
+  const std::array<u32, 2> axisPasses = { (m_blurPasses + 1) / 2, m_blurPasses / 2 };
+
+  glBindBuffer(GL_UNIFORM_BUFFER, m_blurKernelUBO);
+  for (size_t axis = 0; axis < axisPasses.size(); ++axis)
+  {
+    const BlurKernel::Kernel kernel = BlurKernel::Compose(passKernel, axisPasses[axis]);
+    const std::vector<BlurKernel::LinearTap> taps = BlurKernel::BuildLinearTaps(kernel, MaxBlurKernelTaps);
+
+    std::vector<glm::vec4> block;
+    block.reserve(taps.size());
+    for (const BlurKernel::LinearTap &tap : taps)
+      block.emplace_back(tap.offset, tap.weight, 0.0f, 0.0f);
+
+    glBufferSubData(GL_UNIFORM_BUFFER, BlurKernelBlockSize * axis, block.size() * sizeof(glm::vec4), block.data());
+    m_blurKernelTapsCount[axis] = static_cast<u32>(taps.size());
+
+    // Compute blur reads texels exactly, so it gets the discrete kernel rather than bilinear taps
+    const BlurKernel::Kernel trimmed = BlurKernel::BuildTrimmedKernel(kernel, MaxComputeBlurWeights);
+    glNamedBufferSubData(m_blurWeightsSSBO,
+      MaxComputeBlurWeights * axis * sizeof(float),
+      trimmed.weights.size() * sizeof(float),
+      trimmed.weights.data());
+    m_computeBlurKernels[axis] = { trimmed.first, static_cast<u32>(trimmed.weights.size()) };
+    m_blurBoxes[axis] = BlurKernel::BuildBoxes(kernel, RunningSumBoxes);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  // Every dual Kawase level roughly doubles the blur radius, the first one blurs by about a texel
+  const float sigma = BlurKernel::GetStandardDeviation(passKernel) * std::sqrt(static_cast<float>(axisPasses[0]));
+  const u32 levels = static_cast<u32>(std::lround(std::log2(std::max(sigma, 1.0f))));
+  m_pyramidLevels = std::clamp(levels, 1u, MaxPyramidLevels);
+
+  m_blurKernelSigma = m_blurSigma;
+  m_blurKernelPasses = m_blurPasses;
+}
+
+CpuBlur::Settings GLRenderer::GetBlurSettings() const
+{
+  CpuBlur::Settings settings;
+  settings.passes = m_blurPasses;
+  settings.samples = BlurSamples;
+  settings.sigmaFactor = m_blurSigma;
+  settings.horizontal = FirstBlurHorizontal;
+  return settings;
 }
 
 void GLRenderer::Render()
 {
-  ClearFrame();
+  m_profiler.BeginFrame();
+  AdvanceAnimationClock();
+  {
+    GpuProfiler::Scope scope(m_profiler, "TextureUpload");
+    m_assets.Update();
+    m_textureLoader.Update();
+    // Post-processing samples the mask every frame
+    m_assets.Touch(m_maskTexture);
+  }
+  // Levels coming in and evicted textures change how the scene looks
+  if (m_assets.GetChangesCount() != m_assetChanges)
+  {
+    m_assetChanges = m_assets.GetChangesCount();
+    MarkSceneChanged();
+  }
 
-  RenderBackground();
-  RenderScene();
-  RenderPostProcessing();
+  // Frame times collected so far decide the render size of this frame, frames reusing the last image say little
+  if (m_sceneVersion != m_renderedSceneVersion)
+    UpdateFrameBudget();
 
-  // Composing everything into default framebuffer for presentation
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  // Scene goes straight to the output when there is nothing to post-process or upscale, there is no image to reuse
+  const bool blur = m_postProcessingBlur && m_blurPasses > 0;
+  const bool upscale = m_renderWidth != m_width || m_renderHeight != m_height;
+  const bool direct = !blur && !upscale;
+  const bool renderScene = m_sceneVersion != m_renderedSceneVersion || direct || m_sceneColorBuffer == 0;
+  const bool postProcess = renderScene || m_postProcessingDirty || m_composeImage == 0;
+  // Uploads and the chessboard bind on their own, everything else in the frame goes through the cache
+  m_stateCache.Invalidate();
+  m_stateCache.ResetStatistics();
+
+  if (renderScene)
+  {
+    GpuProfiler::Scope scope(m_profiler, "RenderQueue");
+    BuildRenderQueue();
+  }
+
+  m_renderGraph.Reset();
+  const RenderGraph::Handle output = m_renderGraph.ImportFramebuffer("Output", m_outputFBO, m_width, m_height);
+  if (direct)
+  {
+    AddScenePasses(output, RenderGraph::InvalidHandle);
+    m_composeImage = 0;
+  }
+  else
+  {
+    RenderGraph::Handle sceneColor = RenderGraph::InvalidHandle;
+    if (renderScene)
+    {
+      sceneColor = m_renderGraph.CreateTexture("SceneColor", GetRenderTargetDesc(RenderTargetFormat));
+      const RenderGraph::Handle sceneDepth =
+        m_renderGraph.CreateTexture("SceneDepth", GetRenderTargetDesc(DepthTargetFormat));
+      AddScenePasses(sceneColor, sceneDepth);
+    }
+    else
+    {
+      // Imported, last frame's scene is kept in the pool even if nothing reads it
+      sceneColor =
+        m_renderGraph.ImportTexture("SceneColor", m_sceneColorBuffer, GetRenderTargetDesc(RenderTargetFormat));
+    }
+
+    if (postProcess)
+    {
+      // Switched off blur is still declared, the graph culls it as compose doesn't read it
+      const RenderGraph::Handle blurred = m_blurPasses > 0 ? AddPostProcessingPasses(sceneColor) : sceneColor;
+      AddComposePass(m_postProcessingBlur ? blurred : sceneColor, output);
+    }
+    else
+    {
+      // Nothing compose reads changed, the last image is presented again
+      const RenderGraph::Handle composeImage =
+        m_renderGraph.ImportTexture("ComposeImage", m_composeImage, GetRenderTargetDesc(RenderTargetFormat));
+      AddComposePass(composeImage, output);
+    }
+  }
+  m_renderGraph.Execute(&m_profiler);
+  m_profiler.EndFrame();
+
+  ++m_frameStatistics.frames;
+  m_frameStatistics.sceneFrames += renderScene ? 1 : 0;
+  m_frameStatistics.postProcessingFrames += postProcess ? 1 : 0;
+  m_postProcessingDirty = false;
+  m_outputDirty = false;
+}
+
+void GLRenderer::RepeatPostProcessing(BlurMode mode)
+{
+  // Scene went straight to the output last frame, there is nothing to post-process
+  if (m_sceneColorBuffer == 0 || m_blurPasses == 0)
+    return;
+
+  const BlurMode selectedMode = m_blurMode;
+  m_blurMode = mode;
+  m_stateCache.Invalidate();
+  m_renderGraph.Reset();
+  const RenderGraph::Handle output = m_renderGraph.ImportFramebuffer("Output", m_outputFBO, m_width, m_height);
+  const RenderGraph::Handle sceneColor =
+    m_renderGraph.ImportTexture("SceneColor", m_sceneColorBuffer, GetRenderTargetDesc(RenderTargetFormat));
+  AddComposePass(AddPostProcessingPasses(sceneColor), output);
+  m_renderGraph.Execute(nullptr);
+  m_blurMode = selectedMode;
+  // Composed image is the other mode's one now
+  m_postProcessingDirty = true;
+}
+
+void GLRenderer::RenderCompose(u32 image, u32 framebuffer)
+{
+  // Composing everything into output framebuffer for presentation, upscaled from the render size
+  m_stateCache.BindFramebuffer(framebuffer);
+  glViewport(0, 0, m_width, m_height);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  m_composeShader.use();
-  glBindTexture(GL_TEXTURE_2D, m_blurColorBuffers[!m_horizontal]);
-  glBindVertexArray(m_quad.VAO);
+  m_stateCache.UseProgram(m_composeShader.getDescriptor());
+  m_stateCache.BindTexture(0, image);
+  m_stateCache.BindVertexArray(m_quad.VAO);
   glDrawArrays(GL_TRIANGLES, 0, PlaneVerticesAmount);
-  glBindVertexArray(0);
 }
 
 GLRenderer::~GLRenderer()
 {
-  glDeleteVertexArrays(1, &m_cube.VAO);
-  glDeleteVertexArrays(1, &m_plane.VAO);
   glDeleteVertexArrays(1, &m_quad.VAO);
-  glDeleteVertexArrays(1, &m_lightSource.VAO);
-  glDeleteBuffers(1, &m_cube.VBO);
-  glDeleteBuffers(1, &m_plane.VBO);
   glDeleteBuffers(1, &m_quad.VBO);
-  glDeleteBuffers(1, &m_lightSource.VBO);
+  glDeleteBuffers(1, &m_blurKernelUBO);
+  glDeleteBuffers(1, &m_blurWeightsSSBO);
+  glDeleteFramebuffers(1, &m_chessboardFBO);
+  glDeleteTextures(1, &m_chessboardTexture);
+  glDeleteVertexArrays(1, &m_tileVAO);
+  glDeleteBuffers(1, &m_tileVBO);
 }
 
 void GLRenderer::OnKeyDown(u32 key)
@@ -303,38 +1254,84 @@ void GLRenderer::OnKeyDown(u32 key)
   {
   case 'W': {
     m_camera.ProcessKeyboard(CameraMove::Forward, CameraMoveDelta);
+    MarkSceneChanged();
   }
   break;
   case 'A': {
     m_camera.ProcessKeyboard(CameraMove::Left, CameraMoveDelta);
+    MarkSceneChanged();
   }
   break;
   case 'S': {
     m_camera.ProcessKeyboard(CameraMove::Backward, CameraMoveDelta);
+    MarkSceneChanged();
   }
   break;
   case 'D': {
     m_camera.ProcessKeyboard(CameraMove::Right, CameraMoveDelta);
+    MarkSceneChanged();
   }
   break;
 
   case '1': {
-    m_blurPasses -= BlurPassesDelta;
+    m_blurPasses = m_blurPasses > BlurPassesDelta ? m_blurPasses - BlurPassesDelta : 0;
+    m_postProcessingDirty = true;
   }
   break;
 
   case '2': {
-    m_blurPasses += BlurPassesDelta;
+    m_blurPasses = std::min(m_blurPasses + BlurPassesDelta, MaxBlurPasses);
+    m_postProcessingDirty = true;
   }
   break;
 
   case '3': {
-    m_blurSigma -= BlurSigmaDelta;
+    m_blurSigma = std::clamp(m_blurSigma - BlurSigmaDelta, MinBlurSigma, MaxBlurSigma);
+    m_postProcessingDirty = true;
   }
   break;
 
   case '4': {
-    m_blurSigma += BlurSigmaDelta;
+    m_blurSigma = std::clamp(m_blurSigma + BlurSigmaDelta, MinBlurSigma, MaxBlurSigma);
+    m_postProcessingDirty = true;
+  }
+  break;
+
+  case 'T': {
+    m_tiledBlur = !m_tiledBlur;
+    m_postProcessingDirty = true;
+  }
+  break;
+
+  case 'O': {
+    m_postProcessingBlur = !m_postProcessingBlur;
+    m_postProcessingDirty = true;
+  }
+  break;
+
+  case 'P': {
+    Utility::DebugOutput(m_profiler.GetReport());
+  }
+  break;
+
+  case 'F': {
+    // Interactive budget only lowers the render scale, the blur mode stays the selected one
+    const bool enabled = !m_frameBudget.IsEnabled();
+    SetFrameTimeTarget(enabled ? FrameBudgetTargetMs : 0.0);
+    Utility::DebugOutput(std::string("Frame budget: ") + (enabled ? "on" : "off") + "\n");
+  }
+  break;
+
+  case ' ': {
+    m_animationPaused = !m_animationPaused;
+  }
+  break;
+
+  case 'B': {
+    m_blurMode = static_cast<BlurMode>((static_cast<u32>(m_blurMode) + 1) % static_cast<u32>(BlurMode::Count));
+    Utility::DebugOutput(std::string("Blur mode: ") + GetBlurModeName(m_blurMode) + ", running "
+                         + GetBlurModeName(GetEffectiveBlurMode()) + "\n");
+    m_postProcessingDirty = true;
   }
   break;
   }
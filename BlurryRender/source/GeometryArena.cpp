@@ -0,0 +1,201 @@
+#include "GeometryArena.hpp"
+#include "mesh.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+constexpr size_t InitialVertexCapacity = 64 * 1024;
+constexpr size_t InitialIndexCapacity = 256 * 1024;
+constexpr uint32_t VertexBufferBinding = 0;
+constexpr uint32_t DrawIdBufferBinding = 1;
+
+// New buffer of newSize bytes with the first usedSize bytes of the old one, which is deleted
+uint32_t GrowBuffer(uint32_t buffer, size_t usedSize, size_t newSize)
+{
+  uint32_t grown{};
+  glCreateBuffers(1, &grown);
+  glNamedBufferStorage(grown, newSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  if (buffer != 0)
+  {
+    if (usedSize > 0)
+      glCopyNamedBufferSubData(buffer, grown, 0, 0, usedSize);
+    glDeleteBuffers(1, &buffer);
+  }
+  return grown;
+}
+}// namespace
+
+GeometryArena::~GeometryArena() { Release(); }
+
+void GeometryArena::Release()
+{
+  for (Pool &pool : m_pools)
+  {
+    glDeleteVertexArrays(1, &pool.vao);
+    glDeleteBuffers(1, &pool.vertexBuffer);
+    glDeleteBuffers(1, &pool.indexBuffer);
+  }
+  m_pools.clear();
+
+  if (m_drawIdBuffer != 0)
+    glDeleteBuffers(1, &m_drawIdBuffer);
+  m_drawIdBuffer = 0;
+  m_drawIdsCount = 0;
+}
+
+GeometryArena::Allocation GeometryArena::Allocate(VertexFormat format,
+  const void *vertices,
+  size_t vertexCount,
+  const unsigned int *indices,
+  size_t indexCount)
+{
+  const GLenum indexType = Mesh::indexSize(vertexCount) == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  const u32 poolIndex = GetPool(format, indexType);
+  Pool &pool = m_pools[poolIndex];
+  Reserve(pool, pool.vertexCount + vertexCount, pool.indexCount + indexCount);
+
+  Allocation allocation;
+  allocation.pool = poolIndex;
+  allocation.indexCount = static_cast<u32>(indexCount);
+  allocation.firstIndex = static_cast<u32>(pool.indexCount);
+  allocation.baseVertex = static_cast<int32_t>(pool.vertexCount);
+
+  glNamedBufferSubData(pool.vertexBuffer, pool.vertexCount * pool.vertexSize, vertexCount * pool.vertexSize, vertices);
+  if (indexType == GL_UNSIGNED_SHORT)
+  {
+    const std::vector<uint16_t> narrowIndices(indices, indices + indexCount);
+    glNamedBufferSubData(
+      pool.indexBuffer, pool.indexCount * sizeof(uint16_t), indexCount * sizeof(uint16_t), narrowIndices.data());
+  }
+  else
+    glNamedBufferSubData(pool.indexBuffer, pool.indexCount * sizeof(uint32_t), indexCount * sizeof(uint32_t), indices);
+
+  pool.vertexCount += vertexCount;
+  pool.indexCount += indexCount;
+  return allocation;
+}
+
+size_t GeometryArena::GetUsedSize() const
+{
+  size_t size = 0;
+  for (const Pool &pool : m_pools)
+    size += pool.vertexCount * pool.vertexSize + pool.indexCount * GetIndexTypeSize(pool.indexType);
+  return size;
+}
+
+void GeometryArena::Draw(const Allocation &allocation) const
+{
+  glBindVertexArray(GetVAO(allocation.pool));
+  glDrawElementsBaseVertex(GL_TRIANGLES,
+    allocation.indexCount,
+    GetIndexType(allocation.pool),
+    reinterpret_cast<void *>(allocation.firstIndex * GetIndexSize(allocation.pool)),
+    allocation.baseVertex);
+}
+
+void GeometryArena::ReserveDrawIds(u32 count)
+{
+  if (count <= m_drawIdsCount)
+    return;
+
+  // Ids are immutable, so the buffer is simply replaced by a bigger one
+  u32 newCount = std::max(m_drawIdsCount, InitialDrawIds);
+  while (newCount < count)
+    newCount *= 2;
+
+  std::vector<u32> drawIds(newCount);
+  std::iota(drawIds.begin(), drawIds.end(), 0u);
+  if (m_drawIdBuffer != 0)
+    glDeleteBuffers(1, &m_drawIdBuffer);
+  glCreateBuffers(1, &m_drawIdBuffer);
+  glNamedBufferStorage(m_drawIdBuffer, drawIds.size() * sizeof(u32), drawIds.data(), 0);
+  m_drawIdsCount = newCount;
+
+  for (const Pool &pool : m_pools)
+    BindDrawIds(pool);
+}
+
+void GeometryArena::BindDrawIds(const Pool &pool) const
+{
+  glVertexArrayVertexBuffer(pool.vao, DrawIdBufferBinding, m_drawIdBuffer, 0, sizeof(u32));
+}
+
+GeometryArena::u32 GeometryArena::GetPool(VertexFormat format, GLenum indexType)
+{
+  const auto found = std::find_if(m_pools.begin(), m_pools.end(), [format, indexType](const Pool &pool) {
+    return pool.format == format && pool.indexType == indexType;
+  });
+  if (found != m_pools.end())
+    return static_cast<u32>(found - m_pools.begin());
+
+  ReserveDrawIds(InitialDrawIds);
+
+  Pool pool;
+  pool.format = format;
+  pool.indexType = indexType;
+  pool.vertexSize = format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+  glCreateVertexArrays(1, &pool.vao);
+  SetupVertexFormat(pool.vao, format);
+
+  glEnableVertexArrayAttrib(pool.vao, DrawIdAttribute);
+  glVertexArrayAttribIFormat(pool.vao, DrawIdAttribute, 1, GL_UNSIGNED_INT, 0);
+  glVertexArrayAttribBinding(pool.vao, DrawIdAttribute, DrawIdBufferBinding);
+  glVertexArrayBindingDivisor(pool.vao, DrawIdBufferBinding, 1);
+  BindDrawIds(pool);
+
+  m_pools.push_back(pool);
+  return static_cast<u32>(m_pools.size() - 1);
+}
+
+void GeometryArena::Reserve(Pool &pool, size_t vertexCount, size_t indexCount)
+{
+  const size_t indexSize = GetIndexTypeSize(pool.indexType);
+  if (vertexCount > pool.vertexCapacity)
+  {
+    size_t capacity = std::max(pool.vertexCapacity, InitialVertexCapacity);
+    while (capacity < vertexCount)
+      capacity *= 2;
+    pool.vertexBuffer =
+      GrowBuffer(pool.vertexBuffer, pool.vertexCount * pool.vertexSize, capacity * pool.vertexSize);
+    pool.vertexCapacity = capacity;
+    glVertexArrayVertexBuffer(
+      pool.vao, VertexBufferBinding, pool.vertexBuffer, 0, static_cast<GLsizei>(pool.vertexSize));
+  }
+  if (indexCount > pool.indexCapacity)
+  {
+    size_t capacity = std::max(pool.indexCapacity, InitialIndexCapacity);
+    while (capacity < indexCount)
+      capacity *= 2;
+    pool.indexBuffer = GrowBuffer(pool.indexBuffer, pool.indexCount * indexSize, capacity * indexSize);
+    pool.indexCapacity = capacity;
+    glVertexArrayElementBuffer(pool.vao, pool.indexBuffer);
+  }
+}
+
+void GeometryArena::SetupVertexFormat(u32 vao, VertexFormat format)
+{
+  const auto setAttribute = [vao](u32 attribute, GLint size, GLenum type, GLboolean normalized, size_t offset) {
+    glEnableVertexArrayAttrib(vao, attribute);
+    glVertexArrayAttribFormat(vao, attribute, size, type, normalized, static_cast<GLuint>(offset));
+    glVertexArrayAttribBinding(vao, attribute, VertexBufferBinding);
+  };
+
+  // Same attributes as Mesh sets up for its own buffers
+  if (format == VertexFormat::Packed)
+  {
+    setAttribute(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, Position));
+    setAttribute(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, Normal));
+    setAttribute(2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, TexCoords));
+    setAttribute(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, Tangent));
+  }
+  else
+  {
+    setAttribute(0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
+    setAttribute(1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
+    setAttribute(2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords));
+    setAttribute(3, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Tangent));
+    setAttribute(4, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Bitangent));
+  }
+}
@@ -0,0 +1,187 @@
+#include "GpuProfiler.hpp"
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+constexpr double NanosecondsInMillisecond = 1e6;
+
+GpuProfiler::Statistics ComputeStatistics(const std::deque<double> &samples)
+{
+  GpuProfiler::Statistics statistics;
+  if (samples.empty())
+    return statistics;
+
+  std::vector<double> sorted(samples.begin(), samples.end());
+  std::sort(sorted.begin(), sorted.end());
+
+  double sum = 0.0;
+  for (double sample : sorted)
+    sum += sample;
+
+  statistics.min = sorted.front();
+  statistics.average = sum / sorted.size();
+  // Nearest-rank percentile
+  const size_t p99Rank = (sorted.size() * 99 + 99) / 100;
+  statistics.p99 = sorted[std::max<size_t>(p99Rank, 1) - 1];
+  return statistics;
+}
+
+void PushSample(std::deque<double> &samples, double sample)
+{
+  samples.push_back(sample);
+  if (samples.size() > GpuProfiler::HistorySize)
+    samples.pop_front();
+}
+}// namespace
+
+GpuProfiler::~GpuProfiler()
+{
+  for (FrameQueries &frame : m_frames)
+  {
+    if (!frame.queries.empty())
+      glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+  }
+}
+
+void GpuProfiler::BeginFrame()
+{
+  // The slot was filled FramesInFlight frames ago
+  FrameQueries &frame = m_frames[m_frameIndex % FramesInFlight];
+  CollectFrame(frame);
+  frame.passes.clear();
+  frame.usedQueries = 0;
+}
+
+void GpuProfiler::EndFrame()
+{
+  W_CHECK(!m_inPass);
+  ++m_frameIndex;
+}
+
+void GpuProfiler::BeginPass(const char *name)
+{
+  W_CHECK(!m_inPass);
+  m_inPass = true;
+  m_passStart = Clock::now();
+
+  m_currentPass.pass = FindPass(name);
+  m_currentPass.beginQuery = AcquireQuery();
+  m_currentPass.endQuery = AcquireQuery();
+  glQueryCounter(m_currentPass.beginQuery, GL_TIMESTAMP);
+}
+
+void GpuProfiler::EndPass()
+{
+  W_CHECK(m_inPass);
+  glQueryCounter(m_currentPass.endQuery, GL_TIMESTAMP);
+  if (m_flushPerPass)
+    glFlush();
+  m_currentPass.cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - m_passStart).count();
+
+  m_frames[m_frameIndex % FramesInFlight].passes.push_back(m_currentPass);
+  m_inPass = false;
+}
+
+GpuProfiler::u32 GpuProfiler::AcquireQuery()
+{
+  FrameQueries &frame = m_frames[m_frameIndex % FramesInFlight];
+  if (frame.usedQueries == frame.queries.size())
+  {
+    u32 query{};
+    glGenQueries(1, &query);
+    frame.queries.push_back(query);
+  }
+  return frame.queries[frame.usedQueries++];
+}
+
+size_t GpuProfiler::FindPass(const char *name)
+{
+  const auto found = std::find_if(
+    m_passes.begin(), m_passes.end(), [name](const PassHistory &pass) { return pass.name == name; });
+  if (found != m_passes.end())
+    return static_cast<size_t>(found - m_passes.begin());
+
+  m_passes.push_back({ name, {}, {} });
+  return m_passes.size() - 1;
+}
+
+void GpuProfiler::CollectFrame(FrameQueries &frame)
+{
+  if (frame.passes.empty())
+    return;
+
+  // Queries complete in order, so the last one being available means the whole frame is
+  GLint available{};
+  glGetQueryObjectiv(frame.passes.back().endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+  {
+    ++m_droppedFrames;
+    return;
+  }
+
+  double frameGpuMs = 0.0;
+  for (const PendingPass &pass : frame.passes)
+  {
+    GLuint64 begin{}, end{};
+    glGetQueryObjectui64v(pass.beginQuery, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(pass.endQuery, GL_QUERY_RESULT, &end);
+
+    const double gpuMs = static_cast<double>(end - begin) / NanosecondsInMillisecond;
+    PassHistory &history = m_passes[pass.pass];
+    PushSample(history.gpuMs, gpuMs);
+    PushSample(history.cpuMs, pass.cpuMs);
+    frameGpuMs += gpuMs;
+  }
+  m_lastFrameGpuMs = frameGpuMs;
+  ++m_collectedFrames;
+}
+
+std::vector<GpuProfiler::PassStatistics> GpuProfiler::GetStatistics() const
+{
+  std::vector<PassStatistics> statistics;
+  statistics.reserve(m_passes.size());
+  for (const PassHistory &pass : m_passes)
+  {
+    statistics.push_back(
+      { pass.name, pass.gpuMs.size(), ComputeStatistics(pass.gpuMs), ComputeStatistics(pass.cpuMs) });
+  }
+  return statistics;
+}
+
+std::string GpuProfiler::GetReport() const
+{
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(3);
+  report << std::left << std::setw(16) << "pass" << std::right << std::setw(10) << "gpu min" << std::setw(10)
+         << "gpu avg" << std::setw(10) << "gpu p99" << std::setw(10) << "cpu avg" << std::setw(10) << "cpu p99"
+         << '\n';
+  for (const PassStatistics &pass : GetStatistics())
+  {
+    report << std::left << std::setw(16) << pass.name << std::right << std::setw(10) << pass.gpuMs.min
+           << std::setw(10) << pass.gpuMs.average << std::setw(10) << pass.gpuMs.p99 << std::setw(10)
+           << pass.cpuMs.average << std::setw(10) << pass.cpuMs.p99 << '\n';
+  }
+  if (m_droppedFrames > 0)
+    report << "frames dropped as not ready: " << m_droppedFrames << '\n';
+  return report.str();
+}
+
+bool GpuProfiler::DumpCSV(const std::string &path) const
+{
+  std::ofstream file(path);
+  if (!file)
+    return false;
+
+  file << "pass,samples,gpu_min_ms,gpu_avg_ms,gpu_p99_ms,cpu_min_ms,cpu_avg_ms,cpu_p99_ms\n";
+  for (const PassStatistics &pass : GetStatistics())
+  {
+    file << pass.name << ',' << pass.samples << ',' << pass.gpuMs.min << ',' << pass.gpuMs.average << ','
+         << pass.gpuMs.p99 << ',' << pass.cpuMs.min << ',' << pass.cpuMs.average << ',' << pass.cpuMs.p99 << '\n';
+  }
+  return static_cast<bool>(file);
+}
@@ -0,0 +1,205 @@
+#include "HeadlessContext.hpp"
+#include <glad/glad.h>
+
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+constexpr EGLint RequiredGLMajorVersion = 4;
+constexpr EGLint RequiredGLMinorVersion = 5;
+
+bool HasExtension(const char *extensions, const char *name)
+{
+  if (!extensions)
+    return false;
+
+  const size_t nameLength = std::strlen(name);
+  for (const char *found = std::strstr(extensions, name); found; found = std::strstr(found + nameLength, name))
+  {
+    const bool startsToken = found == extensions || found[-1] == ' ';
+    const bool endsToken = found[nameLength] == ' ' || found[nameLength] == '\0';
+    if (startsToken && endsToken)
+      return true;
+  }
+  return false;
+}
+
+EGLDisplay GetSurfacelessDisplay()
+{
+  const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+  {
+    auto getPlatformDisplay =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay)
+      return getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  }
+
+  // Falling back to default display, it's still fine as long as it supports surfaceless contexts
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+}// namespace
+
+HeadlessContext::~HeadlessContext()
+{
+  Release();
+}
+
+bool HeadlessContext::Initialize(u32 width, u32 height)
+{
+  m_width = width;
+  m_height = height;
+
+  if (!CreateContext())
+  {
+    Release();
+    return false;
+  }
+
+  if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)))
+  {
+    std::cerr << "Failed to load GLAD OpenGL functions\n";
+    Release();
+    return false;
+  }
+
+  CreateFramebuffer();
+  return true;
+}
+
+bool HeadlessContext::CreateContext()
+{
+  m_display = GetSurfacelessDisplay();
+  if (m_display == EGL_NO_DISPLAY)
+  {
+    std::cerr << "Failed to get EGL display\n";
+    return false;
+  }
+
+  EGLint major{}, minor{};
+  if (!eglInitialize(m_display, &major, &minor))
+  {
+    std::cerr << "Failed to initialize EGL display\n";
+    m_display = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  if (!HasExtension(eglQueryString(m_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+  {
+    std::cerr << "EGL display doesn't support surfaceless contexts\n";
+    return false;
+  }
+
+  // We never render into EGL surfaces, config is only needed to create the context
+  const EGLint configAttributes[] = { EGL_SURFACE_TYPE,
+    EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE,
+    EGL_OPENGL_BIT,
+    EGL_RED_SIZE,
+    8,
+    EGL_GREEN_SIZE,
+    8,
+    EGL_BLUE_SIZE,
+    8,
+    EGL_NONE };
+  EGLConfig config{};
+  EGLint configsCount{};
+  if (!eglChooseConfig(m_display, configAttributes, &config, 1, &configsCount) || configsCount == 0)
+  {
+    std::cerr << "Failed to choose EGL config\n";
+    return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API))
+  {
+    std::cerr << "Failed to bind OpenGL API\n";
+    return false;
+  }
+
+  const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION,
+    RequiredGLMajorVersion,
+    EGL_CONTEXT_MINOR_VERSION,
+    RequiredGLMinorVersion,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK,
+    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE };
+  m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttributes);
+  if (m_context == EGL_NO_CONTEXT)
+  {
+    std::cerr << "Failed to create OpenGL " << RequiredGLMajorVersion << "." << RequiredGLMinorVersion
+              << " core context\n";
+    return false;
+  }
+
+  if (!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+  {
+    std::cerr << "Failed to make EGL context current\n";
+    return false;
+  }
+
+  return true;
+}
+
+void HeadlessContext::CreateFramebuffer()
+{
+  // There is no default framebuffer in surfaceless context so presentation goes here instead
+  glGenFramebuffers(1, &m_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+  glGenTextures(1, &m_colorBuffer);
+  glBindTexture(GL_TEXTURE_2D, m_colorBuffer);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorBuffer, 0);
+
+  glGenRenderbuffers(1, &m_depthBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cerr << "Error, framebuffer is not complete!\n";
+
+  glViewport(0, 0, m_width, m_height);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+std::vector<uint8_t> HeadlessContext::ReadPixels() const
+{
+  std::vector<uint8_t> pixels(static_cast<size_t>(m_width) * m_height * 3);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  return pixels;
+}
+
+void HeadlessContext::Release()
+{
+  if (m_framebuffer != 0)
+  {
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteTextures(1, &m_colorBuffer);
+    glDeleteRenderbuffers(1, &m_depthBuffer);
+    m_framebuffer = m_colorBuffer = m_depthBuffer = 0;
+  }
+
+  if (m_context != EGL_NO_CONTEXT)
+  {
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(m_display, m_context);
+    m_context = EGL_NO_CONTEXT;
+  }
+
+  if (m_display != EGL_NO_DISPLAY)
+  {
+    eglTerminate(m_display);
+    m_display = EGL_NO_DISPLAY;
+  }
+}
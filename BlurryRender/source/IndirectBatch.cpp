@@ -0,0 +1,184 @@
+#include "IndirectBatch.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+// Buffers are immutable storage, growing means a new buffer; contents are uploaded again right after anyway
+void ReserveBuffer(uint32_t &buffer, size_t &capacity, size_t size)
+{
+  if (size <= capacity && buffer != 0)
+    return;
+
+  capacity = std::max(capacity * 2, size);
+  if (buffer != 0)
+    glDeleteBuffers(1, &buffer);
+  glCreateBuffers(1, &buffer);
+  glNamedBufferStorage(buffer, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
+}// namespace
+
+IndirectBatch::~IndirectBatch() { Release(); }
+
+void IndirectBatch::Initialize(u32 reservedInstances)
+{
+  ReserveBuffer(m_commandBuffer, m_commandCapacity, reservedInstances * sizeof(DrawElementsCommand));
+  ReserveBuffer(m_drawDataBuffer, m_drawDataCapacity, reservedInstances * sizeof(DrawData));
+
+  m_draws.reserve(reservedInstances);
+  m_order.reserve(reservedInstances);
+  m_commands.reserve(reservedInstances);
+  m_drawData.reserve(reservedInstances);
+}
+
+void IndirectBatch::Release()
+{
+  if (m_commandBuffer != 0)
+    glDeleteBuffers(1, &m_commandBuffer);
+  if (m_drawDataBuffer != 0)
+    glDeleteBuffers(1, &m_drawDataBuffer);
+  m_commandBuffer = 0;
+  m_drawDataBuffer = 0;
+  m_commandCapacity = 0;
+  m_drawDataCapacity = 0;
+  Clear();
+}
+
+void IndirectBatch::Clear()
+{
+  m_draws.clear();
+  m_drawData.clear();
+  m_prepared = false;
+  m_uploaded = false;
+}
+
+bool IndirectBatch::Add(const GeometryArena::Allocation &geometry, u32 texture, const DrawData &data)
+{
+  return AddInstances(geometry, texture, &data, 1);
+}
+
+bool IndirectBatch::AddInstances(const GeometryArena::Allocation &geometry,
+  u32 texture,
+  const DrawData *instances,
+  u32 count)
+{
+  if (!geometry.IsValid() || count == 0)
+    return false;
+
+  // Consecutive draws of the same geometry become instances of one command
+  Draw *last = m_draws.empty() ? nullptr : &m_draws.back();
+  if (last && last->texture == texture && last->geometry.pool == geometry.pool
+      && last->geometry.firstIndex == geometry.firstIndex && last->geometry.baseVertex == geometry.baseVertex
+      && last->geometry.indexCount == geometry.indexCount)
+    last->instanceCount += count;
+  else
+    m_draws.push_back({ geometry, texture, static_cast<u32>(m_drawData.size()), count });
+  m_drawData.insert(m_drawData.end(), instances, instances + count);
+  m_prepared = false;
+  m_uploaded = false;
+  return true;
+}
+
+void IndirectBatch::Prepare()
+{
+  if (m_prepared)
+    return;
+
+  // Buckets keep the order draws were added in, instance data stays where it was added
+  m_order.resize(m_draws.size());
+  std::iota(m_order.begin(), m_order.end(), 0u);
+  std::stable_sort(m_order.begin(), m_order.end(), [this](u32 lhs, u32 rhs) {
+    const Draw &left = m_draws[lhs];
+    const Draw &right = m_draws[rhs];
+    return left.geometry.pool != right.geometry.pool ? left.geometry.pool < right.geometry.pool
+                                                     : left.texture < right.texture;
+  });
+
+  m_commands.clear();
+  m_buckets.clear();
+  for (u32 index : m_order)
+  {
+    const Draw &draw = m_draws[index];
+    // baseInstance selects the draw id, and so the DrawData of the first instance
+    m_commands.push_back({ draw.geometry.indexCount,
+      draw.instanceCount,
+      draw.geometry.firstIndex,
+      draw.geometry.baseVertex,
+      draw.firstInstance });
+
+    if (m_buckets.empty() || m_buckets.back().pool != draw.geometry.pool || m_buckets.back().texture != draw.texture)
+      m_buckets.push_back({ draw.geometry.pool, draw.texture, static_cast<u32>(m_commands.size() - 1), 0 });
+    ++m_buckets.back().commandsCount;
+  }
+  m_prepared = true;
+}
+
+void IndirectBatch::Upload(GeometryArena &arena)
+{
+  if (m_uploaded)
+    return;
+
+  Prepare();
+  ReserveBuffer(m_commandBuffer, m_commandCapacity, m_commands.size() * sizeof(DrawElementsCommand));
+  ReserveBuffer(m_drawDataBuffer, m_drawDataCapacity, m_drawData.size() * sizeof(DrawData));
+  glNamedBufferSubData(m_commandBuffer, 0, m_commands.size() * sizeof(DrawElementsCommand), m_commands.data());
+  glNamedBufferSubData(m_drawDataBuffer, 0, m_drawData.size() * sizeof(DrawData), m_drawData.data());
+  arena.ReserveDrawIds(static_cast<u32>(m_drawData.size()));
+  m_uploaded = true;
+}
+
+IndirectBatch::u32 IndirectBatch::Submit(GeometryArena &arena)
+{
+  if (m_draws.empty())
+    return 0;
+
+  Upload(arena);
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, m_drawDataBuffer);
+  glActiveTexture(GL_TEXTURE0);
+
+  for (const Bucket &bucket : m_buckets)
+  {
+    glBindVertexArray(arena.GetVAO(bucket.pool));
+    glBindTexture(GL_TEXTURE_2D, bucket.texture);
+    glMultiDrawElementsIndirect(GL_TRIANGLES,
+      arena.GetIndexType(bucket.pool),
+      reinterpret_cast<void *>(bucket.firstCommand * sizeof(DrawElementsCommand)),
+      static_cast<GLsizei>(bucket.commandsCount),
+      0);
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  return static_cast<u32>(m_buckets.size());
+}
+
+IndirectBatch::u32 IndirectBatch::Enqueue(GeometryArena &arena,
+  RenderQueue &queue,
+  RenderQueue::Pass pass,
+  u32 program)
+{
+  if (m_draws.empty())
+    return 0;
+
+  Upload(arena);
+
+  RenderQueue::Packet packet;
+  packet.program = program;
+  packet.type = RenderQueue::DrawType::MultiElementsIndirect;
+  packet.indirectBuffer = m_commandBuffer;
+  packet.storageBuffer = m_drawDataBuffer;
+  packet.storageBinding = DrawDataBinding;
+  for (const Bucket &bucket : m_buckets)
+  {
+    packet.vertexArray = arena.GetVAO(bucket.pool);
+    packet.texture = bucket.texture;
+    packet.indexType = arena.GetIndexType(bucket.pool);
+    packet.offset = bucket.firstCommand * sizeof(DrawElementsCommand);
+    packet.count = bucket.commandsCount;
+    queue.Add(pass, packet);
+  }
+  return static_cast<u32>(m_buckets.size());
+}
@@ -0,0 +1,76 @@
+#include "MaskTiles.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Range of mask texels [first, last] filtering can read for frame pixels [begin, end) along one axis
+void GetTexelRange(uint32_t begin, uint32_t end, uint32_t maskSize, uint32_t size, int64_t &first, int64_t &last)
+{
+  const double scale = static_cast<double>(maskSize) / size;
+  // Minified mask is read from mip levels, every level texel covers this many texels of the base level
+  const int64_t mipFootprint = static_cast<int64_t>(std::ceil(scale));
+
+  first = static_cast<int64_t>(std::floor((begin + 0.5) * scale - 0.5)) - mipFootprint;
+  last = static_cast<int64_t>(std::floor((end - 0.5) * scale - 0.5)) + 1 + mipFootprint;
+}
+
+uint32_t Wrap(int64_t texel, uint32_t size)
+{
+  const int64_t wrapped = texel % static_cast<int64_t>(size);
+  return static_cast<uint32_t>(wrapped < 0 ? wrapped + size : wrapped);
+}
+}// namespace
+
+namespace MaskTiles
+{
+Classification Classify(const uint8_t *mask,
+  uint32_t maskWidth,
+  uint32_t maskHeight,
+  uint32_t maskChannels,
+  uint32_t width,
+  uint32_t height,
+  uint32_t tileSize)
+{
+  Classification classification;
+  const glm::vec2 frameSize(static_cast<float>(width), static_cast<float>(height));
+
+  for (uint32_t tileY = 0; tileY < height; tileY += tileSize)
+  {
+    const uint32_t tileEndY = std::min(tileY + tileSize, height);
+    int64_t firstRow{}, lastRow{};
+    GetTexelRange(tileY, tileEndY, maskHeight, height, firstRow, lastRow);
+
+    for (uint32_t tileX = 0; tileX < width; tileX += tileSize)
+    {
+      const uint32_t tileEndX = std::min(tileX + tileSize, width);
+      int64_t firstColumn{}, lastColumn{};
+      GetTexelRange(tileX, tileEndX, maskWidth, width, firstColumn, lastColumn);
+
+      uint8_t minValue = UINT8_MAX;
+      uint8_t maxValue = 0;
+      for (int64_t row = firstRow; row <= lastRow; ++row)
+      {
+        const uint8_t *maskRow = mask + static_cast<size_t>(Wrap(row, maskHeight)) * maskWidth * maskChannels;
+        for (int64_t column = firstColumn; column <= lastColumn; ++column)
+        {
+          const uint8_t value = maskRow[static_cast<size_t>(Wrap(column, maskWidth)) * maskChannels];
+          minValue = std::min(minValue, value);
+          maxValue = std::max(maxValue, value);
+        }
+      }
+
+      const glm::vec4 tile(glm::vec2(tileX, tileY) / frameSize, glm::vec2(tileEndX, tileEndY) / frameSize);
+      if (minValue == UINT8_MAX)
+        classification.sharp.push_back(tile);
+      else if (maxValue == 0)
+        classification.blurred.push_back(tile);
+      else
+        classification.mixed.push_back(tile);
+    }
+  }
+
+  return classification;
+}
+}// namespace MaskTiles
@@ -0,0 +1,219 @@
+#include "MeshCache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+constexpr char Magic[4] = { 'B', 'R', 'M', 'C' };
+constexpr auto CacheExtension = ".meshcache";
+// Vertex and index arrays start at this alignment in the file
+constexpr uint64_t DataAlignment = 16;
+
+constexpr uint64_t FNVOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t FNVPrime = 1099511628211ull;
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceHash;
+  uint32_t importFlags;
+  uint32_t vertexSize;
+  uint32_t meshCount;
+  uint32_t reserved;
+};
+
+struct MeshRecord
+{
+  uint64_t verticesOffset;
+  uint64_t indicesOffset;
+  // Every texture is {uint32_t typeLength, uint32_t pathLength, type, path}
+  uint64_t texturesOffset;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t textureCount;
+  uint32_t reserved;
+};
+
+uint64_t AlignUp(uint64_t value) { return (value + DataAlignment - 1) / DataAlignment * DataAlignment; }
+
+bool ReadString(const Utility::MappedFile &file, uint64_t &offset, uint32_t length, std::string &value)
+{
+  if (offset + length > file.GetSize())
+    return false;
+  value.assign(reinterpret_cast<const char *>(file.GetData() + offset), length);
+  offset += length;
+  return true;
+}
+
+template<typename T>
+bool ReadValue(const Utility::MappedFile &file, uint64_t &offset, T &value)
+{
+  if (offset + sizeof(T) > file.GetSize())
+    return false;
+  std::memcpy(&value, file.GetData() + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+template<typename T>
+void WriteValue(std::ofstream &file, const T &value)
+{
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void WritePadding(std::ofstream &file, uint64_t &offset)
+{
+  static constexpr char Zeros[DataAlignment] = {};
+  const uint64_t aligned = AlignUp(offset);
+  file.write(Zeros, static_cast<std::streamsize>(aligned - offset));
+  offset = aligned;
+}
+}// namespace
+
+namespace MeshCache
+{
+std::string GetCachePath(const std::string &sourcePath) { return sourcePath + CacheExtension; }
+
+uint64_t HashFile(const std::string &path)
+{
+  Utility::MappedFile file;
+  if (!file.Open(path))
+    return 0;
+
+  uint64_t hash = FNVOffsetBasis;
+  for (size_t i = 0; i < file.GetSize(); ++i)
+    hash = (hash ^ file.GetData()[i]) * FNVPrime;
+  return hash;
+}
+
+bool Load(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags, CachedModel &model)
+{
+  model.meshes.clear();
+  if (sourceHash == 0 || !model.file.Open(cachePath))
+    return false;
+
+  uint64_t offset = 0;
+  FileHeader header{};
+  if (!ReadValue(model.file, offset, header) || std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+      || header.version != Version || header.sourceHash != sourceHash || header.importFlags != importFlags
+      || header.vertexSize != sizeof(Vertex))
+  {
+    model.file.Close();
+    return false;
+  }
+
+  const uint8_t *data = model.file.GetData();
+  const uint64_t size = model.file.GetSize();
+  for (uint32_t i = 0; i < header.meshCount; ++i)
+  {
+    MeshRecord record{};
+    bool valid = ReadValue(model.file, offset, record);
+    valid = valid && record.verticesOffset + uint64_t{ record.vertexCount } * sizeof(Vertex) <= size;
+    valid = valid && record.indicesOffset + uint64_t{ record.indexCount } * sizeof(uint32_t) <= size;
+    valid = valid && record.verticesOffset % alignof(Vertex) == 0 && record.indicesOffset % alignof(uint32_t) == 0;
+
+    MeshView mesh;
+    mesh.vertices = reinterpret_cast<const Vertex *>(data + record.verticesOffset);
+    mesh.vertexCount = record.vertexCount;
+    mesh.indices = reinterpret_cast<const uint32_t *>(data + record.indicesOffset);
+    mesh.indexCount = record.indexCount;
+
+    uint64_t texturesOffset = record.texturesOffset;
+    for (uint32_t j = 0; valid && j < record.textureCount; ++j)
+    {
+      uint32_t typeLength{}, pathLength{};
+      MaterialTexture texture;
+      valid = ReadValue(model.file, texturesOffset, typeLength) && ReadValue(model.file, texturesOffset, pathLength)
+              && ReadString(model.file, texturesOffset, typeLength, texture.type)
+              && ReadString(model.file, texturesOffset, pathLength, texture.path);
+      mesh.textures.push_back(std::move(texture));
+    }
+
+    if (!valid)
+    {
+      model.meshes.clear();
+      model.file.Close();
+      return false;
+    }
+    model.meshes.push_back(std::move(mesh));
+  }
+
+  return true;
+}
+
+bool Save(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags, const std::vector<Mesh> &meshes)
+{
+  if (sourceHash == 0)
+    return false;
+
+  // Written aside and renamed, so a crash can't leave a truncated cache behind
+  const std::string temporaryPath = cachePath + ".tmp";
+  std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+  if (!file)
+    return false;
+
+  FileHeader header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.sourceHash = sourceHash;
+  header.importFlags = importFlags;
+  header.vertexSize = sizeof(Vertex);
+  header.meshCount = static_cast<uint32_t>(meshes.size());
+  WriteValue(file, header);
+
+  // Mesh records first, their data follows in the same order
+  uint64_t offset = sizeof(FileHeader) + meshes.size() * sizeof(MeshRecord);
+  std::vector<MeshRecord> records(meshes.size());
+  for (size_t i = 0; i < meshes.size(); ++i)
+  {
+    const Mesh &mesh = meshes[i];
+    MeshRecord &record = records[i];
+    record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    record.textureCount = static_cast<uint32_t>(mesh.textures.size());
+
+    offset = AlignUp(offset);
+    record.verticesOffset = offset;
+    offset = AlignUp(offset + mesh.vertices.size() * sizeof(Vertex));
+    record.indicesOffset = offset;
+    offset += mesh.indices.size() * sizeof(uint32_t);
+    record.texturesOffset = offset;
+    for (const Texture &texture : mesh.textures)
+      offset += 2 * sizeof(uint32_t) + texture.type.size() + texture.path.size();
+
+    WriteValue(file, record);
+  }
+
+  offset = sizeof(FileHeader) + meshes.size() * sizeof(MeshRecord);
+  for (const Mesh &mesh : meshes)
+  {
+    WritePadding(file, offset);
+    file.write(reinterpret_cast<const char *>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+    offset += mesh.vertices.size() * sizeof(Vertex);
+
+    WritePadding(file, offset);
+    file.write(reinterpret_cast<const char *>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+    offset += mesh.indices.size() * sizeof(uint32_t);
+
+    for (const Texture &texture : mesh.textures)
+    {
+      WriteValue(file, static_cast<uint32_t>(texture.type.size()));
+      WriteValue(file, static_cast<uint32_t>(texture.path.size()));
+      file.write(texture.type.data(), texture.type.size());
+      file.write(texture.path.data(), texture.path.size());
+      offset += 2 * sizeof(uint32_t) + texture.type.size() + texture.path.size();
+    }
+  }
+
+  file.close();
+  if (!file)
+    return false;
+
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, cachePath, error);
+  return !error;
+}
+}// namespace MeshCache
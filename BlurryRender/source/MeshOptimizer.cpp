@@ -0,0 +1,277 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+struct VertexHash
+{
+  size_t operator()(const Vertex &vertex) const
+  {
+    // 64-bit FNV-1a over the raw bytes, Vertex is floats only without padding
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&vertex);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(Vertex); ++i)
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return static_cast<size_t>(hash);
+  }
+};
+
+struct VertexEqual
+{
+  bool operator()(const Vertex &lhs, const Vertex &rhs) const { return std::memcmp(&lhs, &rhs, sizeof(Vertex)) == 0; }
+};
+
+// Triangles using every vertex, triangles of vertex v are triangles[offsets[v]..offsets[v + 1])
+struct Adjacency
+{
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+
+  Adjacency(const std::vector<unsigned int> &indices, size_t vertexCount) : offsets(vertexCount + 1, 0)
+  {
+    for (unsigned int index : indices)
+      ++offsets[index + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    triangles.resize(indices.size());
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+      triangles[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+};
+
+glm::vec3 GetTriangleNormal(const std::vector<Vertex> &vertices, const unsigned int *triangle)
+{
+  const glm::vec3 &a = vertices[triangle[0]].Position;
+  // Not normalized, so that bigger triangles weigh more in cluster normals
+  return glm::cross(vertices[triangle[1]].Position - a, vertices[triangle[2]].Position - a);
+}
+
+glm::vec3 GetTriangleCenter(const std::vector<Vertex> &vertices, const unsigned int *triangle)
+{
+  return (vertices[triangle[0]].Position + vertices[triangle[1]].Position + vertices[triangle[2]].Position) / 3.0f;
+}
+}// namespace
+
+namespace MeshOptimizer
+{
+Statistics &Statistics::operator+=(const Statistics &other)
+{
+  vertexCount += other.vertexCount;
+  triangleCount += other.triangleCount;
+  cacheMisses += other.cacheMisses;
+  vertexBytes += other.vertexBytes;
+  indexBytes += other.indexBytes;
+  return *this;
+}
+
+Statistics Measure(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, size_t indexSize)
+{
+  Statistics statistics;
+  statistics.vertexCount = vertices.size();
+  statistics.triangleCount = indices.size() / 3;
+  statistics.cacheMisses = CountCacheMisses(indices, vertices.size());
+  statistics.vertexBytes = vertices.size() * sizeof(Vertex);
+  statistics.indexBytes = indices.size() * indexSize;
+  return statistics;
+}
+
+size_t CountCacheMisses(const std::vector<unsigned int> &indices, size_t vertexCount, uint32_t cacheSize)
+{
+  // Vertex is in the FIFO while fewer than cacheSize misses happened since it got there
+  std::vector<size_t> insertedAt(vertexCount, 0);
+  size_t misses = 0;
+  for (unsigned int index : indices)
+  {
+    if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize)
+      insertedAt[index] = ++misses;
+  }
+  return misses;
+}
+
+void WeldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+  std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> unique;
+  unique.reserve(vertices.size());
+
+  std::vector<uint32_t> remap(vertices.size());
+  std::vector<Vertex> welded;
+  welded.reserve(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    const auto [entry, inserted] = unique.try_emplace(vertices[i], static_cast<uint32_t>(welded.size()));
+    if (inserted)
+      welded.push_back(vertices[i]);
+    remap[i] = entry->second;
+  }
+
+  for (unsigned int &index : indices)
+    index = remap[index];
+  vertices = std::move(welded);
+}
+
+std::vector<size_t> OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount, uint32_t cacheSize)
+{
+  const size_t triangleCount = indices.size() / 3;
+  std::vector<size_t> clusters;
+  if (triangleCount == 0)
+    return clusters;
+
+  const Adjacency adjacency(indices, vertexCount);
+  std::vector<uint32_t> liveTriangles(vertexCount);
+  for (size_t v = 0; v < vertexCount; ++v)
+    liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+  std::vector<size_t> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnd;
+  std::vector<uint32_t> candidates;
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+
+  // Timestamps start past the cache size, so that nothing is cached initially
+  size_t time = cacheSize + 1;
+  uint32_t cursor = 0;
+  uint32_t fanning = indices[0];
+  clusters.push_back(0);
+  while (fanning != InvalidIndex)
+  {
+    // Emit every remaining triangle around the fanning vertex
+    candidates.clear();
+    for (uint32_t i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; ++i)
+    {
+      const uint32_t triangle = adjacency.triangles[i];
+      if (emitted[triangle])
+        continue;
+
+      for (size_t corner = 0; corner < 3; ++corner)
+      {
+        const uint32_t v = indices[triangle * 3 + corner];
+        result.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        --liveTriangles[v];
+        if (time - cacheTime[v] > cacheSize)
+          cacheTime[v] = time++;
+      }
+      emitted[triangle] = true;
+    }
+
+    // Next fanning vertex is the candidate that stays in the cache longest while its triangles are emitted
+    uint32_t next = InvalidIndex;
+    int64_t bestPriority = -1;
+    for (uint32_t v : candidates)
+    {
+      if (liveTriangles[v] == 0)
+        continue;
+      int64_t priority = 0;
+      if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+        priority = static_cast<int64_t>(time - cacheTime[v]);
+      if (priority > bestPriority)
+      {
+        bestPriority = priority;
+        next = v;
+      }
+    }
+
+    if (next == InvalidIndex)
+    {
+      // Dead end, whatever comes next starts a new cluster
+      while (!deadEnd.empty() && next == InvalidIndex)
+      {
+        const uint32_t v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[v] > 0)
+          next = v;
+      }
+      for (; next == InvalidIndex && cursor < vertexCount; ++cursor)
+      {
+        if (liveTriangles[cursor] > 0)
+          next = cursor;
+      }
+      if (next != InvalidIndex && result.size() < indices.size())
+        clusters.push_back(result.size() / 3);
+    }
+    fanning = next;
+  }
+
+  indices = std::move(result);
+  return clusters;
+}
+
+void OptimizeOverdraw(std::vector<unsigned int> &indices,
+  const std::vector<Vertex> &vertices,
+  const std::vector<size_t> &clusters)
+{
+  const size_t triangleCount = indices.size() / 3;
+  if (clusters.size() < 2)
+    return;
+
+  glm::vec3 meshCenter(0.0f);
+  for (size_t t = 0; t < triangleCount; ++t)
+    meshCenter += GetTriangleCenter(vertices, &indices[t * 3]);
+  meshCenter /= static_cast<float>(triangleCount);
+
+  std::vector<float> outwardness(clusters.size());
+  for (size_t c = 0; c < clusters.size(); ++c)
+  {
+    const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+    glm::vec3 normal(0.0f), center(0.0f);
+    for (size_t t = clusters[c]; t < end; ++t)
+    {
+      normal += GetTriangleNormal(vertices, &indices[t * 3]);
+      center += GetTriangleCenter(vertices, &indices[t * 3]);
+    }
+    center /= static_cast<float>(end - clusters[c]);
+
+    const float normalLength = glm::length(normal);
+    outwardness[c] = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+  }
+
+  std::vector<size_t> order(clusters.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&outwardness](size_t lhs, size_t rhs) {
+    return outwardness[lhs] > outwardness[rhs];
+  });
+
+  std::vector<unsigned int> result;
+  result.reserve(indices.size());
+  for (size_t c : order)
+  {
+    const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+    result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+  }
+  indices = std::move(result);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+  std::vector<uint32_t> remap(vertices.size(), InvalidIndex);
+  std::vector<Vertex> reordered;
+  reordered.reserve(vertices.size());
+  for (unsigned int &index : indices)
+  {
+    if (remap[index] == InvalidIndex)
+    {
+      remap[index] = static_cast<uint32_t>(reordered.size());
+      reordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices = std::move(reordered);
+}
+
+void Optimize(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+  WeldVertices(vertices, indices);
+  const std::vector<size_t> clusters = OptimizeVertexCache(indices, vertices.size());
+  OptimizeOverdraw(indices, vertices, clusters);
+  OptimizeVertexFetch(vertices, indices);
+}
+}// namespace MeshOptimizer
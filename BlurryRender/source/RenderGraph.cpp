@@ -0,0 +1,310 @@
+#include "RenderGraph.hpp"
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+// Frames a pooled texture or framebuffer survives unused
+constexpr uint32_t MaxIdleFrames = 4;
+
+bool IsDepthFormat(uint32_t format)
+{
+  switch (format)
+  {
+  case GL_DEPTH_COMPONENT16:
+  case GL_DEPTH_COMPONENT24:
+  case GL_DEPTH_COMPONENT32F:
+  case GL_DEPTH24_STENCIL8:
+  case GL_DEPTH32F_STENCIL8:
+    return true;
+  default:
+    return false;
+  }
+}
+
+size_t GetTexelSize(uint32_t format)
+{
+  switch (format)
+  {
+  case GL_R8:
+    return 1;
+  case GL_RGB8:
+    return 3;
+  case GL_RGBA16F:
+  case GL_DEPTH32F_STENCIL8:
+    return 8;
+  case GL_RGBA32F:
+    return 16;
+  default:
+    return 4;
+  }
+}
+}// namespace
+
+RenderGraph::~RenderGraph() { Release(); }
+
+void RenderGraph::Reset()
+{
+  m_resources.clear();
+  m_passes.clear();
+}
+
+RenderGraph::Handle RenderGraph::CreateTexture(std::string name, const TextureDesc &desc)
+{
+  Resource resource;
+  resource.name = std::move(name);
+  resource.desc = desc;
+  m_resources.push_back(std::move(resource));
+  return static_cast<Handle>(m_resources.size() - 1);
+}
+
+RenderGraph::Handle RenderGraph::ImportTexture(std::string name, u32 texture, const TextureDesc &desc)
+{
+  Resource resource;
+  resource.name = std::move(name);
+  resource.desc = desc;
+  resource.imported = true;
+  resource.texture = texture;
+  m_resources.push_back(std::move(resource));
+
+  // Pooled texture imported back, e.g. last frame's target, mustn't be handed out to transients meanwhile nor be
+  // trimmed while frames keep importing it
+  for (PooledTexture &pooled : m_texturePool)
+    if (pooled.texture == texture)
+    {
+      pooled.busy = true;
+      pooled.lastUsedFrame = m_frame;
+    }
+  return static_cast<Handle>(m_resources.size() - 1);
+}
+
+RenderGraph::Handle RenderGraph::ImportFramebuffer(std::string name, u32 framebuffer, u32 width, u32 height)
+{
+  Resource resource;
+  resource.name = std::move(name);
+  resource.desc = { width, height, 0 };
+  resource.imported = true;
+  resource.framebuffer = framebuffer;
+  m_resources.push_back(std::move(resource));
+  return static_cast<Handle>(m_resources.size() - 1);
+}
+
+void RenderGraph::AddPass(std::string name,
+  const char *profilerScope,
+  std::vector<Handle> reads,
+  std::vector<Handle> writes,
+  ExecuteFunction execute)
+{
+  m_passes.push_back({ std::move(name), profilerScope, std::move(reads), std::move(writes), std::move(execute) });
+}
+
+void RenderGraph::Cull()
+{
+  // Walking back from the imported resources, a pass is needed when something needed is among its writes
+  std::vector<bool> needed(m_resources.size());
+  for (size_t i = 0; i < m_resources.size(); ++i)
+    needed[i] = m_resources[i].imported;
+
+  for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass)
+  {
+    pass->culled = std::none_of(pass->writes.begin(), pass->writes.end(), [&needed](Handle handle) {
+      return needed[handle];
+    });
+    if (!pass->culled)
+      for (Handle handle : pass->reads)
+        needed[handle] = true;
+  }
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+  for (int32_t i = 0; i < static_cast<int32_t>(m_passes.size()); ++i)
+  {
+    const Pass &pass = m_passes[i];
+    if (pass.culled)
+      continue;
+
+    for (const std::vector<Handle> *handles : { &pass.reads, &pass.writes })
+      for (Handle handle : *handles)
+      {
+        Resource &resource = m_resources[handle];
+        if (resource.imported)
+          continue;
+        resource.firstPass = resource.firstPass < 0 ? i : resource.firstPass;
+        resource.lastPass = i;
+      }
+  }
+}
+
+RenderGraph::u32 RenderGraph::AcquireTexture(const TextureDesc &desc)
+{
+  auto pooled = std::find_if(m_texturePool.begin(), m_texturePool.end(), [&desc](const PooledTexture &texture) {
+    return !texture.busy && texture.desc == desc;
+  });
+  if (pooled == m_texturePool.end())
+  {
+    u32 texture{};
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, 1, desc.format, desc.width, desc.height);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    m_texturePool.push_back({ desc, texture, m_frame, false });
+    pooled = m_texturePool.end() - 1;
+  }
+
+  pooled->busy = true;
+  pooled->lastUsedFrame = m_frame;
+  return pooled->texture;
+}
+
+void RenderGraph::ReleaseTexture(u32 texture)
+{
+  for (PooledTexture &pooled : m_texturePool)
+    if (pooled.texture == texture)
+      pooled.busy = false;
+}
+
+RenderGraph::u32 RenderGraph::GetFramebuffer(const std::vector<Handle> &attachments)
+{
+  assert(!attachments.empty());
+  const Resource &first = m_resources[attachments.front()];
+  if (first.framebuffer != 0 || (first.imported && first.texture == 0))
+    return first.framebuffer;
+
+  std::vector<u32> textures;
+  for (Handle handle : attachments)
+    textures.push_back(m_resources[handle].texture);
+
+  auto pooled = std::find_if(m_framebufferPool.begin(),
+    m_framebufferPool.end(),
+    [&textures](const PooledFramebuffer &framebuffer) { return framebuffer.textures == textures; });
+  if (pooled == m_framebufferPool.end())
+  {
+    u32 framebuffer{};
+    glCreateFramebuffers(1, &framebuffer);
+    std::vector<GLenum> drawBuffers;
+    for (Handle handle : attachments)
+    {
+      const Resource &resource = m_resources[handle];
+      GLenum attachment = GL_DEPTH_ATTACHMENT;
+      if (!IsDepthFormat(resource.desc.format))
+      {
+        attachment = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(drawBuffers.size());
+        drawBuffers.push_back(attachment);
+      }
+      glNamedFramebufferTexture(framebuffer, attachment, resource.texture, 0);
+    }
+    glNamedFramebufferDrawBuffers(framebuffer, static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+
+    W_CHECK(glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+    m_framebufferPool.push_back({ std::move(textures), framebuffer, m_frame });
+    pooled = m_framebufferPool.end() - 1;
+  }
+
+  pooled->lastUsedFrame = m_frame;
+  return pooled->framebuffer;
+}
+
+void RenderGraph::Execute(GpuProfiler *profiler)
+{
+  Cull();
+  ComputeLifetimes();
+
+  m_statistics = {};
+  m_statistics.passes = static_cast<u32>(m_passes.size());
+  const Context context(*this);
+  const char *scopeName = nullptr;
+  for (int32_t i = 0; i < static_cast<int32_t>(m_passes.size()); ++i)
+  {
+    const Pass &pass = m_passes[i];
+    if (pass.culled)
+    {
+      ++m_statistics.culledPasses;
+      continue;
+    }
+
+    for (Resource &resource : m_resources)
+      if (resource.firstPass == i)
+      {
+        resource.texture = AcquireTexture(resource.desc);
+        ++m_statistics.transientTextures;
+      }
+
+    if (profiler && pass.profilerScope != scopeName)
+    {
+      if (scopeName)
+        profiler->EndPass();
+      profiler->BeginPass(pass.profilerScope);
+      scopeName = pass.profilerScope;
+    }
+    pass.execute(context);
+
+    // Passes that follow may reuse it, GL orders their writes after the reads of this one
+    for (const Resource &resource : m_resources)
+      if (resource.lastPass == i)
+        ReleaseTexture(resource.texture);
+  }
+  if (profiler && scopeName)
+    profiler->EndPass();
+
+  for (PooledTexture &pooled : m_texturePool)
+  {
+    m_statistics.usedTextures += pooled.lastUsedFrame == m_frame ? 1 : 0;
+    pooled.busy = false;
+  }
+  TrimPool();
+  ++m_frame;
+}
+
+void RenderGraph::TrimPool()
+{
+  const auto isIdle = [this](u32 lastUsedFrame) { return lastUsedFrame + MaxIdleFrames < m_frame; };
+
+  std::vector<u32> deletedTextures;
+  std::erase_if(m_texturePool, [&](const PooledTexture &pooled) {
+    if (!isIdle(pooled.lastUsedFrame))
+      return false;
+    deletedTextures.push_back(pooled.texture);
+    return true;
+  });
+  // Framebuffers are idle at least as long as their textures
+  std::erase_if(m_framebufferPool, [&](const PooledFramebuffer &pooled) {
+    if (!isIdle(pooled.lastUsedFrame))
+      return false;
+    glDeleteFramebuffers(1, &pooled.framebuffer);
+    return true;
+  });
+  glDeleteTextures(static_cast<GLsizei>(deletedTextures.size()), deletedTextures.data());
+
+  m_statistics.pooledTextures = static_cast<u32>(m_texturePool.size());
+  for (const PooledTexture &pooled : m_texturePool)
+    m_statistics.pooledBytes += size_t{ pooled.desc.width } * pooled.desc.height * GetTexelSize(pooled.desc.format);
+}
+
+void RenderGraph::Release()
+{
+  for (const PooledFramebuffer &pooled : m_framebufferPool)
+    glDeleteFramebuffers(1, &pooled.framebuffer);
+  for (const PooledTexture &pooled : m_texturePool)
+    glDeleteTextures(1, &pooled.texture);
+  m_framebufferPool.clear();
+  m_texturePool.clear();
+  Reset();
+}
+
+RenderGraph::u32 RenderGraph::Context::GetTexture(Handle handle) const { return m_graph.m_resources[handle].texture; }
+
+const RenderGraph::TextureDesc &RenderGraph::Context::GetDesc(Handle handle) const
+{
+  return m_graph.m_resources[handle].desc;
+}
+
+RenderGraph::u32 RenderGraph::Context::GetFramebuffer(const std::vector<Handle> &attachments) const
+{
+  return m_graph.GetFramebuffer(attachments);
+}
@@ -0,0 +1,125 @@
+#include "RenderQueue.hpp"
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+// Key fields from the most significant bits down. GL names are small sequential integers, ones not fitting their
+// field are wrapped, which only makes sorting group them less well.
+constexpr uint32_t PassBits = 4;
+constexpr uint32_t ProgramBits = 10;
+constexpr uint32_t TextureBits = 16;
+constexpr uint32_t VertexArrayBits = 10;
+constexpr uint32_t DepthBits = 24;
+static_assert(PassBits + ProgramBits + TextureBits + VertexArrayBits + DepthBits == 64, "Key fields fill 64 bits");
+
+constexpr uint32_t DepthShift = 0;
+constexpr uint32_t VertexArrayShift = DepthShift + DepthBits;
+constexpr uint32_t TextureShift = VertexArrayShift + VertexArrayBits;
+constexpr uint32_t ProgramShift = TextureShift + TextureBits;
+constexpr uint32_t PassShift = ProgramShift + ProgramBits;
+
+constexpr uint64_t Field(uint64_t value, uint32_t bits, uint32_t shift)
+{
+  return (value & ((uint64_t{ 1 } << bits) - 1)) << shift;
+}
+
+constexpr uint32_t RadixBits = 8;
+constexpr uint32_t RadixSize = 1u << RadixBits;
+}// namespace
+
+RenderQueue::u64 RenderQueue::MakeKey(Pass pass, const Packet &packet, float depth)
+{
+  constexpr float MaxDepth = static_cast<float>((1u << DepthBits) - 1);
+  const u32 quantizedDepth = static_cast<u32>(std::clamp(depth, 0.0f, 1.0f) * MaxDepth);
+  return Field(static_cast<u64>(pass), PassBits, PassShift) | Field(packet.program, ProgramBits, ProgramShift)
+         | Field(packet.texture, TextureBits, TextureShift)
+         | Field(packet.vertexArray, VertexArrayBits, VertexArrayShift) | Field(quantizedDepth, DepthBits, DepthShift);
+}
+
+void RenderQueue::Clear()
+{
+  m_packets.clear();
+  m_order.clear();
+}
+
+void RenderQueue::Add(Pass pass, const Packet &packet, float depth)
+{
+  m_order.push_back({ MakeKey(pass, packet, depth), static_cast<u32>(m_packets.size()) });
+  m_packets.push_back(packet);
+}
+
+void RenderQueue::Sort()
+{
+  // LSD radix sort, stable, so packets with equal keys keep the order they were added in
+  m_scratch.resize(m_order.size());
+  for (u32 shift = 0; shift < 64; shift += RadixBits)
+  {
+    std::array<u32, RadixSize> offsets{};
+    for (const SortEntry &entry : m_order)
+      ++offsets[(entry.key >> shift) & (RadixSize - 1)];
+
+    // Digit all keys share doesn't change the order
+    if (std::find(offsets.begin(), offsets.end(), static_cast<u32>(m_order.size())) != offsets.end())
+      continue;
+
+    u32 offset = 0;
+    for (u32 &count : offsets)
+    {
+      const u32 bucketSize = count;
+      count = offset;
+      offset += bucketSize;
+    }
+    for (const SortEntry &entry : m_order)
+      m_scratch[offsets[(entry.key >> shift) & (RadixSize - 1)]++] = entry;
+    m_order.swap(m_scratch);
+  }
+}
+
+RenderQueue::u32 RenderQueue::Submit(Pass pass, StateCache &state) const
+{
+  const u64 passKey = Field(static_cast<u64>(pass), PassBits, PassShift);
+  const u64 passMask = Field(UINT64_MAX, PassBits, PassShift);
+  auto first = std::lower_bound(m_order.begin(), m_order.end(), passKey, [](const SortEntry &entry, u64 key) {
+    return entry.key < key;
+  });
+
+  u32 issued = 0;
+  for (auto entry = first; entry != m_order.end() && (entry->key & passMask) == passKey; ++entry, ++issued)
+    Issue(m_packets[entry->packet], state);
+  return issued;
+}
+
+void RenderQueue::Issue(const Packet &packet, StateCache &state)
+{
+  state.SetDepthTest(packet.depthTest);
+  state.UseProgram(packet.program);
+  state.BindVertexArray(packet.vertexArray);
+  state.BindTexture(0, packet.texture);
+  if (packet.storageBuffer != 0)
+    state.BindStorageBuffer(packet.storageBinding, packet.storageBuffer);
+
+  switch (packet.type)
+  {
+  case DrawType::Arrays:
+    glDrawArrays(GL_TRIANGLES, static_cast<GLint>(packet.first), static_cast<GLsizei>(packet.count));
+    break;
+  case DrawType::ElementsBaseVertex:
+    glDrawElementsBaseVertex(GL_TRIANGLES,
+      static_cast<GLsizei>(packet.count),
+      packet.indexType,
+      reinterpret_cast<void *>(packet.offset),
+      packet.baseVertex);
+    break;
+  case DrawType::MultiElementsIndirect:
+    state.BindDrawIndirectBuffer(packet.indirectBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES,
+      packet.indexType,
+      reinterpret_cast<void *>(packet.offset),
+      static_cast<GLsizei>(packet.count),
+      0);
+    break;
+  }
+}
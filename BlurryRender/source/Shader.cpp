@@ -1,35 +1,98 @@
 #include "Shader.hpp"
 #include <glad/glad.h>
 
+#include "ShaderCache.hpp"
 #include "Utility.hpp"
 
+#include <algorithm>
 #include <string>
 #include <cassert>
 #include <iostream>
-#include <Windows.h>
 
 inline constexpr uint32_t InfoBufferSize = 512;
 
 Shader::Shader(std::string vertexPath, std::string fragmentPath) : m_descriptor(0)
 {
-  Initialize(vertexPath, fragmentPath);
+  Submit(vertexPath, fragmentPath);
+  Finish();
 }
 
-void Shader::Initialize(std::string vertexPath, std::string fragmentPath)
+void Shader::Submit(const std::string &vertexPath, const std::string &fragmentPath)
 {
-  GLuint vertex = CreateShader(vertexPath, GL_VERTEX_SHADER);
-  GLuint fragment = CreateShader(fragmentPath, GL_FRAGMENT_SHADER);
+  m_vertexPath = vertexPath;
+  m_fragmentPath = fragmentPath;
+  const std::string vertexSource = Utility::ReadContentFromFile(vertexPath);
+  const std::string fragmentSource = Utility::ReadContentFromFile(fragmentPath);
 
-  // Shader Program itself
   m_descriptor = glCreateProgram();
-  glAttachShader(m_descriptor, vertex);
-  glAttachShader(m_descriptor, fragment);
+  m_cacheKey = ShaderCache::IsSupported() ? ShaderCache::GetKey(vertexSource, fragmentSource) : 0;
+  m_loadedFromCache = m_cacheKey != 0 && ShaderCache::Load(m_descriptor, m_cacheKey);
+  if (!m_loadedFromCache)
+    Link(vertexSource, fragmentSource);
+}
+
+void Shader::SubmitCompute(const std::string &computePath)
+{
+  m_computePath = computePath;
+  const std::string computeSource = Utility::ReadContentFromFile(computePath);
+
+  m_descriptor = glCreateProgram();
+  m_cacheKey = ShaderCache::IsSupported() ? ShaderCache::GetKey(computeSource, {}) : 0;
+  m_loadedFromCache = m_cacheKey != 0 && ShaderCache::Load(m_descriptor, m_cacheKey);
+  if (!m_loadedFromCache)
+    LinkCompute(computeSource);
+}
+
+void Shader::Link(const std::string &vertexSource, const std::string &fragmentSource)
+{
+  m_vertexShader = CreateShader(vertexSource, GL_VERTEX_SHADER);
+  m_fragmentShader = CreateShader(fragmentSource, GL_FRAGMENT_SHADER);
+
+  // Shader Program itself
+  glAttachShader(m_descriptor, m_vertexShader);
+  glAttachShader(m_descriptor, m_fragmentShader);
+  if (m_cacheKey != 0)
+    glProgramParameteri(m_descriptor, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glLinkProgram(m_descriptor);
+}
 
+void Shader::LinkCompute(const std::string &computeSource)
+{
+  m_computeShader = CreateShader(computeSource, GL_COMPUTE_SHADER);
+
+  glAttachShader(m_descriptor, m_computeShader);
+  if (m_cacheKey != 0)
+    glProgramParameteri(m_descriptor, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(m_descriptor);
+}
+
+bool Shader::Finish()
+{
   GLint success = 0;
   glGetProgramiv(m_descriptor, GL_LINK_STATUS, &success);
+  if (!success && m_loadedFromCache)
+  {
+    // Driver rejected its own binary, e.g. after an update that kept the version string
+    Utility::DebugOutput("Cached program binary rejected, linking from sources: "
+                         + (m_computePath.empty() ? m_vertexPath + ", " + m_fragmentPath : m_computePath) + '\n');
+    m_loadedFromCache = false;
+    if (m_computePath.empty())
+      Link(Utility::ReadContentFromFile(m_vertexPath), Utility::ReadContentFromFile(m_fragmentPath));
+    else
+      LinkCompute(Utility::ReadContentFromFile(m_computePath));
+    glGetProgramiv(m_descriptor, GL_LINK_STATUS, &success);
+  }
+
   if (!success)
   {
+    if (m_computePath.empty())
+    {
+      CheckCompileStatus(m_vertexShader, m_vertexPath, GL_VERTEX_SHADER);
+      CheckCompileStatus(m_fragmentShader, m_fragmentPath, GL_FRAGMENT_SHADER);
+    }
+    else
+      CheckCompileStatus(m_computeShader, m_computePath, GL_COMPUTE_SHADER);
+
     std::string infoLog;
     infoLog.resize(InfoBufferSize);
     glGetProgramInfoLog(m_descriptor, InfoBufferSize, nullptr, infoLog.data());
@@ -37,23 +100,97 @@ void Shader::Initialize(std::string vertexPath, std::string fragmentPath)
     std::string output{};
     output += "Failed linkage of GLSL shaders into a shader program.\n";
     output += "Program info log:\n" + infoLog + '\n';
-    OutputDebugStringA(output.c_str());
+    Utility::DebugOutput(output);
   }
+  else if (!m_loadedFromCache && m_cacheKey != 0)
+    ShaderCache::Save(m_descriptor, m_cacheKey);
 
   // shaders linked to our program and no longer need to keep them
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+  if (m_vertexShader != 0)
+  {
+    glDetachShader(m_descriptor, m_vertexShader);
+    glDeleteShader(m_vertexShader);
+  }
+  if (m_fragmentShader != 0)
+  {
+    glDetachShader(m_descriptor, m_fragmentShader);
+    glDeleteShader(m_fragmentShader);
+  }
+  if (m_computeShader != 0)
+  {
+    glDetachShader(m_descriptor, m_computeShader);
+    glDeleteShader(m_computeShader);
+  }
+  m_vertexShader = 0;
+  m_fragmentShader = 0;
+  m_computeShader = 0;
+
+  CollectUniforms();
+  return success;
 }
 
-GLuint Shader::CreateShader(std::string shaderPath, unsigned int type)
+void Shader::CollectUniforms()
+{
+  m_uniforms.clear();
+
+  GLint uniformsCount{}, maxNameLength{};
+  glGetProgramiv(m_descriptor, GL_ACTIVE_UNIFORMS, &uniformsCount);
+  glGetProgramiv(m_descriptor, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+  std::string name(static_cast<size_t>(std::max(maxNameLength, 1)), '\0');
+  for (GLint i = 0; i < uniformsCount; ++i)
+  {
+    GLsizei nameLength{};
+    GLint size{};
+    GLenum type{};
+    glGetActiveUniform(m_descriptor, i, maxNameLength, &nameLength, &size, &type, name.data());
+
+    std::string uniformName(name.data(), nameLength);
+    const GLint location = glGetUniformLocation(m_descriptor, uniformName.c_str());
+    // Members of uniform blocks have no location
+    if (location < 0)
+      continue;
+
+    // Arrays are reported as "name[0]", they can be set by plain "name" too
+    const size_t arraySuffix = uniformName.rfind("[0]");
+    if (arraySuffix != std::string::npos && arraySuffix + 3 == uniformName.size())
+    {
+      std::string arrayName = uniformName.substr(0, arraySuffix);
+      m_uniforms.push_back({ UniformName::Hash(arrayName), location, std::move(arrayName) });
+    }
+    m_uniforms.push_back({ UniformName::Hash(uniformName), location, std::move(uniformName) });
+  }
+
+  std::sort(m_uniforms.begin(), m_uniforms.end(), [](const UniformEntry &lhs, const UniformEntry &rhs) {
+    return lhs.hash < rhs.hash;
+  });
+}
+
+Shader::UniformHandle Shader::getUniform(UniformName name) const
+{
+  const auto isLess = [](const UniformEntry &lhs, uint32_t hash) { return lhs.hash < hash; };
+  auto entry = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), name.hash, isLess);
+  for (; entry != m_uniforms.end() && entry->hash == name.hash; ++entry)
+  {
+    if (entry->name == name.name)
+      return { entry->location };
+  }
+  return {};
+}
+
+GLuint Shader::CreateShader(const std::string &shaderCode, unsigned int type)
 {
-  const std::string shaderCode = Utility::ReadContentFromFile(shaderPath);
   const char *cShaderCode = shaderCode.c_str();
 
+  // Status isn't queried here, that would wait for the compilation to finish
   GLuint shader = glCreateShader(type);
   glShaderSource(shader, 1, &cShaderCode, nullptr);
   glCompileShader(shader);
+  return shader;
+}
 
+void Shader::CheckCompileStatus(unsigned int shader, const std::string &shaderPath, unsigned int type)
+{
   std::string infoLog;
   infoLog.resize(InfoBufferSize);
   int success{};
@@ -63,14 +200,14 @@ GLuint Shader::CreateShader(std::string shaderPath, unsigned int type)
   if (!success)
   {
     glGetShaderInfoLog(shader, InfoBufferSize, nullptr, infoLog.data());
-    const std::string shaderTypeStr = (type == GL_VERTEX_SHADER) ? "vertex" : "fragment";
+    const std::string shaderTypeStr = (type == GL_VERTEX_SHADER)  ? "vertex"
+                                      : (type == GL_COMPUTE_SHADER) ? "compute"
+                                                                    : "fragment";
     std::string output = "";
     output += "GLSL compile error" + shaderTypeStr + " shader: '" + shaderPath + "'\n\n";
     output += "Shader info log:\n" + infoLog + '\n';
-    OutputDebugStringA(output.c_str());
+    Utility::DebugOutput(output);
   }
-
-  return shader;
 }
 
 void Shader::use()
@@ -78,63 +215,62 @@ void Shader::use()
   glUseProgram(m_descriptor);
 }
 
-void Shader::setUniform(const std::string &name, bool value) const
+void Shader::setUniform(UniformHandle uniform, bool value) const
 {
-  glUniform1i(glGetUniformLocation(m_descriptor, name.c_str()), (int)value);
+  glProgramUniform1i(m_descriptor, uniform.location, (int)value);
 }
 
-void Shader::setUniform(const std::string &name, int value) const
+void Shader::setUniform(UniformHandle uniform, int value) const
 {
-  glUniform1i(glGetUniformLocation(m_descriptor, name.c_str()), value);
+  glProgramUniform1i(m_descriptor, uniform.location, value);
 }
 
-void Shader::setUniform(const std::string &name, float value) const
+void Shader::setUniform(UniformHandle uniform, float value) const
 {
-  glUniform1f(glGetUniformLocation(m_descriptor, name.c_str()), value);
+  glProgramUniform1f(m_descriptor, uniform.location, value);
 }
 
-void Shader::setUniform(const std::string &name, const glm::vec2 &value) const
+void Shader::setUniform(UniformHandle uniform, const glm::vec2 &value) const
 {
-  glUniform2fv(glGetUniformLocation(m_descriptor, name.c_str()), 1, &value[0]);
+  glProgramUniform2fv(m_descriptor, uniform.location, 1, &value[0]);
 }
 
-void Shader::setUniform(const std::string &name, float x, float y) const
+void Shader::setUniform(UniformHandle uniform, float x, float y) const
 {
-  glUniform2f(glGetUniformLocation(m_descriptor, name.c_str()), x, y);
+  glProgramUniform2f(m_descriptor, uniform.location, x, y);
 }
 
-void Shader::setUniform(const std::string &name, const glm::vec3 &value) const
+void Shader::setUniform(UniformHandle uniform, const glm::vec3 &value) const
 {
-  glUniform3fv(glGetUniformLocation(m_descriptor, name.c_str()), 1, &value[0]);
+  glProgramUniform3fv(m_descriptor, uniform.location, 1, &value[0]);
 }
 
-void Shader::setUniform(const std::string &name, float x, float y, float z) const
+void Shader::setUniform(UniformHandle uniform, float x, float y, float z) const
 {
-  glUniform3f(glGetUniformLocation(m_descriptor, name.c_str()), x, y, z);
+  glProgramUniform3f(m_descriptor, uniform.location, x, y, z);
 }
 
-void Shader::setUniform(const std::string &name, const glm::vec4 &value) const
+void Shader::setUniform(UniformHandle uniform, const glm::vec4 &value) const
 {
-  glUniform4fv(glGetUniformLocation(m_descriptor, name.c_str()), 1, &value[0]);
+  glProgramUniform4fv(m_descriptor, uniform.location, 1, &value[0]);
 }
 
-void Shader::setUniform(const std::string &name, float x, float y, float z, float w)
+void Shader::setUniform(UniformHandle uniform, float x, float y, float z, float w) const
 {
-  glUniform4f(glGetUniformLocation(m_descriptor, name.c_str()), x, y, z, w);
+  glProgramUniform4f(m_descriptor, uniform.location, x, y, z, w);
 }
 
-void Shader::setUniform(const std::string &name, const glm::mat2 &mat) const
+void Shader::setUniform(UniformHandle uniform, const glm::mat2 &mat) const
 {
-  glUniformMatrix2fv(glGetUniformLocation(m_descriptor, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  glProgramUniformMatrix2fv(m_descriptor, uniform.location, 1, GL_FALSE, &mat[0][0]);
 }
 
-void Shader::setUniform(const std::string &name, const glm::mat3 &mat) const
+void Shader::setUniform(UniformHandle uniform, const glm::mat3 &mat) const
 {
-  glUniformMatrix3fv(glGetUniformLocation(m_descriptor, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  glProgramUniformMatrix3fv(m_descriptor, uniform.location, 1, GL_FALSE, &mat[0][0]);
 }
 
-void Shader::setUniform(const std::string &name, const glm::mat4 &mat) const
+void Shader::setUniform(UniformHandle uniform, const glm::mat4 &mat) const
 {
-  glUniformMatrix4fv(glGetUniformLocation(m_descriptor, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  glProgramUniformMatrix4fv(m_descriptor, uniform.location, 1, GL_FALSE, &mat[0][0]);
 }
-
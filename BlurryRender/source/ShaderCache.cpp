@@ -0,0 +1,130 @@
+#include "ShaderCache.hpp"
+#include <glad/glad.h>
+
+#include "Utility.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+constexpr char Magic[4] = { 'B', 'R', 'P', 'B' };
+constexpr auto CacheDirectory = "shadercache";
+constexpr auto CacheExtension = ".programbinary";
+
+constexpr uint64_t FNVOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t FNVPrime = 1099511628211ull;
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t binaryFormat;
+  uint32_t binarySize;
+};
+
+uint64_t Hash(uint64_t hash, const std::string &data)
+{
+  for (char c : data)
+    hash = (hash ^ static_cast<uint8_t>(c)) * FNVPrime;
+  // Separator, so that moving characters between the parts changes the hash
+  return (hash ^ 0xFF) * FNVPrime;
+}
+
+std::string GetString(GLenum name)
+{
+  const auto *value = reinterpret_cast<const char *>(glGetString(name));
+  return value ? value : "";
+}
+
+// Same sources give a different binary on another GPU or driver update
+const std::string &GetDriverIdentity()
+{
+  static const std::string identity =
+    GetString(GL_VENDOR) + '\n' + GetString(GL_RENDERER) + '\n' + GetString(GL_VERSION);
+  return identity;
+}
+}// namespace
+
+namespace ShaderCache
+{
+bool IsSupported()
+{
+  GLint formatsCount{};
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatsCount);
+  return formatsCount > 0;
+}
+
+uint64_t GetKey(const std::string &vertexSource, const std::string &fragmentSource)
+{
+  uint64_t hash = FNVOffsetBasis;
+  hash = Hash(hash, GetDriverIdentity());
+  hash = Hash(hash, vertexSource);
+  return Hash(hash, fragmentSource);
+}
+
+std::string GetCachePath(uint64_t key)
+{
+  char name[17]{};
+  std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+  return (std::filesystem::path(CacheDirectory) / (name + std::string(CacheExtension))).string();
+}
+
+bool Load(unsigned int program, uint64_t key)
+{
+  Utility::MappedFile file;
+  if (!file.Open(GetCachePath(key)) || file.GetSize() < sizeof(FileHeader))
+    return false;
+
+  FileHeader header{};
+  std::memcpy(&header, file.GetData(), sizeof(header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.key != key
+      || sizeof(FileHeader) + uint64_t{ header.binarySize } > file.GetSize())
+    return false;
+
+  glProgramBinary(program, header.binaryFormat, file.GetData() + sizeof(FileHeader), header.binarySize);
+  return true;
+}
+
+bool Save(unsigned int program, uint64_t key)
+{
+  GLint binarySize{};
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+  if (binarySize <= 0)
+    return false;
+
+  std::vector<char> binary(static_cast<size_t>(binarySize));
+  GLenum binaryFormat{};
+  glGetProgramBinary(program, binarySize, &binarySize, &binaryFormat, binary.data());
+
+  std::error_code error;
+  std::filesystem::create_directories(CacheDirectory, error);
+
+  // Written aside and renamed, so a crash can't leave a truncated binary behind
+  const std::string cachePath = GetCachePath(key);
+  const std::string temporaryPath = cachePath + ".tmp";
+  std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+  if (!file)
+    return false;
+
+  FileHeader header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.key = key;
+  header.binaryFormat = binaryFormat;
+  header.binarySize = static_cast<uint32_t>(binarySize);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(binary.data(), binarySize);
+
+  file.close();
+  if (!file)
+    return false;
+
+  std::filesystem::rename(temporaryPath, cachePath, error);
+  return !error;
+}
+}// namespace ShaderCache
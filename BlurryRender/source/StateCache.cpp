@@ -0,0 +1,73 @@
+#include "StateCache.hpp"
+#include <glad/glad.h>
+
+void StateCache::Invalidate()
+{
+  m_program = Unknown;
+  m_vertexArray = Unknown;
+  m_textures.fill(Unknown);
+  m_framebuffer = Unknown;
+  m_drawIndirectBuffer = Unknown;
+  m_storageBuffers.fill(Unknown);
+  m_depthTest = Unknown;
+}
+
+bool StateCache::Change(u32 &current, u32 value)
+{
+  if (current == value)
+  {
+    ++m_statistics.skipped;
+    return false;
+  }
+  ++m_statistics.issued;
+  current = value;
+  return true;
+}
+
+void StateCache::UseProgram(u32 program)
+{
+  if (Change(m_program, program))
+    glUseProgram(program);
+}
+
+void StateCache::BindVertexArray(u32 vertexArray)
+{
+  if (Change(m_vertexArray, vertexArray))
+    glBindVertexArray(vertexArray);
+}
+
+void StateCache::BindTexture(u32 unit, u32 texture)
+{
+  assert(unit < TextureUnits);
+  if (Change(m_textures[unit], texture))
+    glBindTextureUnit(unit, texture);
+}
+
+void StateCache::BindFramebuffer(u32 framebuffer)
+{
+  if (Change(m_framebuffer, framebuffer))
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void StateCache::BindDrawIndirectBuffer(u32 buffer)
+{
+  if (Change(m_drawIndirectBuffer, buffer))
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+}
+
+void StateCache::BindStorageBuffer(u32 binding, u32 buffer)
+{
+  assert(binding < StorageBindings);
+  if (Change(m_storageBuffers[binding], buffer))
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+void StateCache::SetDepthTest(bool enabled)
+{
+  if (!Change(m_depthTest, enabled ? 1 : 0))
+    return;
+  if (enabled)
+    glEnable(GL_DEPTH_TEST);
+  else
+    glDisable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,45 @@
+#include "StressScene.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdlib>
+#include <random>
+
+namespace StressScene
+{
+std::vector<Placement> Generate(uint32_t count, const Layout &layout)
+{
+  std::vector<Placement> placements;
+  placements.reserve(count);
+
+  std::mt19937 generator(layout.seed);
+  std::uniform_real_distribution<float> jitter(-layout.jitter, layout.jitter);
+  std::uniform_real_distribution<float> yaw(0.0f, glm::radians(360.0f));
+
+  // Ring r is the square outline of cells r steps away from the middle one
+  for (int32_t ring = 0; placements.size() < count; ++ring)
+    for (int32_t z = -ring; z <= ring && placements.size() < count; ++z)
+      for (int32_t x = -ring; x <= ring && placements.size() < count; ++x)
+      {
+        if (std::abs(x) != ring && std::abs(z) != ring)
+          continue;
+
+        const glm::vec2 cell = glm::vec2(static_cast<float>(x), static_cast<float>(z)) * layout.spacing;
+        if (glm::length(cell) < layout.clearRadius)
+          continue;
+
+        const glm::vec2 offset = glm::vec2(jitter(generator), jitter(generator)) * layout.spacing;
+        placements.push_back({ glm::vec3(cell.x + offset.x, layout.floorHeight, cell.y + offset.y), yaw(generator) });
+      }
+
+  return placements;
+}
+
+glm::mat4 GetTransform(const Placement &placement, float scale, float lift)
+{
+  glm::mat4 transform = glm::translate(glm::mat4(1.0f), placement.position);
+  transform = glm::rotate(transform, placement.yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+  transform = glm::scale(transform, glm::vec3(scale));
+  return glm::translate(transform, glm::vec3(0.0f, lift, 0.0f));
+}
+}// namespace StressScene
@@ -0,0 +1,390 @@
+#include "TextureLoader.hpp"
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+// Shown until the real image is uploaded
+constexpr uint8_t PlaceholderTexel[3] = { 128, 128, 128 };
+
+GLenum GetFormat(int channels)
+{
+  switch (channels)
+  {
+  case 1:
+    return GL_RED;
+  case 2:
+    return GL_RG;
+  case 4:
+    return GL_RGBA;
+  default:
+    return GL_RGB;
+  }
+}
+
+// Appends mips of the last level of `levels` down to 1x1, 2x2 box filtered (edge texels repeat for odd sizes)
+void BuildMipChain(int channels, std::vector<uint8_t> &pixels, std::vector<CompressedTexture::Level> &levels)
+{
+  while (levels.back().width > 1 || levels.back().height > 1)
+  {
+    const CompressedTexture::Level source = levels.back();
+    const uint32_t width = std::max(source.width / 2, 1u);
+    const uint32_t height = std::max(source.height / 2, 1u);
+    const size_t offset = source.offset + source.size;
+    levels.push_back({ width, height, offset, size_t(width) * height * channels });
+    pixels.resize(offset + levels.back().size);
+
+    const uint8_t *src = pixels.data() + source.offset;
+    uint8_t *dst = pixels.data() + offset;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      const size_t row0 = size_t(std::min(y * 2, source.height - 1)) * source.width;
+      const size_t row1 = size_t(std::min(y * 2 + 1, source.height - 1)) * source.width;
+      for (uint32_t x = 0; x < width; ++x)
+      {
+        const uint32_t x0 = std::min(x * 2, source.width - 1);
+        const uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+        for (int c = 0; c < channels; ++c)
+        {
+          const uint32_t sum = src[(row0 + x0) * channels + c] + src[(row0 + x1) * channels + c]
+                               + src[(row1 + x0) * channels + c] + src[(row1 + x1) * channels + c];
+          *dst++ = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      }
+    }
+  }
+}
+}// namespace
+
+TextureLoader::~TextureLoader() { Release(); }
+
+void TextureLoader::Initialize(u32 workers, size_t stagingSize, size_t frameBudget)
+{
+  if (workers == 0)
+    workers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+  m_stagingSize = stagingSize;
+  m_frameBudget = frameBudget;
+
+  constexpr GLbitfield StagingFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &m_stagingBuffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer);
+  glBufferStorage(GL_PIXEL_UNPACK_BUFFER, m_stagingSize, nullptr, StagingFlags);
+  m_stagingMemory = static_cast<uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_stagingSize, StagingFlags));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  W_CHECK(m_stagingMemory != nullptr);
+
+  m_stopping = false;
+  for (u32 i = 0; i < workers; ++i)
+    m_workers.emplace_back(&TextureLoader::WorkerLoop, this);
+}
+
+void TextureLoader::Release()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+    m_jobs.clear();
+  }
+  m_jobAdded.notify_all();
+  for (std::thread &worker : m_workers)
+    worker.join();
+  m_workers.clear();
+  m_decoded.clear();
+  m_streaming.clear();
+
+  for (const StagingRegion &region : m_stagingRegions)
+    glDeleteSync(static_cast<GLsync>(region.fence));
+  m_stagingRegions.clear();
+
+  if (m_stagingBuffer != 0)
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &m_stagingBuffer);
+  }
+  m_stagingBuffer = 0;
+  m_stagingMemory = nullptr;
+  m_pendingTextures = 0;
+}
+
+TextureLoader::u32 TextureLoader::Load(const std::string &path, bool flipVertically, LoadedCallback onLoaded)
+{
+  const u32 texture = CreatePlaceholder();
+  LoadInto(texture, path, flipVertically, std::move(onLoaded));
+  return texture;
+}
+
+void TextureLoader::LoadInto(u32 texture, const std::string &path, bool flipVertically, LoadedCallback onLoaded)
+{
+  ++m_pendingTextures;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back({ texture, path, flipVertically, std::move(onLoaded) });
+  }
+  m_jobAdded.notify_one();
+}
+
+TextureLoader::u32 TextureLoader::CreatePlaceholder()
+{
+  u32 texture{};
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  ResetToPlaceholder(texture, 1);
+  return texture;
+}
+
+void TextureLoader::ResetToPlaceholder(u32 texture, u32 levelsCount)
+{
+  glBindTexture(GL_TEXTURE_2D, texture);
+  // Zero sized levels release their storage
+  for (u32 level = 1; level < levelsCount; ++level)
+    glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGB, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, PlaceholderTexel);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+size_t TextureLoader::GetStreamingBytes() const
+{
+  size_t bytes = 0;
+  for (const DecodedImage &image : m_streaming)
+    bytes += image.IsCompressed() ? image.compressed.dataSize : image.pixels.size();
+  return bytes;
+}
+
+void TextureLoader::Update()
+{
+  RetireStaging(false);
+  Upload(m_frameBudget, false);
+}
+
+void TextureLoader::Finish()
+{
+  while (m_pendingTextures > 0)
+  {
+    if (m_streaming.empty())
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_imageDecoded.wait(lock, [this] { return !m_decoded.empty(); });
+    }
+    Upload(SIZE_MAX, true);
+  }
+}
+
+void TextureLoader::WorkerLoop()
+{
+  while (true)
+  {
+    DecodedImage image;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_jobAdded.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+      if (m_stopping)
+        return;
+      image.job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    // Baked files are stored in the orientation LoadTextureFromImage uses, i.e. not flipped
+    const std::string &path = image.job.path;
+    const bool baked = !image.job.flipVertically && CompressedTexture::HasBakedFile(path)
+                       && CompressedTexture::Load(CompressedTexture::GetBakedPath(path), image.compressed);
+    if (baked)
+    {
+      image.levels = image.compressed.levels;
+    }
+    else
+    {
+      image.compressed = {};
+      // Flip flag is per thread, so workers don't race with stbi_set_flip_vertically_on_load users
+      stbi_set_flip_vertically_on_load_thread(image.job.flipVertically);
+      int width{}, height{};
+      // Grey with alpha is expanded to RGBA, GL_RG would sample it as red and green
+      const int requestedChannels =
+        stbi_info(path.c_str(), &width, &height, &image.channels) && image.channels == 2 ? 4 : 0;
+      if (stbi_uc *pixels = stbi_load(path.c_str(), &width, &height, &image.channels, requestedChannels))
+      {
+        if (requestedChannels != 0)
+          image.channels = requestedChannels;
+        const size_t size = size_t(width) * height * image.channels;
+        image.pixels.assign(pixels, pixels + size);
+        stbi_image_free(pixels);
+        image.levels.push_back({ static_cast<uint32_t>(width), static_cast<uint32_t>(height), 0, size });
+        BuildMipChain(image.channels, image.pixels, image.levels);
+      }
+    }
+    image.nextLevel = image.IsLoaded() ? image.levels.size() - 1 : 0;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_decoded.push_back(std::move(image));
+    }
+    m_imageDecoded.notify_one();
+  }
+}
+
+void TextureLoader::Upload(size_t budget, bool wait)
+{
+  std::deque<DecodedImage> decoded;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    decoded.swap(m_decoded);
+  }
+  for (DecodedImage &image : decoded)
+  {
+    if (image.IsLoaded())
+    {
+      m_streaming.push_back(std::move(image));
+      continue;
+    }
+    std::cerr << "Texture failed to load at path: " << image.job.path << '\n';
+    --m_pendingTextures;
+    if (image.job.onLoaded)
+      image.job.onLoaded(image.job.texture, false);
+  }
+
+  size_t uploaded = 0;
+  while (!m_streaming.empty())
+  {
+    // Smallest level first: every texture gets a coarse version before any of them gets its full resolution
+    auto image = std::min_element(m_streaming.begin(), m_streaming.end(), [](const auto &lhs, const auto &rhs) {
+      return lhs.GetNextLevelSize() < rhs.GetNextLevelSize();
+    });
+
+    // The first level goes even if it alone exceeds the budget, otherwise it would never be uploaded
+    const size_t size = image->GetNextLevelSize();
+    if (uploaded > 0 && uploaded + size > budget)
+      return;
+
+    const uint8_t *pixels = image->GetLevelData(image->nextLevel);
+    if (size >= m_stagingSize)
+    {
+      // Doesn't fit the ring at all, uploading from client memory the old way
+      UploadLevel(*image, pixels);
+    }
+    else
+    {
+      size_t offset{};
+      // Ring is still in use by the GPU, the level waits for the next frame
+      if (!AllocateStaging(size, wait, offset))
+        return;
+
+      std::memcpy(m_stagingMemory + offset, pixels, size);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer);
+      UploadLevel(*image, reinterpret_cast<const void *>(offset));
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+      GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      m_stagingRegions.push_back({ offset, size, fence });
+    }
+
+    uploaded += size;
+    const u32 texture = image->job.texture;
+    if (m_onLevelUploaded)
+      m_onLevelUploaded(texture, static_cast<u32>(image->nextLevel), static_cast<u32>(image->levels.size()), size);
+
+    if (image->nextLevel > 0)
+    {
+      --image->nextLevel;
+      continue;
+    }
+
+    LoadedCallback onLoaded = std::move(image->job.onLoaded);
+    m_streaming.erase(image);
+    --m_pendingTextures;
+    if (onLoaded)
+      onLoaded(texture, true);
+  }
+}
+
+void TextureLoader::UploadLevel(const DecodedImage &image, const void *pixels)
+{
+  const GLint level = static_cast<GLint>(image.nextLevel);
+  glBindTexture(GL_TEXTURE_2D, image.job.texture);
+  if (image.IsCompressed())
+  {
+    CompressedTexture::TexLevel(image.compressed, image.nextLevel, pixels);
+  }
+  else
+  {
+    const CompressedTexture::Level &mip = image.levels[image.nextLevel];
+    const GLenum format = GetFormat(image.channels);
+    // Levels are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, level, format, mip.width, mip.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  }
+
+  // Levels below the base one are either the placeholder or stale, the texture is complete from here on
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool TextureLoader::AllocateStaging(size_t size, bool wait, size_t &offset)
+{
+  while (true)
+  {
+    if (m_stagingRegions.empty())
+      m_stagingHead = 0;
+
+    // Free space is [head, tail) if head is behind tail, or [head, end) and [0, tail) otherwise
+    const size_t tail = m_stagingRegions.empty() ? m_stagingSize : m_stagingRegions.front().offset;
+    if (m_stagingHead >= tail && m_stagingHead + size <= m_stagingSize)
+    {
+      offset = m_stagingHead;
+    }
+    else if (m_stagingHead >= tail && size < tail)
+    {
+      offset = 0;
+    }
+    else if (m_stagingHead < tail && m_stagingHead + size < tail)
+    {
+      offset = m_stagingHead;
+    }
+    else
+    {
+      if (!wait)
+        return false;
+      RetireStaging(true);
+      continue;
+    }
+
+    m_stagingHead = offset + size;
+    return true;
+  }
+}
+
+void TextureLoader::RetireStaging(bool wait)
+{
+  while (!m_stagingRegions.empty())
+  {
+    GLsync fence = static_cast<GLsync>(m_stagingRegions.front().fence);
+    const GLuint64 timeout = wait ? UINT64_MAX : 0;
+    const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      return;
+
+    glDeleteSync(fence);
+    m_stagingRegions.pop_front();
+    // Only one region is needed to make progress when waiting
+    if (wait)
+      return;
+  }
+}
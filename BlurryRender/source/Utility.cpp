@@ -1,16 +1,96 @@
 #include "Utility.hpp"
+#include "CompressedTexture.hpp"
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <glad/glad.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
 
 namespace Utility
 {
+bool MappedFile::Open(const std::string &path)
+{
+  Close();
+
+#ifdef _WIN32
+  m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+  {
+    m_file = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER size{};
+  if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+  {
+    Close();
+    return false;
+  }
+
+  m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (m_mapping)
+    m_data = static_cast<const uint8_t *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  m_size = static_cast<size_t>(size.QuadPart);
+#else
+  m_file = open(path.c_str(), O_RDONLY);
+  if (m_file < 0)
+    return false;
+
+  struct stat status = {};
+  if (fstat(m_file, &status) != 0 || status.st_size == 0)
+  {
+    Close();
+    return false;
+  }
+
+  void *data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+  if (data != MAP_FAILED)
+    m_data = static_cast<const uint8_t *>(data);
+  m_size = static_cast<size_t>(status.st_size);
+#endif
+
+  if (!m_data)
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file)
+    CloseHandle(m_file);
+  m_mapping = nullptr;
+  m_file = nullptr;
+#else
+  if (m_data)
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+  if (m_file >= 0)
+    close(m_file);
+  m_file = -1;
+#endif
+  m_data = nullptr;
+  m_size = 0;
+}
+
 std::string GetOpenGLContextInformation()
 {
   std::string contextInfo = "";
@@ -20,13 +100,26 @@ std::string GetOpenGLContextInformation()
   return contextInfo;
 }
 
+void DebugOutput(const std::string &message)
+{
+#ifdef _WIN32
+  OutputDebugStringA(message.c_str());
+#else
+  std::cerr << message;
+#endif
+}
+
 std::filesystem::path GetRootPath(std::wstring rootFolderName)
 {
   std::filesystem::path rootPath;
 
+#ifdef _WIN32
   WCHAR *exePath = new WCHAR[MAX_PATH];
   GetModuleFileName(nullptr, exePath, MAX_PATH);
   rootPath = std::filesystem::path(exePath);
+#else
+  rootPath = std::filesystem::read_symlink("/proc/self/exe");
+#endif
 
   while (rootPath.filename().wstring() != rootFolderName)
     rootPath = rootPath.parent_path();
@@ -46,6 +139,16 @@ unsigned int LoadTextureFromImage(char const *path)
   unsigned int texture;
   glGenTextures(1, &texture);
 
+  // Baked block-compressed file comes with all mips already
+  CompressedTexture::Image compressedImage;
+  if (CompressedTexture::HasBakedFile(path)
+      && CompressedTexture::Load(CompressedTexture::GetBakedPath(path), compressedImage))
+  {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    CompressedTexture::TexImage(compressedImage, compressedImage.data);
+    return texture;
+  }
+
   int width, height, nrComponents;
   unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
   if (data)
@@ -78,6 +181,7 @@ unsigned int LoadTextureFromImage(char const *path)
 
 long long milliseconds_now()
 {
+#ifdef _WIN32
   static LARGE_INTEGER s_frequency;
   static BOOL s_use_qpc = QueryPerformanceFrequency(&s_frequency);
   if (s_use_qpc)
@@ -90,6 +194,10 @@ long long milliseconds_now()
   {
     return GetTickCount();
   }
+#else
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
 }
 
 double seconds_now()
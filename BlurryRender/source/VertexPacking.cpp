@@ -0,0 +1,62 @@
+#include "VertexPacking.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr float UnormMax16 = 65535.0f;
+constexpr float SnormMax10 = 511.0f;
+
+uint32_t PackSnorm(float value, float maxValue, uint32_t bits)
+{
+  const int32_t quantized = static_cast<int32_t>(std::round(std::clamp(value, -1.0f, 1.0f) * maxValue));
+  return static_cast<uint32_t>(quantized) & ((1u << bits) - 1u);
+}
+}// namespace
+
+namespace VertexPacking
+{
+void PackPosition(const glm::vec3 &position, const Bounds &bounds, uint16_t packed[3])
+{
+  const glm::vec3 scale = bounds.GetScale();
+  for (int i = 0; i < 3; ++i)
+  {
+    // Flat axis of the bounds, every position on it is the offset
+    const float normalized = scale[i] > 0.0f ? (position[i] - bounds.min[i]) / scale[i] : 0.0f;
+    packed[i] = static_cast<uint16_t>(std::round(std::clamp(normalized, 0.0f, 1.0f) * UnormMax16));
+  }
+}
+
+uint32_t PackSnorm10(const glm::vec3 &vector, float w)
+{
+  return PackSnorm(vector.x, SnormMax10, 10) | PackSnorm(vector.y, SnormMax10, 10) << 10
+         | PackSnorm(vector.z, SnormMax10, 10) << 20 | PackSnorm(w, 1.0f, 2) << 30;
+}
+
+uint16_t PackHalf(float value)
+{
+  uint32_t bits{};
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+  const uint32_t mantissa = bits & 0x7FFFFFu;
+
+  // NaN stays NaN, infinity and overflow become infinity
+  if (((bits >> 23) & 0xFFu) == 0xFFu)
+    return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+  if (exponent >= 0x1F)
+    return static_cast<uint16_t>(sign | 0x7C00u);
+  if (exponent <= 0)
+    return static_cast<uint16_t>(sign);
+
+  // Round to nearest even on the 13 dropped mantissa bits, carry may bump the exponent which is still correct
+  uint32_t half = static_cast<uint32_t>(exponent) << 10 | mantissa >> 13;
+  const uint32_t dropped = mantissa & 0x1FFFu;
+  if (dropped > 0x1000u || (dropped == 0x1000u && (half & 1u)))
+    ++half;
+  return static_cast<uint16_t>(sign | std::min(half, 0x7C00u));
+}
+}// namespace VertexPacking